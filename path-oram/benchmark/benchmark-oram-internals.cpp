@@ -0,0 +1,355 @@
+#include "definitions.h"
+#include "oram.hpp"
+#include "utility.hpp"
+
+#include <benchmark/benchmark.h>
+
+using namespace std;
+
+/**
+ * Microbenchmarks of the stages of an ORAM access, each measured on its own
+ * (the fixture is a friend of ORAM, as the tests are).
+ *
+ * Every benchmark gets the block cipher mode as its first argument (CBC or NONE),
+ * so that each stage can be measured with and without encryption.
+ * The ORAM is bulk loaded (3/4 full), and after each iteration the cache and the stash are discarded
+ * (paths are read into the cache and evicted to it, but never written back), so every iteration starts from the same state.
+ */
+namespace PathORAM
+{
+	class ORAMInternalsBenchmark : public ::benchmark::Fixture
+	{
+		public:
+		inline static const number LOG_CAPACITY = 12;
+		inline static const number Z			= 3;
+		inline static const number BLOCK_SIZE	= 64;
+		inline static const number CAPACITY		= (1 << LOG_CAPACITY) * Z;
+		inline static const number ELEMENTS		= (CAPACITY / 4) * 3;
+		inline static const number LEAVES		= 1 << (LOG_CAPACITY - 1);
+
+		inline static const auto ITERATIONS = 1 << 12;
+
+		protected:
+		unique_ptr<ORAM> oram;
+		shared_ptr<AbsPositionMapAdapter> map;
+		shared_ptr<AbsStashAdapter> stash;
+
+		void SetUp(const ::benchmark::State& state) override
+		{
+			// the storage must be read with the mode it was written with
+			__blockCipherMode = (BlockCipherMode)state.range(0);
+
+			map	  = make_shared<InMemoryPositionMapAdapter>(CAPACITY + Z);
+			stash = make_shared<InMemoryStashAdapter>(3 * LOG_CAPACITY * Z + (1 << 10));
+			oram  = make_unique<ORAM>(
+				 LOG_CAPACITY,
+				 BLOCK_SIZE,
+				 Z,
+				 make_shared<InMemoryStorageAdapter>((1 << LOG_CAPACITY) + Z, BLOCK_SIZE, bytes(), Z),
+				 map,
+				 stash,
+				 false);
+
+			vector<block> data;
+			for (number id = 0; id < ELEMENTS; id++)
+			{
+				data.push_back({id, bytes(BLOCK_SIZE, 0x25)});
+			}
+			oram->load(data);
+		}
+
+		void TearDown(const ::benchmark::State& state) override
+		{
+			oram.reset();
+			map.reset();
+			stash.reset();
+
+			__blockCipherMode = CBC;
+		}
+
+		/**
+		 * @brief puts count blocks (not in the ORAM) with random leaves in the stash
+		 */
+		void fillStash(const number count)
+		{
+			for (number i = 0; i < count; i++)
+			{
+				map->set(ELEMENTS + i, getRandomULong(LEAVES));
+				stash->add(ELEMENTS + i, bytes(BLOCK_SIZE, 0x42));
+			}
+		}
+
+		/**
+		 * @brief empties the cache and the stash without touching the storage
+		 */
+		void discard()
+		{
+			oram->clearCache();
+
+			vector<block> blocks;
+			stash->getAll(blocks);
+			for (auto&& block : blocks)
+			{
+				stash->remove(block.first);
+			}
+		}
+
+		void readPath(const number leaf, vector<number>& path, const bool putInStash)
+		{
+			oram->readPath(leaf, path, putInStash);
+		}
+
+		void writePath(const number leaf)
+		{
+			oram->writePath(leaf);
+		}
+
+		void getCache(const vector<number>& locations, vector<const arenaBlock*>& response)
+		{
+			oram->getCache(locations, response, false);
+		}
+
+		void setCache(vector<pair<number, arenaBucket>>& requests)
+		{
+			oram->setCache(requests);
+		}
+
+		void syncCache()
+		{
+			oram->syncCache();
+		}
+
+		number bucketForLevelLeaf(const number level, const number leaf) const
+		{
+			return oram->bucketForLevelLeaf(level, leaf);
+		}
+
+		BlockArena& arena()
+		{
+			return oram->arena;
+		}
+	};
+
+	BENCHMARK_DEFINE_F(ORAMInternalsBenchmark, ReadPath)
+	(benchmark::State& state)
+	{
+		vector<number> path;
+		for (auto _ : state)
+		{
+			state.PauseTiming();
+			const auto leaf = getRandomULong(LEAVES);
+			path.clear();
+			state.ResumeTiming();
+
+			// fetch (and decrypt) into the cache, then copy to the stash
+			readPath(leaf, path, true);
+
+			state.PauseTiming();
+			discard();
+			state.ResumeTiming();
+		}
+
+		state.SetItemsProcessed(state.iterations() * LOG_CAPACITY * Z);
+	}
+
+	// {cipher mode}
+	BENCHMARK_REGISTER_F(ORAMInternalsBenchmark, ReadPath)
+		->Arg(CBC)
+		->Arg(NONE)
+		->Iterations(ORAMInternalsBenchmark::ITERATIONS);
+
+	BENCHMARK_DEFINE_F(ORAMInternalsBenchmark, WritePath)
+	(benchmark::State& state)
+	{
+		const number STASH = state.range(1);
+
+		vector<number> path;
+		for (auto _ : state)
+		{
+			state.PauseTiming();
+			const auto leaf = getRandomULong(LEAVES);
+			path.clear();
+			readPath(leaf, path, true);
+			fillStash(STASH);
+			state.ResumeTiming();
+
+			// eviction only: the buckets go to the cache, not to the storage
+			writePath(leaf);
+
+			state.PauseTiming();
+			discard();
+			state.ResumeTiming();
+		}
+	}
+
+	// {cipher mode, blocks in the stash besides the path}
+	BENCHMARK_REGISTER_F(ORAMInternalsBenchmark, WritePath)
+		->ArgsProduct({{NONE}, {0, 8, 32, 128, 512}})
+		->Iterations(ORAMInternalsBenchmark::ITERATIONS);
+
+	BENCHMARK_DEFINE_F(ORAMInternalsBenchmark, GetCache)
+	(benchmark::State& state)
+	{
+		const bool WARM = state.range(1);
+
+		vector<number> path;
+		vector<const arenaBlock*> response;
+		for (auto _ : state)
+		{
+			state.PauseTiming();
+			const auto leaf = getRandomULong(LEAVES);
+			path.clear();
+			response.clear();
+			readPath(leaf, path, false);
+			if (WARM)
+			{
+				vector<const arenaBlock*> ignored;
+				getCache(path, ignored);
+			}
+			state.ResumeTiming();
+
+			getCache(path, response);
+
+			state.PauseTiming();
+			discard();
+			state.ResumeTiming();
+		}
+	}
+
+	// {cipher mode, whether the path is in the cache}
+	BENCHMARK_REGISTER_F(ORAMInternalsBenchmark, GetCache)
+		->ArgsProduct({{CBC, NONE}, {false, true}})
+		->Iterations(ORAMInternalsBenchmark::ITERATIONS);
+
+	BENCHMARK_DEFINE_F(ORAMInternalsBenchmark, SetCache)
+	(benchmark::State& state)
+	{
+		vector<number> path;
+		vector<pair<number, arenaBucket>> requests;
+		for (auto _ : state)
+		{
+			state.PauseTiming();
+			path.clear();
+			readPath(getRandomULong(LEAVES), path, false);
+			requests.clear();
+			for (auto&& location : path)
+			{
+				arenaBucket bucket;
+				for (number i = 0; i < Z; i++)
+				{
+					bucket.push_back({ULONG_MAX, arena().allocate()});
+				}
+				requests.push_back({location, move(bucket)});
+			}
+			state.ResumeTiming();
+
+			setCache(requests);
+
+			state.PauseTiming();
+			discard();
+			state.ResumeTiming();
+		}
+	}
+
+	// {cipher mode}
+	BENCHMARK_REGISTER_F(ORAMInternalsBenchmark, SetCache)
+		->Arg(NONE)
+		->Iterations(ORAMInternalsBenchmark::ITERATIONS);
+
+	BENCHMARK_DEFINE_F(ORAMInternalsBenchmark, SyncCache)
+	(benchmark::State& state)
+	{
+		vector<number> path;
+		for (auto _ : state)
+		{
+			state.PauseTiming();
+			// a dummy access (no remap), so writing the path back keeps the ORAM consistent
+			const auto leaf = getRandomULong(LEAVES);
+			path.clear();
+			readPath(leaf, path, true);
+			writePath(leaf);
+			state.ResumeTiming();
+
+			// encrypt and upload
+			syncCache();
+		}
+	}
+
+	// {cipher mode}
+	BENCHMARK_REGISTER_F(ORAMInternalsBenchmark, SyncCache)
+		->Arg(CBC)
+		->Arg(NONE)
+		->Iterations(ORAMInternalsBenchmark::ITERATIONS);
+
+	BENCHMARK_DEFINE_F(ORAMInternalsBenchmark, BucketForLevelLeaf)
+	(benchmark::State& state)
+	{
+		number leaf = 0;
+		for (auto _ : state)
+		{
+			for (number level = 0; level < LOG_CAPACITY; level++)
+			{
+				benchmark::DoNotOptimize(bucketForLevelLeaf(level, leaf));
+			}
+			leaf = (leaf + 1) % LEAVES;
+		}
+
+		state.SetItemsProcessed(state.iterations() * LOG_CAPACITY);
+	}
+
+	// {cipher mode}
+	BENCHMARK_REGISTER_F(ORAMInternalsBenchmark, BucketForLevelLeaf)
+		->Arg(NONE);
+
+	/**
+	 * @brief AbsStorageAdapter::get / set of single buckets on in-memory storage
+	 * (with NONE, this is the serialization of the buckets alone)
+	 */
+	void StorageSerialization(benchmark::State& state, const bool read)
+	{
+		const number CAPACITY	= 1 << 10;
+		const number BLOCK_SIZE = 64;
+		const number Z			= 3;
+
+		__blockCipherMode = (BlockCipherMode)state.range(0);
+
+		InMemoryStorageAdapter storage(CAPACITY, BLOCK_SIZE, bytes(), Z);
+
+		bucket data;
+		for (number i = 0; i < Z; i++)
+		{
+			data.push_back({i, bytes(BLOCK_SIZE, 0x25)});
+		}
+
+		bucket response;
+		number location = 0;
+		for (auto _ : state)
+		{
+			if (read)
+			{
+				response.clear();
+				storage.get(location, response);
+			}
+			else
+			{
+				storage.set(location, data);
+			}
+			location = (location + 1) % CAPACITY;
+		}
+
+		state.SetBytesProcessed(state.iterations() * Z * BLOCK_SIZE);
+
+		__blockCipherMode = CBC;
+	}
+
+	// {cipher mode}
+	BENCHMARK_CAPTURE(StorageSerialization, Get, true)
+		->Arg(CBC)
+		->Arg(NONE);
+
+	BENCHMARK_CAPTURE(StorageSerialization, Set, false)
+		->Arg(CBC)
+		->Arg(NONE);
+}
+
+BENCHMARK_MAIN();
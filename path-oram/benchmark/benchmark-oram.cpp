@@ -1,13 +1,120 @@
+#include "concurrent-oram.hpp"
 #include "definitions.h"
+#include "fixed-oram.hpp"
+#include "oram-builder.hpp"
 #include "oram.hpp"
+#include "partitioned-oram.hpp"
 #include "utility.hpp"
 
+#include <atomic>
 #include <benchmark/benchmark.h>
 #include <boost/format.hpp>
+#include <cstring>
 #include <fstream>
+#include <malloc.h>
+#include <thread>
 
 using namespace std;
 
+/**
+ * Heap allocation counting.
+ *
+ * The global operator new and delete count the allocations (and their usable sizes) while counting is on.
+ * The Allocations benchmark counts around each access;
+ * with --count_allocations, every benchmark is also run once more with counting on (see benchmark::MemoryManager)
+ * and reports allocs_per_iter and max_bytes_used (shown in JSON output).
+ */
+namespace
+{
+	atomic<bool> counting = false;
+	atomic<int64_t> allocations;
+	atomic<int64_t> allocated;
+	atomic<int64_t> freed;
+	atomic<int64_t> peak;
+
+	void countAllocation(void* pointer)
+	{
+		if (counting.load(memory_order_relaxed))
+		{
+			allocations.fetch_add(1, memory_order_relaxed);
+			const auto current = allocated.fetch_add(malloc_usable_size(pointer), memory_order_relaxed) + (int64_t)malloc_usable_size(pointer) - freed.load(memory_order_relaxed);
+
+			auto highest = peak.load(memory_order_relaxed);
+			while (current > highest && !peak.compare_exchange_weak(highest, current, memory_order_relaxed))
+			{
+			}
+		}
+	}
+
+	void countFree(void* pointer)
+	{
+		if (pointer != nullptr && counting.load(memory_order_relaxed))
+		{
+			freed.fetch_add(malloc_usable_size(pointer), memory_order_relaxed);
+		}
+	}
+
+	void startCounting()
+	{
+		for (auto counter : {&allocations, &allocated, &freed, &peak})
+		{
+			counter->store(0, memory_order_relaxed);
+		}
+		counting.store(true, memory_order_relaxed);
+	}
+
+	void stopCounting()
+	{
+		counting.store(false, memory_order_relaxed);
+	}
+
+	class CountingMemoryManager : public benchmark::MemoryManager
+	{
+		public:
+		void Start() override
+		{
+			startCounting();
+		}
+
+		void Stop(Result& result) override
+		{
+			stopCounting();
+			result.num_allocs			 = allocations.load(memory_order_relaxed);
+			result.max_bytes_used		 = peak.load(memory_order_relaxed);
+			result.total_allocated_bytes = allocated.load(memory_order_relaxed);
+			result.net_heap_growth		 = allocated.load(memory_order_relaxed) - freed.load(memory_order_relaxed);
+		}
+
+		void Stop(Result* result) override
+		{
+			Stop(*result);
+		}
+	};
+}
+
+void* operator new(size_t size)
+{
+	auto pointer = malloc(size == 0 ? 1 : size);
+	if (pointer == nullptr)
+	{
+		throw bad_alloc();
+	}
+	countAllocation(pointer);
+	return pointer;
+}
+
+void operator delete(void* pointer) noexcept
+{
+	countFree(pointer);
+	free(pointer);
+}
+
+void operator delete(void* pointer, size_t size) noexcept
+{
+	countFree(pointer);
+	free(pointer);
+}
+
 namespace PathORAM
 {
 	class ORAMBenchmark : public ::benchmark::Fixture
@@ -128,6 +235,606 @@ namespace PathORAM
 
 		->Iterations(ORAMBenchmark::ITERATIONS)
 		->Unit(benchmark::kMillisecond);
+
+	BENCHMARK_DEFINE_F(ORAMBenchmark, PayloadBuffer)
+	(benchmark::State& state)
+	{
+		Configure(state.range(0), state.range(1), state.range(2), 1);
+
+		vector<uchar> buffer(BLOCK_SIZE);
+
+		// put all
+		for (number id = 0; id < ELEMENTS; id++)
+		{
+			oram->put(id, fromText(to_string(id), BLOCK_SIZE));
+		}
+
+		// random operations, payloads are moved in and read into the same buffer
+		for (auto _ : state)
+		{
+			state.PauseTiming();
+			auto id	  = getRandomULong(ELEMENTS);
+			auto read = getRandomULong(2) == 0;
+			auto data = read ? bytes() : fromText(to_string(ELEMENTS + getRandomULong(ELEMENTS)), BLOCK_SIZE);
+			state.ResumeTiming();
+
+			if (read)
+			{
+				oram->get(id, buffer.data());
+			}
+			else
+			{
+				oram->put(id, move(data));
+			}
+		}
+	}
+
+	// same as ORAMBenchmark/Payload with batch size 1, for comparison
+	BENCHMARK_REGISTER_F(ORAMBenchmark, PayloadBuffer)
+		->Args({5, 3, 32})
+		->Args({5, 3, 4096})
+		->Args({5, 4, 4096})
+		->Iterations(ORAMBenchmark::ITERATIONS)
+		->Unit(benchmark::kMillisecond);
+
+	/**
+	 * @brief heap allocations (and bytes) of single accesses, counted around each call
+	 */
+	void Allocations(benchmark::State& state, const bool read)
+	{
+		const number LOG_CAPACITY = 10;
+		const number Z			  = 4;
+		const number BLOCK_SIZE	  = state.range(0);
+		const bool SLAB			  = state.range(1);
+		const bool BUFFER		  = state.range(2);
+		const number ELEMENTS	  = (((1 << LOG_CAPACITY) * Z) / 4) * 3;
+
+		shared_ptr<AbsStashAdapter> stash;
+		if (SLAB)
+		{
+			stash = make_shared<SlabStashAdapter>(3 * LOG_CAPACITY * Z, BLOCK_SIZE);
+		}
+		else
+		{
+			stash = make_shared<InMemoryStashAdapter>(3 * LOG_CAPACITY * Z);
+		}
+		auto oram = make_unique<ORAM>(
+			LOG_CAPACITY,
+			BLOCK_SIZE,
+			Z,
+			make_shared<InMemoryStorageAdapter>((1 << LOG_CAPACITY) + Z, BLOCK_SIZE, bytes(), Z),
+			make_shared<InMemoryPositionMapAdapter>(((1 << LOG_CAPACITY) * Z) + Z),
+			stash,
+			false);
+
+		vector<block> data;
+		for (number id = 0; id < ELEMENTS; id++)
+		{
+			data.push_back({id, bytes(BLOCK_SIZE, 0x25)});
+		}
+		oram->load(data);
+
+		vector<uchar> buffer(BLOCK_SIZE);
+		bytes response;
+		number totalAllocations = 0;
+		number totalBytes		= 0;
+		for (auto _ : state)
+		{
+			state.PauseTiming();
+			const auto id = getRandomULong(ELEMENTS);
+			auto payload  = bytes(BLOCK_SIZE, 0x42);
+			response.clear();
+			startCounting();
+			state.ResumeTiming();
+
+			if (read)
+			{
+				if (BUFFER)
+				{
+					oram->get(id, buffer.data());
+				}
+				else
+				{
+					oram->get(id, response);
+				}
+			}
+			else
+			{
+				if (BUFFER)
+				{
+					oram->put(id, move(payload));
+				}
+				else
+				{
+					oram->put(id, payload);
+				}
+			}
+
+			state.PauseTiming();
+			stopCounting();
+			totalAllocations += allocations.load(memory_order_relaxed);
+			totalBytes += allocated.load(memory_order_relaxed);
+			state.ResumeTiming();
+		}
+
+		state.counters["allocs_per_access"] = benchmark::Counter(totalAllocations, benchmark::Counter::kAvgIterations);
+		state.counters["bytes_per_access"]	= benchmark::Counter(totalBytes, benchmark::Counter::kAvgIterations);
+	}
+
+	// {block size, slab stash, caller-provided buffer (get) or moved payload (put)}
+	BENCHMARK_CAPTURE(Allocations, Get, true)
+		->ArgsProduct({{64, 4096}, {false, true}, {false, true}})
+		->Iterations(ORAMBenchmark::ITERATIONS);
+
+	BENCHMARK_CAPTURE(Allocations, Put, false)
+		->ArgsProduct({{64, 4096}, {false, true}, {false, true}})
+		->Iterations(ORAMBenchmark::ITERATIONS);
+
+	void Concurrent(benchmark::State& state)
+	{
+		const number LOG_CAPACITY = 9;
+		const number Z			  = 3;
+		const number BLOCK_SIZE	  = 32;
+		const number ELEMENTS	  = (((1 << LOG_CAPACITY) * Z) / 4) * 3;
+		const number THREADS	  = state.range(0);
+		const number BATCH_SIZE	  = state.range(1);
+		const number REQUESTS	  = 64; // per thread per iteration
+
+		auto inner = make_shared<ORAM>(
+			LOG_CAPACITY,
+			BLOCK_SIZE,
+			Z,
+			make_shared<InMemoryStorageAdapter>((1 << LOG_CAPACITY) + Z, BLOCK_SIZE, bytes(), Z),
+			make_shared<InMemoryPositionMapAdapter>(((1 << LOG_CAPACITY) * Z) + Z),
+			make_shared<InMemoryStashAdapter>(3 * LOG_CAPACITY * Z + BATCH_SIZE),
+			true,
+			BATCH_SIZE);
+		ConcurrentORAM oram(inner, BATCH_SIZE, chrono::microseconds(100));
+
+		// each thread waits for its answer before the next request (as service handlers do)
+		for (auto _ : state)
+		{
+			vector<thread> threads;
+			for (number t = 0; t < THREADS; t++)
+			{
+				threads.push_back(thread([&oram, ELEMENTS, BLOCK_SIZE, REQUESTS]() {
+					for (number i = 0; i < REQUESTS; i++)
+					{
+						const auto id = getRandomULong(ELEMENTS);
+						if (i % 2 == 0)
+						{
+							oram.get(id).wait();
+						}
+						else
+						{
+							oram.put(id, bytes(BLOCK_SIZE, 0x25)).wait();
+						}
+					}
+				}));
+			}
+			for (auto&& thread : threads)
+			{
+				thread.join();
+			}
+		}
+
+		state.SetItemsProcessed(state.iterations() * THREADS * REQUESTS);
+	}
+
+	// {threads, batch size}
+	BENCHMARK(Concurrent)
+		->Args({1, 1})
+		->Args({4, 1})
+		->Args({4, 4})
+		->Args({16, 1})
+		->Args({16, 16})
+		->Iterations(16)
+		->UseRealTime()
+		->Unit(benchmark::kMillisecond);
+
+	void Partitioned(benchmark::State& state)
+	{
+		const number CAPACITY	= 1 << 12;
+		const number BLOCK_SIZE = 32;
+		const number Z			= 3;
+		const number PARTITIONS = state.range(0);
+		const number BATCH		= 64;
+
+		PartitionedORAM oram(CAPACITY, BLOCK_SIZE, Z, PARTITIONS, BATCH);
+
+		vector<block> batch;
+		vector<bytes> response;
+		for (number id = 0; id < CAPACITY; id++)
+		{
+			batch.push_back({id, bytes(BLOCK_SIZE, 0x25)});
+			if (batch.size() == BATCH)
+			{
+				oram.multiple(batch, response);
+				batch.clear();
+			}
+		}
+
+		// random batches of mixed requests
+		for (auto _ : state)
+		{
+			state.PauseTiming();
+			batch.clear();
+			for (number i = 0; i < BATCH; i++)
+			{
+				batch.push_back({getRandomULong(CAPACITY), i % 2 == 0 ? bytes() : bytes(BLOCK_SIZE, 0x25)});
+			}
+			state.ResumeTiming();
+
+			oram.multiple(batch, response);
+		}
+
+		state.SetItemsProcessed(state.iterations() * BATCH);
+	}
+
+	// {partitions}
+	BENCHMARK(Partitioned)
+		->Arg(1)
+		->Arg(2)
+		->Arg(4)
+		->Arg(8)
+		->Iterations(64)
+		->UseRealTime()
+		->Unit(benchmark::kMillisecond);
+
+	void Recursive(benchmark::State& state)
+	{
+		const number LOG_CAPACITY = 12;
+		const number BLOCK_SIZE	  = 64;
+		const number Z			  = 3;
+		const number ELEMENTS	  = (((1 << LOG_CAPACITY) * Z) / 4) * 3;
+		const number LEVELS		  = state.range(0);
+		const number PLB		  = state.range(1);
+
+		// each position map level holds the positions of the level above it, at most 3/4 full
+		vector<ORAMLevel> levels = {{LOG_CAPACITY, BLOCK_SIZE, Z, 3 * LOG_CAPACITY * Z, 0}};
+		for (number level = 0; level < LEVELS; level++)
+		{
+			const auto positions = (1uLL << levels.back().logCapacity) * Z;
+			const auto blocks	 = (positions + BLOCK_SIZE / sizeof(number) - 1) / (BLOCK_SIZE / sizeof(number));
+
+			number logCapacity = 2;
+			while (((1uLL << logCapacity) * Z / 4) * 3 < blocks)
+			{
+				logCapacity++;
+			}
+			levels.push_back({logCapacity, BLOCK_SIZE, Z, 3 * logCapacity * Z, PLB});
+		}
+
+		auto oram = buildRecursiveORAM(levels);
+
+		// random operations
+		bytes returned;
+		number i = 0;
+		for (auto _ : state)
+		{
+			state.PauseTiming();
+			const auto id = getRandomULong(ELEMENTS);
+			state.ResumeTiming();
+
+			if (i++ % 2 == 0)
+			{
+				oram->get(id, returned);
+			}
+			else
+			{
+				oram->put(id, bytes(BLOCK_SIZE, 0x25));
+			}
+		}
+
+		// client memory (the in-memory storages of all levels are included)
+		const auto usage			 = oram->memoryUsage();
+		state.counters["memory"]	 = benchmark::Counter(usage.total(), benchmark::Counter::kDefaults, benchmark::Counter::kIs1024);
+		state.counters["map_memory"] = benchmark::Counter(usage.positionMap + usage.recursive, benchmark::Counter::kDefaults, benchmark::Counter::kIs1024);
+	}
+
+	// {position map ORAM levels (0 for in-memory map), PLB capacity}
+	BENCHMARK(Recursive)
+		->Args({0, 0})
+		->Args({1, 0})
+		->Args({2, 0})
+		->Args({3, 0})
+		->Args({3, 16})
+		->Iterations(ORAMBenchmark::ITERATIONS)
+		->Unit(benchmark::kMillisecond);
+
+	void Load(benchmark::State& state)
+	{
+		const number LOG_CAPACITY = state.range(0);
+		const number BLOCK_SIZE	  = 64;
+		const number Z			  = 3;
+		const number ELEMENTS	  = (((1 << LOG_CAPACITY) * Z) / 4) * 3;
+
+		for (auto _ : state)
+		{
+			state.PauseTiming();
+			// the in-memory storage is filled on construction, so ORAM does not need to initialize
+			auto oram = make_unique<ORAM>(
+				LOG_CAPACITY,
+				BLOCK_SIZE,
+				Z,
+				make_shared<InMemoryStorageAdapter>((1 << LOG_CAPACITY) + Z, BLOCK_SIZE, bytes(), Z),
+				make_shared<InMemoryPositionMapAdapter>(((1 << LOG_CAPACITY) * Z) + Z),
+				make_shared<InMemoryStashAdapter>(3 * LOG_CAPACITY * Z),
+				false);
+
+			vector<block> data;
+			data.reserve(ELEMENTS);
+			for (number id = 0; id < ELEMENTS; id++)
+			{
+				data.push_back({id, bytes(BLOCK_SIZE, 0x25)});
+			}
+			state.ResumeTiming();
+
+			oram->load(data);
+
+			state.PauseTiming();
+			oram.reset();
+			state.ResumeTiming();
+		}
+
+		state.SetItemsProcessed(state.iterations() * ELEMENTS);
+	}
+
+	// {log capacity}
+	BENCHMARK(Load)
+		->Arg(10)
+		->Arg(14)
+		->Arg(17)
+		->Iterations(4)
+		->Unit(benchmark::kMillisecond);
+
+	void Initialize(benchmark::State& state)
+	{
+		const number LOG_CAPACITY = state.range(0);
+		const bool FILE_SYSTEM	  = state.range(1);
+		const number BLOCK_SIZE	  = 64;
+		const number Z			  = 3;
+		const string FILE_NAME	  = "storage.bin";
+
+		for (auto _ : state)
+		{
+			state.PauseTiming();
+			shared_ptr<AbsStorageAdapter> storage;
+			if (FILE_SYSTEM)
+			{
+				storage = make_shared<FileSystemStorageAdapter>((1 << LOG_CAPACITY) + Z, BLOCK_SIZE, bytes(), FILE_NAME, true, Z);
+			}
+			else
+			{
+				storage = make_shared<InMemoryStorageAdapter>((1 << LOG_CAPACITY) + Z, BLOCK_SIZE, bytes(), Z);
+			}
+			state.ResumeTiming();
+
+			// fills the storage with zeroes and initializes the position map
+			auto oram = make_unique<ORAM>(
+				LOG_CAPACITY,
+				BLOCK_SIZE,
+				Z,
+				storage,
+				make_shared<InMemoryPositionMapAdapter>(((1 << LOG_CAPACITY) * Z) + Z),
+				make_shared<InMemoryStashAdapter>(3 * LOG_CAPACITY * Z),
+				true);
+
+			state.PauseTiming();
+			oram.reset();
+			storage.reset();
+			state.ResumeTiming();
+		}
+
+		remove(FILE_NAME.c_str());
+	}
+
+	// {log capacity, file system storage}
+	BENCHMARK(Initialize)
+		->ArgsProduct({{10, 14, 17}, {false, true}})
+		->Iterations(4)
+		->Unit(benchmark::kMillisecond);
+
+	void MultipleFileSystem(benchmark::State& state)
+	{
+		const number LOG_CAPACITY = 12;
+		const number BLOCK_SIZE	  = 64;
+		const number Z			  = 3;
+		const number ELEMENTS	  = (((1 << LOG_CAPACITY) * Z) / 4) * 3;
+		const number BATCH		  = state.range(0);
+		const string FILE_NAME	  = "storage.bin";
+
+		auto oram = make_unique<ORAM>(
+			LOG_CAPACITY,
+			BLOCK_SIZE,
+			Z,
+			make_shared<FileSystemStorageAdapter>((1 << LOG_CAPACITY) + Z, BLOCK_SIZE, bytes(), FILE_NAME, true, Z),
+			make_shared<InMemoryPositionMapAdapter>(((1 << LOG_CAPACITY) * Z) + Z),
+			make_shared<InMemoryStashAdapter>(3 * LOG_CAPACITY * Z + BATCH),
+			true,
+			BATCH);
+
+		vector<block> data;
+		for (number id = 0; id < ELEMENTS; id++)
+		{
+			data.push_back({id, bytes(BLOCK_SIZE, 0x25)});
+		}
+		oram->load(data);
+
+		// random batches of mixed requests
+		vector<block> batch;
+		vector<bytes> response;
+		for (auto _ : state)
+		{
+			state.PauseTiming();
+			batch.clear();
+			for (number i = 0; i < BATCH; i++)
+			{
+				batch.push_back({getRandomULong(ELEMENTS), i % 2 == 0 ? bytes() : bytes(BLOCK_SIZE, 0x25)});
+			}
+			state.ResumeTiming();
+
+			oram->multiple(batch, response);
+		}
+
+		state.SetItemsProcessed(state.iterations() * BATCH);
+
+		oram.reset();
+		remove(FILE_NAME.c_str());
+	}
+
+	// {batch size}
+	BENCHMARK(MultipleFileSystem)
+		->Arg(1)
+		->Arg(16)
+		->Arg(64)
+		->Arg(256)
+		->Iterations(64)
+		->Unit(benchmark::kMillisecond);
+
+	void SimulatedRoundTrip(benchmark::State& state)
+	{
+		const number LOG_CAPACITY = 10;
+		const number BLOCK_SIZE	  = 64;
+		const number Z			  = 4;
+		const number CAPACITY	  = (1 << LOG_CAPACITY) * Z;
+		const number ELEMENTS	  = (CAPACITY / 4) * 3;
+		const number BATCH		  = state.range(1);
+
+		// a network with the given round trip and 1 Gbit/s of bandwidth
+		SimulatedLatency latency;
+		latency.request = chrono::microseconds(state.range(0));
+		latency.batch	= chrono::microseconds(state.range(0));
+		latency.perByte = 8;
+
+		auto oram = make_unique<ORAM>(
+			LOG_CAPACITY,
+			BLOCK_SIZE,
+			Z,
+			make_shared<SimulatedLatencyStorageAdapter>(make_shared<InMemoryStorageAdapter>((1 << LOG_CAPACITY) + Z, BLOCK_SIZE, bytes(), Z), latency),
+			make_shared<InMemoryPositionMapAdapter>(CAPACITY + Z),
+			make_shared<InMemoryStashAdapter>(3 * LOG_CAPACITY * Z),
+			true,
+			BATCH);
+
+		vector<block> data;
+		for (number id = 0; id < ELEMENTS; id++)
+		{
+			data.push_back({id, bytes(BLOCK_SIZE, 0x25)});
+		}
+		oram->load(data);
+
+		// random batches of mixed requests
+		vector<block> batch;
+		vector<bytes> response;
+		for (auto _ : state)
+		{
+			state.PauseTiming();
+			batch.clear();
+			for (number i = 0; i < BATCH; i++)
+			{
+				batch.push_back({getRandomULong(ELEMENTS), i % 2 == 0 ? bytes() : bytes(BLOCK_SIZE, 0x25)});
+			}
+			state.ResumeTiming();
+
+			oram->multiple(batch, response);
+		}
+
+		state.SetItemsProcessed(state.iterations() * BATCH);
+	}
+
+	// {round trip in microseconds, batch size}
+	BENCHMARK(SimulatedRoundTrip)
+		->ArgsProduct({{0, 100, 1000}, {1, 8, 32}})
+		->Iterations(32)
+		->UseRealTime()
+		->Unit(benchmark::kMillisecond);
+
+	template <number Z, number BLOCK_SIZE>
+	void FixedPayload(benchmark::State& state)
+	{
+		const number LOG_CAPACITY = state.range(0);
+		const number ELEMENTS	  = (((1 << LOG_CAPACITY) * Z) / 4) * 3;
+
+		auto oram = make_unique<FixedORAM<Z, BLOCK_SIZE>>(LOG_CAPACITY);
+
+		typename FixedORAM<Z, BLOCK_SIZE>::payload data;
+		data.fill(0x00);
+
+		// put all
+		for (number id = 0; id < ELEMENTS; id++)
+		{
+			oram->put(id, data);
+		}
+
+		// random operations, the allocations are counted around each access
+		number totalAllocations = 0;
+		for (auto _ : state)
+		{
+			state.PauseTiming();
+			auto id	  = getRandomULong(ELEMENTS);
+			auto read = getRandomULong(2) == 0;
+			startCounting();
+			state.ResumeTiming();
+
+			if (read)
+			{
+				oram->get(id, data);
+			}
+			else
+			{
+				oram->put(id, data);
+			}
+
+			state.PauseTiming();
+			stopCounting();
+			totalAllocations += allocations.load(memory_order_relaxed);
+			state.ResumeTiming();
+		}
+
+		state.counters["allocs_per_access"] = benchmark::Counter(totalAllocations, benchmark::Counter::kAvgIterations);
+	}
+
+	// same as ORAMBenchmark/Payload with batch size 1 and ORAMBenchmark/PayloadBuffer, for comparison
+	BENCHMARK_TEMPLATE(FixedPayload, 3, 32)
+		->Arg(5)
+		->Arg(7)
+		->Arg(9)
+		->Arg(11)
+		->Iterations(ORAMBenchmark::ITERATIONS)
+		->Unit(benchmark::kMillisecond);
+
+	BENCHMARK_TEMPLATE(FixedPayload, 4, 4096)
+		->Arg(5)
+		->Iterations(ORAMBenchmark::ITERATIONS)
+		->Unit(benchmark::kMillisecond);
 }
 
-BENCHMARK_MAIN();
+int main(int argc, char** argv)
+{
+	vector<char*> arguments;
+	auto countAllocations = false;
+	for (auto i = 0; i < argc; i++)
+	{
+		if (strcmp(argv[i], "--count_allocations") == 0)
+		{
+			countAllocations = true;
+			continue;
+		}
+		arguments.push_back(argv[i]);
+	}
+
+	CountingMemoryManager manager;
+	if (countAllocations)
+	{
+		benchmark::RegisterMemoryManager(&manager);
+	}
+
+	auto count = (int)arguments.size();
+	benchmark::Initialize(&count, arguments.data());
+	benchmark::RunSpecifiedBenchmarks();
+	benchmark::RegisterMemoryManager(nullptr);
+	benchmark::Shutdown();
+
+	return 0;
+}
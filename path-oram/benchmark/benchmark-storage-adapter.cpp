@@ -200,6 +200,44 @@ namespace PathORAM
 		b->Iterations(iterations);
 	}
 
+	void SimulatedRoundTrip(benchmark::State& state)
+	{
+		const number CAPACITY = 1 << 12;
+		const number BATCH	  = state.range(1);
+
+		// a network with the given round trip and 1 Gbit/s of bandwidth
+		SimulatedLatency latency;
+		latency.request = chrono::microseconds(state.range(0));
+		latency.batch	= chrono::microseconds(state.range(0));
+		latency.perByte = 8;
+
+		SimulatedLatencyStorageAdapter adapter(make_shared<InMemoryStorageAdapter>(CAPACITY, StorageAdapterBenchmark::BLOCK_SIZE, bytes(), 1), latency);
+
+		vector<number> reads(BATCH);
+		vector<block> read;
+		number location = 0;
+		for (auto _ : state)
+		{
+			for (number i = 0; i < BATCH; i++)
+			{
+				reads[i] = ((location + i) * (1 << 10)) % CAPACITY;
+			}
+			adapter.get(reads, read);
+			read.clear();
+
+			location++;
+		}
+
+		state.SetItemsProcessed(state.iterations() * BATCH);
+	}
+
+	// {round trip in microseconds, batch size}
+	BENCHMARK(SimulatedRoundTrip)
+		->ArgsProduct({{0, 100, 1000}, {1, 16, 256}})
+		->Iterations(1 << 7)
+		->UseRealTime()
+		->Unit(benchmark::kMicrosecond);
+
 	BENCHMARK_REGISTER_F(StorageAdapterBenchmark, Write)
 		->Apply(arguments)
 		->Unit(benchmark::kMicrosecond);
@@ -0,0 +1,317 @@
+#include "definitions.h"
+#include "metrics.hpp"
+#include "oram.hpp"
+#include "tracer.hpp"
+#include "utility.hpp"
+
+#include <benchmark/benchmark.h>
+#include <boost/format.hpp>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <functional>
+
+using namespace std;
+
+/**
+ * Workload-driven ORAM benchmarks.
+ *
+ * Synthetic workloads follow the YCSB core workloads (uniform or Zipfian keys, different read/write mixes, short scans).
+ * A trace is replayed with --trace=FILE, where FILE is a sequence of 8-byte little-endian records:
+ * the low 63 bits are the block ID, the high bit is set for PUT (and clear for GET).
+ *
+ * The ORAM is warmed up with a bulk load, then every iteration is one ORAM::multiple call (a batch).
+ * Besides the throughput, the p50, p99 and p999 latencies of the calls are reported (in microseconds).
+ * The output is JSON unless --benchmark_format is given.
+ *
+ * With --timeline=FILE, the calls, phases and storage calls of the measured batches are recorded
+ * and written to FILE as Chrome trace JSON (open it in Perfetto); the most recent 2^20 spans of the run are kept.
+ */
+namespace PathORAM
+{
+	enum Workload
+	{
+		WORKLOAD_UNIFORM,	  // uniform keys, 50% reads
+		WORKLOAD_ZIPFIAN,	  // Zipfian keys, 50% reads (YCSB A)
+		WORKLOAD_READ_HEAVY,  // Zipfian keys, 95% reads (YCSB B)
+		WORKLOAD_WRITE_HEAVY, // Zipfian keys, 5% reads
+		WORKLOAD_SCAN		  // reads of consecutive keys starting at a Zipfian key (YCSB E)
+	};
+
+	const number BLOCK_SIZE	 = 64;
+	const number Z			 = 4;
+	const number SCAN_LENGTH = 16;
+	const double THETA		 = 0.99; // Zipfian constant, as in YCSB
+
+	shared_ptr<Tracer> timeline; // set by --timeline
+
+	/**
+	 * @brief Zipfian distribution over [0, items), as in YCSB (Gray et al., "Quickly generating billion-record synthetic databases")
+	 */
+	class ZipfianGenerator
+	{
+		private:
+		const number items;
+		double zetan;
+		double alpha;
+		double eta;
+
+		public:
+		ZipfianGenerator(const number items) :
+			items(items)
+		{
+			zetan = 0;
+			for (number i = 1; i <= items; i++)
+			{
+				zetan += 1 / pow(i, THETA);
+			}
+			const auto zeta2 = 1 + 1 / pow(2, THETA);
+
+			alpha = 1 / (1 - THETA);
+			eta	  = (1 - pow(2.0 / items, 1 - THETA)) / (1 - zeta2 / zetan);
+		}
+
+		number next() const
+		{
+			const auto u  = getRandomDouble(1);
+			const auto uz = u * zetan;
+			if (uz < 1)
+			{
+				return 0;
+			}
+			if (uz < 1 + pow(0.5, THETA))
+			{
+				return 1;
+			}
+			return min(items - 1, (number)(items * pow(eta * u - eta + 1, alpha)));
+		}
+	};
+
+	/**
+	 * @brief constructs an ORAM that fits the elements (at most 3/4 full) and bulk loads them
+	 */
+	unique_ptr<ORAM> warmUp(const number elements, const number batchSize)
+	{
+		number logCapacity = 2;
+		while (((1uLL << logCapacity) * Z / 4) * 3 < elements)
+		{
+			logCapacity++;
+		}
+		const auto capacity = (1uLL << logCapacity) * Z;
+
+		auto oram = make_unique<ORAM>(
+			logCapacity,
+			BLOCK_SIZE,
+			Z,
+			make_shared<InMemoryStorageAdapter>((1 << logCapacity) + Z, BLOCK_SIZE, bytes(), Z),
+			make_shared<InMemoryPositionMapAdapter>(capacity + Z),
+			make_shared<InMemoryStashAdapter>(3 * logCapacity * Z),
+			true,
+			batchSize);
+
+		vector<block> data;
+		data.reserve(elements);
+		for (number id = 0; id < elements; id++)
+		{
+			data.push_back({id, bytes(BLOCK_SIZE, 0x25)});
+		}
+		oram->load(data);
+
+		return oram;
+	}
+
+	/**
+	 * @brief runs batches of requests given by next, and reports the throughput and the latency percentiles
+	 */
+	void drive(benchmark::State& state, ORAM& oram, const number batchSize, function<block()> next)
+	{
+		Histogram latency;
+
+		// the warm-up is not recorded
+		oram.setTracer(timeline);
+
+		vector<block> batch;
+		vector<bytes> response;
+		for (auto _ : state)
+		{
+			state.PauseTiming();
+			batch.clear();
+			for (number i = 0; i < batchSize; i++)
+			{
+				batch.push_back(next());
+			}
+			state.ResumeTiming();
+
+			const auto start = chrono::steady_clock::now();
+			oram.multiple(batch, response);
+			latency.record(chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - start).count());
+		}
+
+		oram.setTracer(nullptr);
+
+		const auto snapshot = latency.snapshot();
+		state.SetItemsProcessed(state.iterations() * batchSize);
+		state.counters["p50_us"]  = snapshot.percentile(0.5) / 1000.0;
+		state.counters["p99_us"]  = snapshot.percentile(0.99) / 1000.0;
+		state.counters["p999_us"] = snapshot.percentile(0.999) / 1000.0;
+	}
+
+	void Synthetic(benchmark::State& state, const Workload workload)
+	{
+		const number ELEMENTS = state.range(0);
+		const number BATCH	  = state.range(1);
+
+		auto oram = warmUp(ELEMENTS, BATCH);
+
+		const ZipfianGenerator zipfian(ELEMENTS);
+		const auto reads = workload == WORKLOAD_READ_HEAVY ? 0.95 : workload == WORKLOAD_WRITE_HEAVY ? 0.05 : 0.5;
+
+		number scanned = SCAN_LENGTH;
+		number scan	   = 0;
+		drive(state, *oram, BATCH, [&]() -> block {
+			switch (workload)
+			{
+				case WORKLOAD_UNIFORM:
+					return {getRandomULong(ELEMENTS), getRandomDouble(1) < reads ? bytes() : bytes(BLOCK_SIZE, 0x42)};
+				case WORKLOAD_SCAN:
+					if (scanned == SCAN_LENGTH)
+					{
+						scan	= zipfian.next();
+						scanned = 0;
+					}
+					return {(scan + scanned++) % ELEMENTS, bytes()};
+				default:
+					return {zipfian.next(), getRandomDouble(1) < reads ? bytes() : bytes(BLOCK_SIZE, 0x42)};
+			}
+		});
+	}
+
+	// {elements, batch size}
+	BENCHMARK_CAPTURE(Synthetic, Uniform, WORKLOAD_UNIFORM)
+		->ArgsProduct({{1 << 12, 1 << 16}, {1, 16}})
+		->Iterations(1 << 8)
+		->Unit(benchmark::kMillisecond);
+
+	BENCHMARK_CAPTURE(Synthetic, Zipfian, WORKLOAD_ZIPFIAN)
+		->ArgsProduct({{1 << 12, 1 << 16}, {1, 16}})
+		->Iterations(1 << 8)
+		->Unit(benchmark::kMillisecond);
+
+	BENCHMARK_CAPTURE(Synthetic, ReadHeavy, WORKLOAD_READ_HEAVY)
+		->ArgsProduct({{1 << 12, 1 << 16}, {1, 16}})
+		->Iterations(1 << 8)
+		->Unit(benchmark::kMillisecond);
+
+	BENCHMARK_CAPTURE(Synthetic, WriteHeavy, WORKLOAD_WRITE_HEAVY)
+		->ArgsProduct({{1 << 12, 1 << 16}, {1, 16}})
+		->Iterations(1 << 8)
+		->Unit(benchmark::kMillisecond);
+
+	BENCHMARK_CAPTURE(Synthetic, Scan, WORKLOAD_SCAN)
+		->ArgsProduct({{1 << 12, 1 << 16}, {1, 16}})
+		->Iterations(1 << 8)
+		->Unit(benchmark::kMillisecond);
+
+	/**
+	 * @brief reads a trace in the format described at the top of this file
+	 */
+	vector<number> readTrace(const string& filename)
+	{
+		ifstream file(filename, ios::binary | ios::ate);
+		if (!file)
+		{
+			throw Exception(boost::format("cannot open trace %1%") % filename);
+		}
+
+		vector<number> trace(file.tellg() / sizeof(number));
+		file.seekg(0);
+		file.read((char*)trace.data(), trace.size() * sizeof(number));
+		if (trace.empty())
+		{
+			throw Exception(boost::format("trace %1% is empty") % filename);
+		}
+
+		return trace;
+	}
+
+	void Trace(benchmark::State& state, const vector<number>& trace)
+	{
+		const number PUT   = 1uLL << 63;
+		const number BATCH = state.range(0);
+
+		number elements = 0;
+		for (auto&& record : trace)
+		{
+			elements = max(elements, (record & ~PUT) + 1);
+		}
+
+		auto oram = warmUp(elements, BATCH);
+
+		// the trace is replayed from the start once it ends
+		number position = 0;
+		drive(state, *oram, BATCH, [&]() -> block {
+			const auto record = trace[position++ % trace.size()];
+			return {record & ~PUT, (record & PUT) ? bytes(BLOCK_SIZE, 0x42) : bytes()};
+		});
+	}
+}
+
+int main(int argc, char** argv)
+{
+	vector<char*> arguments;
+	string trace, timeline;
+	auto format = false;
+	for (auto i = 0; i < argc; i++)
+	{
+		if (strncmp(argv[i], "--trace=", 8) == 0)
+		{
+			trace = argv[i] + 8;
+			continue;
+		}
+		if (strncmp(argv[i], "--timeline=", 11) == 0)
+		{
+			timeline = argv[i] + 11;
+			continue;
+		}
+		format |= strncmp(argv[i], "--benchmark_format=", 19) == 0;
+		arguments.push_back(argv[i]);
+	}
+
+	char json[] = "--benchmark_format=json";
+	if (!format)
+	{
+		arguments.push_back(json);
+	}
+
+	// each record is replayed once (per batch size)
+	vector<PathORAM::number> records;
+	if (!trace.empty())
+	{
+		records = PathORAM::readTrace(trace);
+		for (PathORAM::number batch : {1, 16})
+		{
+			benchmark::RegisterBenchmark("Trace", PathORAM::Trace, records)
+				->Arg(batch)
+				->Iterations((records.size() + batch - 1) / batch)
+				->Unit(benchmark::kMillisecond);
+		}
+	}
+
+	if (!timeline.empty())
+	{
+		PathORAM::timeline = make_shared<PathORAM::Tracer>(1 << 20);
+	}
+
+	auto count = (int)arguments.size();
+	benchmark::Initialize(&count, arguments.data());
+	benchmark::RunSpecifiedBenchmarks();
+	benchmark::Shutdown();
+
+	if (PathORAM::timeline)
+	{
+		PathORAM::timeline->dump(timeline);
+	}
+
+	return 0;
+}
@@ -0,0 +1,111 @@
+#pragma once
+
+#include "definitions.h"
+#include "oram.hpp"
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <future>
+#include <mutex>
+#include <thread>
+
+namespace PathORAM
+{
+	using namespace std;
+
+	/**
+	 * @brief Thread-safe front end to ORAM that coalesces concurrent requests into batches
+	 *
+	 * Callers from any thread submit get and put requests and receive futures.
+	 * A single dispatcher thread owns the ORAM and runs the queued requests with ORAM::multiple,
+	 * up to batchSize at a time.
+	 * A batch is dispatched as soon as it is full, or when the oldest queued request has waited for the deadline.
+	 *
+	 * \note
+	 * The ORAM must be constructed with a batch size of at least batchSize,
+	 * and must not be used directly while the front end is alive.
+	 * Requests are answered in the order they were submitted.
+	 */
+	class ConcurrentORAM
+	{
+		private:
+		// a queued request, empty payload means GET (as in ORAM::multiple)
+		struct Request
+		{
+			number block;
+			bytes data;
+			promise<bytes> result;
+			chrono::steady_clock::time_point submitted;
+		};
+
+		const shared_ptr<ORAM> oram;
+
+		const number batchSize;				  // the max number of requests per ORAM::multiple
+		const chrono::microseconds deadline; // the max time a request waits for the batch to fill
+
+		mutex lock;
+		condition_variable pending; // signalled on a new request and on stop
+		deque<Request> queue;
+		bool stopping  = false;
+		number batches = 0; // the number of ORAM::multiple calls made
+
+		thread dispatcher;
+
+		/**
+		 * @brief the dispatcher loop: waits for a full batch or a deadline, then runs the batch
+		 *
+		 * On stop, drains the queue before returning.
+		 */
+		void run();
+
+		/**
+		 * @brief puts the request in the queue and wakes the dispatcher
+		 *
+		 * @return future<bytes> the future of the answer
+		 */
+		future<bytes> submit(const number block, bytes &&data);
+
+		public:
+		/**
+		 * @brief Construct a new Concurrent ORAM object and start the dispatcher thread
+		 *
+		 * @param oram the ORAM to dispatch to (constructed with a batch size of at least batchSize)
+		 * @param batchSize the max number of requests in one ORAM::multiple call
+		 * @param deadline the max time a request waits in the queue for more requests to arrive
+		 */
+		ConcurrentORAM(const shared_ptr<ORAM> oram, const number batchSize, const chrono::microseconds deadline = chrono::microseconds(1000));
+
+		/**
+		 * @brief Stops the dispatcher thread after it answers all queued requests
+		 */
+		~ConcurrentORAM();
+
+		ConcurrentORAM(const ConcurrentORAM &) = delete;
+		ConcurrentORAM &operator=(const ConcurrentORAM &) = delete;
+
+		/**
+		 * @brief Retrives a block from ORAM (thread-safe)
+		 *
+		 * @param block block ID to request
+		 * @return future<bytes> the (decrypted) data from the block (empty if the block was never written)
+		 */
+		future<bytes> get(const number block);
+
+		/**
+		 * @brief Puts a block to ORAM (thread-safe)
+		 *
+		 * @param block block ID to request
+		 * @param data the (plaintext) data to put in the block (must not be empty)
+		 * @return future<bytes> completes with the supplied data once the block is written
+		 */
+		future<bytes> put(const number block, bytes data);
+
+		/**
+		 * @brief Returns the number of batches (ORAM::multiple calls) dispatched so far
+		 *
+		 * @return number the number of batches
+		 */
+		number dispatchedBatches();
+	};
+}
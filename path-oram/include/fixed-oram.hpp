@@ -0,0 +1,376 @@
+#pragma once
+
+#include "definitions.h"
+#include "position-map-adapter.hpp"
+#include "storage-adapter.hpp"
+#include "utility.hpp"
+
+#include <algorithm>
+#include <array>
+#include <boost/format.hpp>
+#include <openssl/aes.h>
+
+namespace PathORAM
+{
+	using namespace std;
+
+	/**
+	 * @brief PathORAM specialized at compile time for a fixed Z and block size
+	 *
+	 * Runs the same protocol as ORAM, but payloads are std::array<uchar, BlockSize> and buckets hold exactly Z blocks,
+	 * so bucket loops and payload copies have constant bounds (the compiler can unroll and vectorize them).
+	 *
+	 * The stash is built in: a preallocated array of blocks that also keeps their leaves,
+	 * so eviction does not consult the position map, and a FixedHashMap from IDs to the positions in the array.
+	 * A path is read and written through one preallocated buffer of fixed-size records
+	 * (see AbsStorageAdapter::get(locations, records)), so an access does not allocate.
+	 * Storage and position map adapters are the same as for ORAM.
+	 * The storage must be created with the same Z and block size.
+	 *
+	 * Only get and put are supported (one access at a time).
+	 * Use ORAM for multiple, load and pluggable stashes.
+	 *
+	 * @tparam Z number of blocks per bucket
+	 * @tparam BlockSize the size (user's portion) of ORAM block in bytes
+	 */
+	template <number Z, number BlockSize>
+	class FixedORAM
+	{
+		public:
+		using payload = array<uchar, BlockSize>;
+
+		private:
+		// a block in the stash: {ID, leaf, payload}
+		struct StashEntry
+		{
+			number id;
+			number leaf;
+			payload data;
+		};
+
+		const shared_ptr<AbsStorageAdapter> storage;
+		const shared_ptr<AbsPositionMapAdapter> map;
+
+		const number height;		// number of tree levels
+		const number leaves;		// number of leaves
+		const number stashCapacity; // maximum number of blocks in the stash
+		const number recordSize;	// the size of a block in the path buffer (ID padded to AES block, then payload)
+
+		vector<StashEntry> stash;
+		FixedHashMap stashIndex; // block ID -> position in stash
+
+		// the buckets of the current path: their locations, and their blocks as storage records (reused by every access)
+		vector<number> locations;
+		vector<uchar> path;
+
+		/**
+		 * @brief performs a single access, read or write
+		 *
+		 * @param block the block ID requested
+		 * @param data if not null, the data to be put in block (write access)
+		 * @param response the content of requested block (zeroes if it was never written)
+		 */
+		void access(const number block, const payload *data, payload &response);
+
+		/**
+		 * @brief puts a path into the stash
+		 *
+		 * @param leaf the leaf that uniquely defines the path from root
+		 */
+		void readPath(const number leaf);
+
+		/**
+		 * @brief write a path using the blocks from stash (greedy, from leaf to root)
+		 *
+		 * @param leaf the leaf that uniquely defines the path from root
+		 */
+		void writePath(const number leaf);
+
+		/**
+		 * @brief computes the location in the storage for a bucket (not block) in a given path on a given level
+		 *
+		 * @param level level in question
+		 * @param leaf leaf that defines the path in question
+		 * @return number the location of the requested bucket (not block) in the storage
+		 */
+		number bucketForLevelLeaf(const number level, const number leaf) const;
+
+		/**
+		 * @brief writes the ID of a block to a record of the path buffer (padded to AES block with zeroes)
+		 */
+		static void writeID(uchar *record, const number id);
+
+		/**
+		 * @brief removes the block at the position from the stash (the last block takes its place)
+		 */
+		void removeFromStash(const number position);
+
+		/**
+		 * @brief thorows exception if an insertion will cause an overflow (stash size growing beyond capacity)
+		 */
+		void checkOverflow() const;
+
+		public:
+		/**
+		 * @brief Construct a new Fixed ORAM object given adapters
+		 *
+		 * @param logCapacity height of the tree or logarithm base 2 of capacity (i.e. capacity is 2 to the power of this value)
+		 * @param storage pointer to storage adapter to use (created with the same Z and block size, otherwise throws exception)
+		 * @param map pointer to position map adapter to use
+		 * @param stashCapacity the maximum number of blocks in the stash
+		 * @param initialize whether to initialize map and storage
+		 */
+		FixedORAM(
+			const number logCapacity,
+			const shared_ptr<AbsStorageAdapter> storage,
+			const shared_ptr<AbsPositionMapAdapter> map,
+			const number stashCapacity,
+			const bool initialize = true);
+
+		/**
+		 * @brief Construct a new Fixed ORAM object with in-memory adapters
+		 *
+		 * The adapters are created with the same capacities as in ORAM(logCapacity, blockSize, Z).
+		 *
+		 * @param logCapacity height of the tree or logarithm base 2 of capacity (i.e. capacity is 2 to the power of this value)
+		 */
+		FixedORAM(const number logCapacity);
+
+		/**
+		 * @brief Retrives a block from ORAM
+		 *
+		 * @param block block ID to request
+		 * @param response the (decrypted) data from the block (zeroes if the block was never written)
+		 */
+		void get(const number block, payload &response);
+
+		/**
+		 * @brief Puts a block to ORAM
+		 *
+		 * @param block block ID to request
+		 * @param data the (plaintext) data to put in the block
+		 */
+		void put(const number block, const payload &data);
+
+		/**
+		 * @brief Returns the current size of the stash (in blocks)
+		 *
+		 * @return number the current size of the stash (in blocks)
+		 */
+		number stashSize() const;
+	};
+
+	template <number Z, number BlockSize>
+	FixedORAM<Z, BlockSize>::FixedORAM(
+		const number logCapacity,
+		const shared_ptr<AbsStorageAdapter> storage,
+		const shared_ptr<AbsPositionMapAdapter> map,
+		const number stashCapacity,
+		const bool initialize) :
+		storage(storage),
+		map(map),
+		height(logCapacity),
+		leaves(1uLL << (logCapacity - 1)),
+		stashCapacity(stashCapacity),
+		recordSize(AES_BLOCK_SIZE + BlockSize),
+		stashIndex(stashCapacity),
+		locations(logCapacity),
+		path(logCapacity * Z * (AES_BLOCK_SIZE + BlockSize))
+	{
+		// always checked, the path buffer is sized by Z and the block size
+		if (storage->bucketCapacity() != Z || storage->recordSize() != recordSize)
+		{
+			throw Exception(boost::format("storage with Z=%1% and block size %2% does not match Z=%3% and block size %4%") % storage->bucketCapacity() % (storage->recordSize() - AES_BLOCK_SIZE) % Z % BlockSize);
+		}
+
+		stash.reserve(stashCapacity);
+
+		if (initialize)
+		{
+			storage->fillWithZeroes();
+			map->initialize((1uLL << logCapacity) * Z, leaves);
+		}
+	}
+
+	template <number Z, number BlockSize>
+	FixedORAM<Z, BlockSize>::FixedORAM(const number logCapacity) :
+		FixedORAM(logCapacity,
+				  make_shared<InMemoryStorageAdapter>((1 << logCapacity), BlockSize, bytes(), Z),
+				  make_shared<InMemoryPositionMapAdapter>(((1 << logCapacity) * Z) + Z),
+				  3 * logCapacity * Z)
+	{
+	}
+
+	template <number Z, number BlockSize>
+	void FixedORAM<Z, BlockSize>::get(const number block, payload &response)
+	{
+		access(block, nullptr, response);
+	}
+
+	template <number Z, number BlockSize>
+	void FixedORAM<Z, BlockSize>::put(const number block, const payload &data)
+	{
+		payload response;
+		access(block, &data, response);
+	}
+
+	template <number Z, number BlockSize>
+	number FixedORAM<Z, BlockSize>::stashSize() const
+	{
+		return stash.size();
+	}
+
+	template <number Z, number BlockSize>
+	void FixedORAM<Z, BlockSize>::access(const number block, const payload *data, payload &response)
+	{
+		// remap block
+		const auto previousPosition = map->get(block);
+		const auto newPosition		= getRandomULong(leaves);
+		map->set(block, newPosition);
+
+		// read path
+		readPath(previousPosition);
+
+		// update block
+		number position;
+		auto found = stashIndex.get(block, position);
+		if (data != nullptr)
+		{
+			if (!found)
+			{
+				checkOverflow();
+				position = stash.size();
+				stashIndex.set(block, position);
+				stash.push_back({block, newPosition, payload()});
+				found = true;
+			}
+			stash[position].data = *data;
+		}
+
+		if (found)
+		{
+			stash[position].leaf = newPosition;
+			response			 = stash[position].data;
+		}
+		else
+		{
+			response.fill(0x00);
+		}
+
+		// write path
+		writePath(previousPosition);
+	}
+
+	template <number Z, number BlockSize>
+	void FixedORAM<Z, BlockSize>::readPath(const number leaf)
+	{
+		for (number level = 0; level < height; level++)
+		{
+			locations[level] = bucketForLevelLeaf(level, leaf);
+		}
+
+		storage->get(locations, path.data());
+
+		for (number i = 0; i < height * Z; i++)
+		{
+			const auto record = path.data() + i * recordSize;
+			const auto id	  = ((const number *)record)[0];
+
+			// skip "empty" blocks
+			if (id == ULONG_MAX)
+			{
+				continue;
+			}
+
+			checkOverflow();
+			stashIndex.set(id, stash.size());
+			stash.push_back({id, map->get(id), payload()});
+			copy_n(record + AES_BLOCK_SIZE, BlockSize, stash.back().data.begin());
+		}
+	}
+
+	template <number Z, number BlockSize>
+	void FixedORAM<Z, BlockSize>::writePath(const number leaf)
+	{
+		// following the path from leaf to root (greedy), the buckets are written in place to the path buffer
+		for (number i = 0; i < height; i++)
+		{
+			const auto level = height - 1 - i;
+			const auto shift = height - 1 - level;
+			const auto node	 = leaf >> shift;
+
+			const auto bucket = path.data() + i * Z * recordSize;
+			number inserted	  = 0;
+
+			// a block fits in this bucket if its path shares the node on this level
+			for (number j = 0; j < stash.size() && inserted < Z;)
+			{
+				if ((stash[j].leaf >> shift) == node)
+				{
+					const auto record = bucket + inserted++ * recordSize;
+					writeID(record, stash[j].id);
+					copy_n(stash[j].data.begin(), BlockSize, record + AES_BLOCK_SIZE);
+
+					removeFromStash(j);
+				}
+				else
+				{
+					j++;
+				}
+			}
+
+			// if nothing to insert, insert dummy (for security)
+			for (; inserted < Z; inserted++)
+			{
+				const auto record = bucket + inserted * recordSize;
+				writeID(record, ULONG_MAX);
+				getRandomBlock(record + AES_BLOCK_SIZE, BlockSize);
+			}
+
+			locations[i] = bucketForLevelLeaf(level, leaf);
+		}
+
+		storage->set(locations, path.data());
+	}
+
+	template <number Z, number BlockSize>
+	number FixedORAM<Z, BlockSize>::bucketForLevelLeaf(const number level, const number leaf) const
+	{
+		return (leaf + leaves) >> (height - 1 - level);
+	}
+
+	template <number Z, number BlockSize>
+	void FixedORAM<Z, BlockSize>::writeID(uchar *record, const number id)
+	{
+		copy_n((const uchar *)&id, sizeof(number), record);
+		fill_n(record + sizeof(number), AES_BLOCK_SIZE - sizeof(number), 0x00);
+	}
+
+	template <number Z, number BlockSize>
+	void FixedORAM<Z, BlockSize>::removeFromStash(const number position)
+	{
+		// order does not matter
+		stashIndex.remove(stash[position].id);
+		if (position != stash.size() - 1)
+		{
+			stash[position] = stash.back();
+			stashIndex.set(stash[position].id, position);
+		}
+		stash.pop_back();
+	}
+
+	template <number Z, number BlockSize>
+	void FixedORAM<Z, BlockSize>::checkOverflow() const
+	{
+		// not only with INPUT_CHECKS: the stash index is sized for stashCapacity blocks
+		if (stash.size() == stashCapacity)
+		{
+			throw Exception(boost::format("trying to insert over capacity (capacity %1%)") % stashCapacity);
+		}
+	}
+
+	// common configurations are compiled once, in the library
+	extern template class FixedORAM<3, 32>;
+	extern template class FixedORAM<4, 64>;
+	extern template class FixedORAM<4, 4096>;
+}
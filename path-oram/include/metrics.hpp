@@ -0,0 +1,155 @@
+#pragma once
+
+#include "definitions.h"
+
+#include <array>
+#include <atomic>
+
+namespace PathORAM
+{
+	using namespace std;
+
+	/**
+	 * @brief A point-in-time copy of a Histogram
+	 */
+	struct HistogramSnapshot
+	{
+		number count = 0; // the number of recorded values
+		number sum	 = 0; // the sum of recorded values
+		number max	 = 0; // the largest recorded value
+		vector<number> counts; // counts[i] is the number of values in bucket i (see Histogram::lowerBound)
+
+		/**
+		 * @brief estimates a quantile (the lower bound of the bucket that holds it)
+		 *
+		 * @param quantile the quantile, from 0 to 1 (e.g. 0.99 for p99)
+		 * @return number the estimate (0 if no values were recorded)
+		 */
+		number percentile(const double quantile) const;
+
+		/**
+		 * @brief the mean of recorded values (0 if none)
+		 */
+		double mean() const;
+	};
+
+	/**
+	 * @brief Lock-free log-linear histogram of non-negative integers (e.g. latencies in nanoseconds)
+	 *
+	 * Each power of two is split into SUB_BUCKETS linear buckets (values below SUB_BUCKETS have their own buckets),
+	 * so the relative error of a bucket is at most 1 / SUB_BUCKETS.
+	 * The buckets are preallocated atomics: recording is wait-free and does not allocate,
+	 * and a snapshot can be taken at any time, concurrently with recording.
+	 */
+	class Histogram
+	{
+		public:
+		inline static const number SUB_BITS	   = 3;
+		inline static const number SUB_BUCKETS = 1 << SUB_BITS;
+		inline static const number BUCKETS	   = (64 - SUB_BITS + 1) * SUB_BUCKETS;
+
+		/**
+		 * @brief records a value
+		 */
+		void record(const number value);
+
+		/**
+		 * @brief copies the current state
+		 *
+		 * Taken concurrently with recording, the fields may be off by the values being recorded.
+		 */
+		HistogramSnapshot snapshot() const;
+
+		/**
+		 * @brief clears all buckets
+		 */
+		void reset();
+
+		/**
+		 * @brief the bucket that holds a value
+		 */
+		static number bucket(const number value);
+
+		/**
+		 * @brief the smallest value that falls in a bucket
+		 */
+		static number lowerBound(const number bucket);
+
+		private:
+		array<atomic<number>, BUCKETS> counts = {};
+		atomic<number> count				  = 0;
+		atomic<number> sum					  = 0;
+		atomic<number> max					  = 0;
+	};
+
+	/**
+	 * @brief A point-in-time copy of StorageMetrics
+	 */
+	struct StorageMetricsSnapshot
+	{
+		number reads		  = 0; // the number of storage read calls (a batch is one call)
+		number writes		  = 0; // the number of storage write calls (a batch is one call)
+		number readBuckets	  = 0; // the number of buckets read
+		number writtenBuckets = 0; // the number of buckets written
+		number readBytes	  = 0; // raw (encrypted) bytes read
+		number writtenBytes	  = 0; // raw (encrypted) bytes written
+
+		HistogramSnapshot readLatency;	// nanoseconds per read call
+		HistogramSnapshot writeLatency; // nanoseconds per write call
+		HistogramSnapshot readBatch;	// buckets per read call
+		HistogramSnapshot writeBatch;	// buckets per write call
+	};
+
+	/**
+	 * @brief Always-on, lock-free metrics of a storage adapter
+	 *
+	 * Counters are relaxed atomics and histograms are preallocated (see Histogram),
+	 * so recording a call does not lock or allocate.
+	 */
+	class StorageMetrics
+	{
+		public:
+		/**
+		 * @brief records a read call
+		 *
+		 * @param buckets the number of buckets read
+		 * @param size the number of raw bytes read
+		 * @param elapsed the duration of the call in nanoseconds
+		 */
+		void recordRead(const number buckets, const number size, const number elapsed);
+
+		/**
+		 * @brief records a write call
+		 *
+		 * @param buckets the number of buckets written
+		 * @param size the number of raw bytes written
+		 * @param elapsed the duration of the call in nanoseconds
+		 */
+		void recordWrite(const number buckets, const number size, const number elapsed);
+
+		/**
+		 * @brief copies the current state (may be called concurrently with recording)
+		 *
+		 * @param histograms whether to copy the histograms (if not, they are left empty)
+		 */
+		StorageMetricsSnapshot snapshot(const bool histograms = true) const;
+
+		/**
+		 * @brief clears all counters and histograms
+		 */
+		void reset();
+
+		private:
+		atomic<number> reads		  = 0;
+		atomic<number> writes		  = 0;
+		atomic<number> readBuckets	  = 0;
+		atomic<number> writtenBuckets = 0;
+		atomic<number> readBytes	  = 0;
+		atomic<number> writtenBytes	  = 0;
+
+		Histogram readLatency;
+		Histogram writeLatency;
+		Histogram readBatch;
+		Histogram writeBatch;
+	};
+}
@@ -0,0 +1,91 @@
+#pragma once
+
+#include "definitions.h"
+#include "oram.hpp"
+
+#include <functional>
+
+namespace PathORAM
+{
+	using namespace std;
+
+	/**
+	 * @brief parameters of one level of a recursive ORAM
+	 *
+	 * Level 0 holds the user's data, level i + 1 is the position map of level i.
+	 */
+	struct ORAMLevel
+	{
+		number logCapacity;	  // height of the tree (as in ORAM constructor)
+		number blockSize;	  // the user's portion of the block in bytes
+		number Z;			  // number of blocks per bucket
+		number stashCapacity; // maximum number of blocks in the stash
+		number plbCapacity;	  // PLB capacity of the position map adapter that uses this level (0 for level 0)
+	};
+
+	/**
+	 * @brief creates a storage adapter for a level of a recursive ORAM
+	 *
+	 * Receives the level (0 is the data level), the capacity in buckets, the block size and Z.
+	 * May be used to give each level its own storage or namespace (e.g. Aerospike set).
+	 */
+	using StorageFactory = function<shared_ptr<AbsStorageAdapter>(const number level, const number capacity, const number blockSize, const number Z)>;
+
+	/**
+	 * @brief computes the recursion levels for an ORAM that has to fit a client memory budget
+	 *
+	 * Client memory is counted as the stashes of all levels, the PLBs and the in-memory position map of the last level.
+	 * Storage is assumed to be remote and is not counted.
+	 * Levels are added until the last position map fits the budget.
+	 * The block size (32 to 256 bytes) and Z (3 or 4) of the position map levels are chosen to minimize
+	 * the number of bytes transferred per access.
+	 * Each tree is at most 3/4 full.
+	 *
+	 * Throws exception if the budget cannot be met.
+	 *
+	 * @param capacity the number of (user's) blocks
+	 * @param blockSize the size of the user's block in bytes
+	 * @param Z the number of blocks in a bucket of the data level
+	 * @param memoryBudget the client memory budget in bytes
+	 * @param plbCapacity the number of blocks in the PLB of each position map level (0 to disable PLB, a PLB leaks the hit/miss pattern, see ORAMPositionMapAdapter)
+	 * @return vector<ORAMLevel> the levels, from data level to the last position map level
+	 */
+	vector<ORAMLevel> planRecursiveORAM(const number capacity, const number blockSize, const number Z, const number memoryBudget, const number plbCapacity = 0);
+
+	/**
+	 * @brief client memory (in bytes) a given plan will use
+	 *
+	 * @param levels the levels as returned by planRecursiveORAM
+	 * @return number the number of bytes
+	 */
+	number plannedMemoryUsage(const vector<ORAMLevel> &levels);
+
+	/**
+	 * @brief builds the chain of ORAMs and position map adapters for the given levels
+	 *
+	 * The last level uses an in-memory position map.
+	 * All levels use in-memory stashes.
+	 *
+	 * @param levels the levels as returned by planRecursiveORAM
+	 * @param storageFactory creates storage for each level (in-memory storage is used if empty)
+	 * @param batchSize the batch size of the data level ORAM
+	 * @return unique_ptr<ORAM> the data level ORAM (it holds the rest of the chain)
+	 */
+	unique_ptr<ORAM> buildRecursiveORAM(const vector<ORAMLevel> &levels, const StorageFactory &storageFactory = nullptr, const number batchSize = 1);
+
+	/**
+	 * @brief plans and builds a recursive ORAM that fits a client memory budget
+	 *
+	 * Same as buildRecursiveORAM(planRecursiveORAM(...), ...).
+	 *
+	 * @param capacity the number of (user's) blocks
+	 * @param blockSize the size of the user's block in bytes
+	 * @param Z the number of blocks in a bucket of the data level
+	 * @param memoryBudget the client memory budget in bytes
+	 * @param storageFactory creates storage for each level (in-memory storage is used if empty)
+	 * @param plbCapacity the number of blocks in the PLB of each position map level (0 to disable PLB, a PLB leaks the hit/miss pattern, see ORAMPositionMapAdapter)
+	 * @param batchSize the batch size of the data level ORAM
+	 * @return unique_ptr<ORAM> the data level ORAM (it holds the rest of the chain)
+	 */
+	unique_ptr<ORAM> buildRecursiveORAM(const number capacity, const number blockSize, const number Z, const number memoryBudget, const StorageFactory &storageFactory = nullptr, const number plbCapacity = 0, const number batchSize = 1);
+}
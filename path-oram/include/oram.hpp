@@ -4,10 +4,12 @@
 #include "position-map-adapter.hpp"
 #include "stash-adapter.hpp"
 #include "storage-adapter.hpp"
+#include "tracer.hpp"
 
+#include <chrono>
 #include <iostream>
+#include <tuple>
 #include <unordered_map>
-#include <unordered_set>
 
 namespace PathORAM
 {
@@ -15,6 +17,68 @@ namespace PathORAM
 
 	class AbsPositionMapAdapter;
 
+	/**
+	 * @brief the phases of ORAM accesses, reported with their duration (see ORAM::subscribe)
+	 */
+	enum ORAMPhase
+	{
+		PHASE_POSITION_MAP, // position map lookup and remap (includes recursive ORAM accesses)
+		PHASE_PATH_READ,	// reading raw buckets from the storage
+		PHASE_DECRYPT,		// decrypting the buckets read
+		PHASE_STASH,		// putting the path in the stash, and reading or updating the block
+		PHASE_EVICT,		// choosing blocks from the stash for the path (writing them to the cache)
+		PHASE_ENCRYPT,		// encrypting the buckets to write
+		PHASE_WRITE_BACK	// writing raw buckets to the storage
+	};
+
+	/**
+	 * @brief stash occupancy of an ORAM, sampled after every access (after eviction)
+	 */
+	struct StashOccupancy
+	{
+		number current		 = 0;  // the number of blocks in the stash after the last access
+		number max			 = 0;  // the largest number of blocks observed
+		number accesses		 = 0;  // the number of samples (accesses)
+		number dummyAccesses = 0;  // the number of background eviction accesses (see ORAM::setBackgroundEviction)
+		vector<number> histogram; // histogram[s] is the number of accesses after which the stash held s blocks
+	};
+
+	/**
+	 * @brief bandwidth and round trips of an ORAM call, filled in if requested (see ORAM::get)
+	 *
+	 * The counters are added to (so one object may sum several calls).
+	 * The storage counters include the traffic of the recursive position map ORAMs (see ORAMPositionMapAdapter),
+	 * the dummy accesses of a batch and background eviction.
+	 */
+	struct AccessStats
+	{
+		number bucketsRead		 = 0; // the number of buckets read from the storage
+		number bucketsWritten	 = 0; // the number of buckets written to the storage
+		number bytesRead		 = 0; // raw (encrypted) bytes read from the storage
+		number bytesWritten		 = 0; // raw (encrypted) bytes written to the storage
+		number storageCalls		 = 0; // the number of storage requests (a batch is one request, i.e. one round trip)
+		number cacheHits		 = 0; // the number of buckets of accessed paths found in the cache (not read again)
+		number recursiveAccesses = 0; // the number of accesses to the position map ORAMs (on all levels)
+		number stashSize		 = 0; // the number of blocks in the stash after the eviction of the last access
+	};
+
+	/**
+	 * @brief an estimate of the client memory held by an ORAM, in bytes (see ORAM::memoryUsage)
+	 */
+	struct MemoryUsage
+	{
+		number storage	   = 0; // the storage adapter (all buckets for in-memory storage, see AbsStorageAdapter::memoryUsage)
+		number positionMap = 0; // the position map adapter, without the underlying ORAMs
+		number stash	   = 0; // the stash adapter
+		number cache	   = 0; // the cache of buckets and the arena of their payloads (the arena is kept between calls)
+		number recursive   = 0; // the underlying ORAMs of the position map, on all levels (see ORAMPositionMapAdapter)
+
+		/**
+		 * @brief the sum of all parts
+		 */
+		number total() const;
+	};
+
 	/**
 	 * @brief PathORAM class
 	 *
@@ -24,6 +88,10 @@ namespace PathORAM
 	 */
 	class ORAM
 	{
+		public:
+		// the signal raised after each phase of an access (see subscribe)
+		using OnPhase = boost::signals2::signal<void(const ORAMPhase phase, const number elapsed)>;
+
 		private:
 		const shared_ptr<AbsStorageAdapter> storage;
 		const shared_ptr<AbsPositionMapAdapter> map;
@@ -38,19 +106,89 @@ namespace PathORAM
 
 		const number batchSize; // a max number of requests to process at a time (default 1)
 
+		number evictionWatermark = 0; // run dummy accesses while the stash holds at least this many blocks (0 disables)
+		number maxEvictions		 = 0; // the maximum number of dummy accesses after one access
+
+		StashOccupancy occupancy;
+
+		// Event handler
+		OnPhase onPhase;
+		bool timing = false; // whether anyone is subscribed to onPhase (checked once per call)
+
+		AccessStats *stats = nullptr;		// the stats requested for the current call (if any)
+		StorageMetricsSnapshot statsStart; // the storage counters at the start of the call (if stats are requested)
+
+		shared_ptr<Tracer> tracer;				   // if not null, phases and calls are recorded here (see setTracer)
+
+		// fixed-size chunks for the payloads in the cache
+		// (declared before the cache, so that it outlives the payloads)
+		BlockArena arena;
+
 		// a layer between (expensive) storage and the protocol;
 		// holds items (buckets of blocks) in memory and unencrypted;
-		unordered_map<number, bucket> cache;
+		// the first cacheSize slots are in use, the rest keep their buckets (and capacity) for the next calls
+		vector<pair<number, arenaBucket>> cache;
+		unique_ptr<FixedHashMap> cacheIndex; // location -> slot in cache (replaced by a larger one when full)
+		number cacheCapacity;				 // the maximum number of entries in cacheIndex
+		number cacheSize = 0;				 // the number of slots in use
+
+		// scratch buffers of an access, kept between calls so that steady-state accesses do not allocate
+		vector<number> path;									   // the bucket locations of the current path (or paths of a batch)
+		vector<number> missing;									   // the locations to download (see getCache)
+		vector<arenaBlock> downloaded;							   // the downloaded blocks, before they move to the cache
+		vector<const arenaBlock *> pathBlocks;					   // the blocks of the path read into the stash
+		vector<tuple<number, number, const uchar *, number>> eligible; // stash entries {ID, leaf, data, size} during eviction
+		vector<number> evictedIDs;								   // the blocks evicted from the stash
+		vector<pair<number, arenaBucket>> evicted;				   // the buckets of the evicted path (swapped with the cache slots)
 
 		/**
 		 * @brief performs a single access, read or write
 		 *
-		 * @param read true of read access, false if write access
 		 * @param block the block ID requested
-		 * @param data if write, the data to be put in block (discarded if read)
-		 * @param response if read, the content of requested block (empty if write)
+		 * @param data if not null, the data to be put in block (write access); it is moved into the stash
+		 * @param response if not null, receives the content of the block before the write (blockSize bytes, zero-padded)
+		 * @return number the size of the content written to response (0 if the block was never written)
 		 */
-		void access(const bool read, const number block, const bytes &data, bytes &response);
+		number access(const number block, bytes *data, uchar *response);
+
+		/**
+		 * @brief checks the number of requests against the batch size, groups them by ID and downloads all the paths into the cache
+		 *
+		 * The first request for an ID gets the path of the block,
+		 * every repeated one gets a uniformly random path for a dummy access.
+		 *
+		 * @param requests the requests as given to multiple
+		 * @param groups the distinct IDs in order of first appearance, each with the indices of its requests (in order)
+		 * @param dummies for each repeated request, its ID and the leaf of the dummy access
+		 */
+		void prefetch(const vector<block> &requests, vector<pair<number, vector<number>>> &groups, vector<pair<number, number>> &dummies);
+
+		/**
+		 * @brief the index of the last PUT among the requests (ULONG_MAX if all are GET)
+		 */
+		number lastPut(const vector<block> &requests, const vector<number> &indices) const;
+
+		/**
+		 * @brief runs the dummy accesses in place of the repeated requests
+		 *
+		 * Each makes the same position map calls as access (without changing the leaf),
+		 * reads and writes the path of its leaf and records the stash occupancy.
+		 *
+		 * @param dummies the {ID, leaf} pairs as given by prefetch
+		 */
+		void dummyRequests(const vector<pair<number, number>> &dummies);
+
+		/**
+		 * @brief reads a path into the stash and evicts to it (no block is accessed)
+		 *
+		 * @param leaf the leaf that defines the path (uniformly random for security)
+		 */
+		void dummyAccess(const number leaf);
+
+		/**
+		 * @brief runs background eviction if needed, and records the stash occupancy
+		 */
+		void afterAccess();
 
 		/**
 		 * @brief puts a path into the stash
@@ -60,8 +198,11 @@ namespace PathORAM
 		 * @param response path locations of the blocks in the path (will be populated)
 		 * @param putInStash if set, the path will be read from storage and put in stash.
 		 * Otherwise, will only populate the locations of blocks in the path.
+		 * @param wanted the ID of a block to copy to response if it is on the path (ULONG_MAX for none)
+		 * @param response the buffer of at least dataSize bytes for the wanted block (may be nullptr)
+		 * @return true if the wanted block was on the path and has been copied to response
 		 */
-		void readPath(const number leaf, unordered_set<number> &path, const bool putInStash);
+		bool readPath(const number leaf, vector<number> &path, const bool putInStash, const number wanted = ULONG_MAX, uchar *response = nullptr);
 
 		/**
 		 * @brief write a path using the blocks from stash
@@ -71,6 +212,15 @@ namespace PathORAM
 		 */
 		void writePath(const number leaf);
 
+		/**
+		 * @brief same as writePath, but takes the eligible blocks for each bucket directly from the stash
+		 * (if the stash indexes leaves, see AbsStashAdapter::forEachInRange)
+		 *
+		 * @param leaf the leaf that uniquely defines the path from root.
+		 * Leaves are numbered from 0 to N.
+		 */
+		void writePathIndexed(const number leaf);
+
 		/**
 		 * @brief checks if the paths "merge" on the level
 		 *
@@ -103,33 +253,94 @@ namespace PathORAM
 		 * @brief make GET requests to the storage through cache.
 		 * That is, upon the cache miss the item will be downloaded and stored in cache.
 		 *
-		 * @param locations the addresses of the blocks to read
-		 * @param response the read blocks split into ORAM id and payload
+		 * @param locations the addresses of the blocks to read (distinct)
+		 * @param response the read blocks split into ORAM id and payload (appended; pointers to the cache, valid until the cache is modified)
 		 * @param dryRun if set, will not populate response (will only download and put in interanal cache)
 		 */
-		void getCache(const unordered_set<number> &locations, vector<block> &response, const bool dryRun);
+		void getCache(const vector<number> &locations, vector<const arenaBlock *> &response, const bool dryRun);
 
 		/**
 		 * @brief make SET requests to the storage through cache.
 		 * This will NOT update the storage, only the cache (see syncCache).
 		 *
-		 * @param requests the set requests in a form of {address, {bucket of {ORAM ID, payload}}}
+		 * @param requests the set requests in a form of {address, {bucket of {ORAM ID, payload}}};
+		 * the buckets are swapped into the cache, and come back emptied (with the capacity of the buckets they replaced)
+		 */
+		void setCache(vector<pair<number, arenaBucket>> &requests);
+
+		/**
+		 * @brief the slot of the location in the cache, taking a new one if the location is not cached
 		 */
-		void setCache(const vector<pair<number, bucket>> &requests);
+		number cacheSlot(const number location);
 
 		/**
 		 * @brief upload all cache content to the storage and empty the cache
 		 */
 		void syncCache();
 
+		/**
+		 * @brief empties the cache without uploading it (the payloads go back to the arena, the slots are kept)
+		 */
+		void clearCache();
+
+		/**
+		 * @brief enables the phase timers for this call if there are subscribers,
+		 * and starts counting the traffic if stats are requested
+		 *
+		 * @param stats the stats to fill in (may be nullptr)
+		 */
+		void startCall(AccessStats *stats);
+
+		/**
+		 * @brief adds the traffic of this call to the requested stats (if any)
+		 *
+		 * Detaches the stats from the ORAM and the position map, so it must run even if the call throws (see Call).
+		 */
+		void finishCall();
+
+		/**
+		 * @brief scope guard of a public call: startCall on construction, finishCall on destruction (also during unwinding)
+		 *
+		 * If tracing, the call is also a trace batch, recorded as a span after finishCall.
+		 */
+		class Call
+		{
+			private:
+			ORAM *const oram;
+			const TraceBatch batch;
+
+			public:
+			Call(ORAM *oram, AccessStats *stats, const char *name);
+			~Call();
+
+			Call(const Call &) = delete;
+			Call &operator=(const Call &) = delete;
+		};
+
+		/**
+		 * @brief the current time if the phase timers or tracing are enabled (the clock is not read otherwise)
+		 */
+		chrono::steady_clock::time_point startPhase() const;
+
+		/**
+		 * @brief reports the time since start for the phase if the phase timers are enabled, and records its span if tracing
+		 */
+		void stopPhase(const ORAMPhase phase, const chrono::steady_clock::time_point start);
+
 		friend class ORAMTest_LeavesForLocation_Test;
 		friend class ORAMTest_BucketFromLevelLeaf_Test;
 		friend class ORAMTest_CanInclude_Test;
 		friend class ORAMTest_ReadPath_Test;
+		friend class ORAMTest_ReadPathServesWanted_Test;
 		friend class ORAMTest_ConsistencyCheck_Test;
 		friend class ORAMTest_MultipleCheckCache_Test;
 		friend class ORAMTest_MultipleGetNoDuplicates_Test;
+		friend class ORAMTest_AccessStatsThrow_Test;
 		friend class ORAMBigTest;
+		friend class ORAMInternalsBenchmark;
+		friend class ORAMPositionMapAdapter;
+		friend class PositionMapAdapterTest_PLBNeighbors_Test;
+		friend class PositionMapAdapterTest_PLBFixedRate_Test;
 
 		public:
 		/**
@@ -179,23 +390,51 @@ namespace PathORAM
 		 *
 		 * @param block block ID to request
 		 * @param response the (decrypted) data from the block
+		 * @param stats if not null, receives the bandwidth and round trips of the call
 		 */
-		void get(const number block, bytes &response);
+		void get(const number block, bytes &response, AccessStats *stats = nullptr);
 
 		/**
 		 * @brief Puts a block to ORAM
 		 *
 		 * @param block block ID to request
 		 * @param data the (plaintext) data to put in the block
+		 * @param stats if not null, receives the bandwidth and round trips of the call
+		 */
+		void put(const number block, const bytes &data, AccessStats *stats = nullptr);
+
+		/**
+		 * @brief Retrives a block from ORAM into a caller-provided buffer
+		 *
+		 * The payload is copied once, from the stash to the buffer.
+		 *
+		 * @param block block ID to request
+		 * @param response the buffer for the (decrypted) data, must hold blockSize bytes
+		 * (the bytes past the block content are zeroed)
+		 * @param stats if not null, receives the bandwidth and round trips of the call
+		 * @return number the size of the block content (0 if the block was never written)
+		 */
+		number get(const number block, uchar *response, AccessStats *stats = nullptr);
+
+		/**
+		 * @brief Puts a block to ORAM taking ownership of the data
+		 *
+		 * Same as put(block, const bytes &), but the data is moved into the stash (if the stash adapter supports it).
+		 *
+		 * @param block block ID to request
+		 * @param data the (plaintext) data to put in the block
+		 * @param stats if not null, receives the bandwidth and round trips of the call
 		 */
-		void put(const number block, const bytes &data);
+		void put(const number block, bytes &&data, AccessStats *stats = nullptr);
 
 		/**
 		 * @brief processes multiple requests at a time
 		 *
 		 * \note
-		 * If a sequence contains duplicates, those duplicate requests will miss the cache.
-		 * The answer will still be correct, and operation secure, just not optimal.
+		 * If a sequence contains duplicates, only one access is made per distinct ID
+		 * (it reads the block and writes the value of its last PUT), and the requests are applied in order.
+		 * Each repeated request is replaced with a dummy access to a random path,
+		 * so the number of accesses (and paths read) is the same as without duplicates.
 		 *
 		 * @param requests the sequence of requests in a form of {ID, payload}
 		 * If payload is empty (zero size), the requests is treated as GET, otherwise PUT.
@@ -203,11 +442,25 @@ namespace PathORAM
 		 * Matches the order of requests.
 		 * For a GET request the answer is a payload for ID.
 		 * For a PUT request the supplied payload is returned.
+		 * @param stats if not null, receives the bandwidth and round trips of the whole batch
 		 *
 		 * \note
 		 * The number fo request must not exceed the batchSize parameter used to construct the ORAM.
 		 */
-		void multiple(const vector<block> &requests, vector<bytes> &response);
+		void multiple(const vector<block> &requests, vector<bytes> &response, AccessStats *stats = nullptr);
+
+		/**
+		 * @brief processes multiple requests at a time, answering into a caller-provided buffer
+		 *
+		 * Same as multiple(requests, vector<bytes>), but PUT payloads are moved into the stash
+		 * and the answers are copied once, from the stash to the buffer.
+		 *
+		 * @param requests the sequence of requests in a form of {ID, payload} (the payloads are consumed)
+		 * @param response the buffer of (number of requests * blockSize) bytes;
+		 * the answer to request i is at offset i * blockSize (zero-padded, all zeroes if the block was never written)
+		 * @param stats if not null, receives the bandwidth and round trips of the whole batch
+		 */
+		void multiple(vector<block> &&requests, uchar *response, AccessStats *stats = nullptr);
 
 		/**
 		 * @brief bulk loads the data bypassing usual ORAM protocol
@@ -215,7 +468,7 @@ namespace PathORAM
 		 * Loads the data straight to the storage preserving ORAM invariant.
 		 * Shuffles the data before inserting (to hide the original order).
 		 * Puts data blocks into locations in-order (skipping some location to disperse).
-		 * Then constructs position map randomly to satisfy the invariant.
+		 * Then constructs position map randomly to satisfy the invariant (in one bulk call, see AbsPositionMapAdapter::load).
 		 * Throws exception if ORAM capacity is too small.
 		 *
 		 * \note
@@ -226,5 +479,63 @@ namespace PathORAM
 		 * @param data the data to bulk load
 		 */
 		void load(vector<block> &data);
+
+		/**
+		 * @brief enables background eviction
+		 *
+		 * After an access, while the stash holds at least watermark blocks,
+		 * ORAM runs dummy accesses (reads a random path into the stash and evicts to it), up to maxAccesses of them.
+		 * This lets the stash shrink before it overflows, so smaller stash capacities and higher load factors can be used.
+		 *
+		 * \note
+		 * The storage observes the extra path reads and writes, and thus when the stash is above the watermark.
+		 * The stash occupancy depends only on the random leaves, not on the requested IDs.
+		 *
+		 * @param watermark the stash size that triggers dummy accesses (0 disables background eviction)
+		 * @param maxAccesses the maximum number of dummy accesses after one access
+		 */
+		void setBackgroundEviction(const number watermark, const number maxAccesses = 4);
+
+		/**
+		 * @brief Subscribes to the phase timers
+		 *
+		 * The handler receives the phase and its duration in nanoseconds, every time a phase completes
+		 * (an access reports each phase at least once, a batch reports path read and write back once for all requests).
+		 * The timers only run while there are subscribers (the clock is not read otherwise).
+		 *
+		 * @param handler the handler to execute with event
+		 * @return boost::signals2::connection the connection object (to be used for unsubscribing)
+		 */
+		boost::signals2::connection subscribe(const OnPhase::slot_type &handler);
+
+		/**
+		 * @brief Starts (or stops) recording the access timeline (see Tracer)
+		 *
+		 * Each call (get, put or multiple) is a span and a batch, and so are the position map, stash and eviction phases.
+		 * The tracer is also set on the storage (storage calls, encryption and decryption)
+		 * and on the position map (the accesses of position map ORAMs join the batch of the call).
+		 * While disabled (default), no clocks are read for tracing.
+		 * Must not be called concurrently with ORAM calls.
+		 *
+		 * @param tracer where to record the spans (nullptr to stop)
+		 */
+		void setTracer(const shared_ptr<Tracer> tracer);
+
+		/**
+		 * @brief returns the stash occupancy statistics (sampled after every access since construction)
+		 *
+		 * @return StashOccupancy the statistics
+		 */
+		StashOccupancy stashOccupancy() const;
+
+		/**
+		 * @brief returns an estimate of the client memory held by the ORAM and its adapters
+		 *
+		 * The estimate counts the payloads and the containers that hold them (not the allocator overhead).
+		 * Adapters shared with another ORAM are counted in both.
+		 *
+		 * @return MemoryUsage the memory in bytes, by part
+		 */
+		MemoryUsage memoryUsage() const;
 	};
 }
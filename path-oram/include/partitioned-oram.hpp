@@ -0,0 +1,168 @@
+#pragma once
+
+#include "definitions.h"
+#include "oram.hpp"
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+
+namespace PathORAM
+{
+	using namespace std;
+
+	/**
+	 * @brief ORAM that spreads the blocks over independent sub-ORAMs (partitions), as in Partition ORAM
+	 *
+	 * Each partition is a regular ORAM with its own storage, position map and stash, driven by its own worker thread.
+	 * The client keeps the location of every block: a partition chosen uniformly at random, and a slot (block ID) in that partition.
+	 *
+	 * Every access reads the block from its partition and assigns it to a fresh random partition (reshuffling),
+	 * so the partition touched by a read is independent of the requested ID and of the previous accesses to it.
+	 * A block that was never written is read from a random slot of a random partition (dummy read).
+	 * A block that is still in an eviction cache is not in its partition yet, a random slot of that partition is read instead.
+	 *
+	 * The reassigned block is not written right away (that write would reveal the partition its next read goes to).
+	 * It waits in the eviction cache of its new partition, and a fixed number of evictions per request
+	 * writes to random partitions: a cached block of that partition if there is one, a dummy access otherwise.
+	 * Hence, the partitions written depend neither on the requested IDs nor on the partitions read.
+	 *
+	 * The reads of a batch run in parallel across partitions, then the evictions do.
+	 *
+	 * \note
+	 * A partition with no free slots is skipped when choosing the new partition.
+	 * This only depends on the previous random choices, not on the requested IDs.
+	 *
+	 * \note
+	 * The eviction caches live in client memory, with eviction rate above one they stay small (as in Partition ORAM).
+	 *
+	 * \note
+	 * The number of accesses per partition in a batch is visible to the storage (as in Partition ORAM).
+	 *
+	 * Like ORAM, the object itself is not thread-safe.
+	 */
+	class PartitionedORAM
+	{
+		private:
+		// a worker thread that runs tasks on one partition, in order
+		struct Worker
+		{
+			thread runner;
+			mutex lock;
+			condition_variable pending;
+			deque<packaged_task<void()>> tasks;
+			bool stopping = false;
+		};
+
+		const vector<shared_ptr<ORAM>> partitions;
+		const number partitionCapacity; // the number of slots (block IDs) used in each partition
+		const number batchSize;			// the max number of requests per ORAM::multiple of a partition
+		const number evictionRate;		// the number of evictions per (distinct) request
+
+		vector<unique_ptr<Worker>> workers;
+
+		unordered_map<number, pair<number, number>> locations; // block ID to {partition, slot}
+		vector<vector<number>> freeSlots;					   // unused slots of each partition
+		vector<unordered_map<number, bytes>> evictionCaches;   // for each partition, the blocks assigned to it and not written yet
+
+		/**
+		 * @brief the worker loop: runs the tasks until stopped
+		 */
+		static void work(Worker *worker);
+
+		/**
+		 * @brief runs the requests on each partition (in parallel) and waits for all of them
+		 *
+		 * @param requests for each partition, the requests in a form of {slot, payload} (empty payload means GET)
+		 * @param response for each partition, the answers as in ORAM::multiple
+		 */
+		void run(const vector<vector<block>> &requests, vector<vector<bytes>> &response);
+
+		/**
+		 * @brief chooses a uniformly random partition that has a free slot and takes the slot
+		 *
+		 * @return pair<number, number> the {partition, slot}
+		 */
+		pair<number, number> allocate();
+
+		/**
+		 * @brief makes the given number of evictions, each to a uniformly random partition
+		 *
+		 * An eviction writes a block from the partition's eviction cache to its slot, or makes a dummy access if the cache is empty.
+		 *
+		 * @param count the number of evictions
+		 * @param writes for each partition, the requests to run (appended to)
+		 */
+		void evict(const number count, vector<vector<block>> &writes);
+
+		friend class PartitionedORAMTest_Reshuffle_Test;
+		friend class PartitionedORAMTest_Full_Test;
+		friend class PartitionedORAMTest_EvictionCache_Test;
+
+		public:
+		/**
+		 * @brief Construct a new Partitioned ORAM object given the partitions
+		 *
+		 * @param partitions the initialized ORAMs (each must hold at least partitionCapacity blocks and have the same block size)
+		 * @param partitionCapacity the number of slots to use in each partition
+		 * (the total should exceed the number of user's blocks with some slack, so that writes rarely hit a full partition)
+		 * @param batchSize the batch size the partitions were constructed with
+		 * @param evictionRate the number of evictions per (distinct) request, should be above one for the eviction caches to drain
+		 */
+		PartitionedORAM(const vector<shared_ptr<ORAM>> &partitions, const number partitionCapacity, const number batchSize = 1, const number evictionRate = 2);
+
+		/**
+		 * @brief Construct a new Partitioned ORAM object with in-memory partitions created automatically
+		 *
+		 * Each partition gets twice its even share of the capacity, in a tree that is at most 3/4 full.
+		 *
+		 * @param capacity the number of (user's) blocks
+		 * @param blockSize the size (user's portion) of ORAM block in bytes
+		 * @param Z number of blocks in a bucket
+		 * @param partitions the number of partitions (and worker threads)
+		 * @param batchSize the max number of requests per ORAM::multiple of a partition
+		 * @param evictionRate the number of evictions per (distinct) request
+		 */
+		PartitionedORAM(const number capacity, const number blockSize, const number Z, const number partitions, const number batchSize = 1, const number evictionRate = 2);
+
+		/**
+		 * @brief Stops the worker threads
+		 */
+		~PartitionedORAM();
+
+		PartitionedORAM(const PartitionedORAM &) = delete;
+		PartitionedORAM &operator=(const PartitionedORAM &) = delete;
+
+		/**
+		 * @brief Retrives a block from ORAM
+		 *
+		 * @param block block ID to request
+		 * @param response the (decrypted) data from the block (empty if the block was never written)
+		 */
+		void get(const number block, bytes &response);
+
+		/**
+		 * @brief Puts a block to ORAM
+		 *
+		 * @param block block ID to request
+		 * @param data the (plaintext) data to put in the block
+		 */
+		void put(const number block, const bytes &data);
+
+		/**
+		 * @brief processes multiple requests at a time, spreading them over the partitions
+		 *
+		 * Each distinct ID is read once and put in an eviction cache, the requests are applied in order in between.
+		 * Then evictionRate evictions per distinct ID are made.
+		 *
+		 * @param requests the sequence of requests in a form of {ID, payload}
+		 * If payload is empty (zero size), the requests is treated as GET, otherwise PUT.
+		 * @param response the answer to the requests (as in ORAM::multiple)
+		 */
+		void multiple(const vector<block> &requests, vector<bytes> &response);
+	};
+}
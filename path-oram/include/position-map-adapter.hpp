@@ -2,13 +2,19 @@
 
 #include "definitions.h"
 #include "oram.hpp"
+#include "utility.hpp"
 
 #include <iostream>
+#include <list>
+#include <unordered_map>
 
 namespace PathORAM
 {
 	using namespace std;
 
+	struct AccessStats;
+	class Tracer;
+
 	/**
 	 * @brief Abstraction over position map
 	 */
@@ -31,6 +37,56 @@ namespace PathORAM
 		 */
 		virtual void set(const number block, const number leaf) = 0;
 
+		/**
+		 * @brief map a uniformly random leaf to each of the blocks from 0 to blocks (exclusive)
+		 *
+		 * Used by ORAM to initialize the map.
+		 * The default implementation calls set for each block, adapters may do it in bulk.
+		 *
+		 * @param blocks the number of blocks
+		 * @param leaves the number of leaves (the leaf is chosen from 0 to leaves, exclusive)
+		 */
+		virtual void initialize(const number blocks, const number leaves);
+
+		/**
+		 * @brief map leaves to many blocks at once
+		 *
+		 * Used by ORAM::load (off-line bulk load).
+		 * The default implementation calls set for each pair, adapters may do it in bulk.
+		 *
+		 * @param positions the sequence of {block, leaf}
+		 */
+		virtual void load(const vector<pair<number, number>> &positions);
+
+		/**
+		 * @brief sets the stats object that the subsequent get and set calls add their traffic to
+		 *
+		 * Used by ORAM for the duration of a call that is given an AccessStats (see ORAM::get).
+		 * The default implementation ignores it, as in-memory maps make no storage requests.
+		 *
+		 * @param stats the object to add to (nullptr to stop)
+		 */
+		virtual void recordStats(AccessStats *stats);
+
+		/**
+		 * @brief sets the tracer that the underlying ORAMs (if any) record their accesses to
+		 *
+		 * Used by ORAM::setTracer. The default implementation ignores it, as in-memory maps have nothing to trace.
+		 *
+		 * @param tracer the tracer (nullptr to stop)
+		 */
+		virtual void setTracer(const shared_ptr<Tracer> tracer);
+
+		/**
+		 * @brief Returns an estimate of the client memory held by the adapter in bytes
+		 *
+		 * The default implementation returns 0 (for adapters that keep the map outside of this process).
+		 *
+		 * @param recursive whether to include the memory of the underlying ORAMs (see ORAMPositionMapAdapter)
+		 * @return number the memory in bytes
+		 */
+		virtual number memoryUsage(const bool recursive = true) const;
+
 		virtual ~AbsPositionMapAdapter() = 0;
 	};
 
@@ -63,6 +119,7 @@ namespace PathORAM
 		~InMemoryPositionMapAdapter() final;
 		number get(const number block) const final;
 		void set(const number block, const number leaf) final;
+		number memoryUsage(const bool recursive = true) const final;
 
 		/**
 		 * @brief write state to a binary file
@@ -79,29 +136,175 @@ namespace PathORAM
 		void loadFromFile(const string filename);
 	};
 
+	/**
+	 * @brief In-memory implementation of position adapter for sparse block IDs.
+	 *
+	 * Uses a fixed-capacity open-addressing hash table (see FixedHashMap),
+	 * so memory depends on the maximum number of mapped blocks, not on the range of IDs.
+	 *
+	 * A block that was never mapped gets a random leaf on the first get (the block is not in the tree, any path will do).
+	 * Consequently, initialize does not map any blocks, it only records the number of leaves.
+	 * If initialize is not called (e.g. the ORAM is restored from files), give the number of leaves to the constructor,
+	 * otherwise a get of a never mapped block throws exception (there is no leaf to choose from).
+	 */
+	class SparsePositionMapAdapter : public AbsPositionMapAdapter
+	{
+		private:
+		mutable FixedHashMap map;
+		number leaves; // number of leaves given to initialize (or the constructor), 0 if unknown
+
+		public:
+		/**
+		 * @brief Construct a new Sparse Position Map Adapter object
+		 *
+		 * @param capacity maximum number of mapped blocks (mapping more throws exception)
+		 * @param leaves the number of leaves to choose from for never mapped blocks (0 if initialize will set it)
+		 */
+		SparsePositionMapAdapter(const number capacity, const number leaves = 0);
+
+		~SparsePositionMapAdapter() final;
+		number get(const number block) const final;
+		void set(const number block, const number leaf) final;
+		void initialize(const number blocks, const number leaves) final;
+		number memoryUsage(const bool recursive = true) const final;
+
+		/**
+		 * @brief Returns the current number of mapped blocks
+		 *
+		 * @return number the current number of mapped blocks
+		 */
+		number size() const;
+	};
+
 	class ORAM;
 
 	/**
 	 * @brief A PathORAM implementation of the position map adapter.
 	 *
 	 * Uses an instance of PathORAM as the sotrage for the map.
+	 * Positions are packed, so that one block of the underlying ORAM holds (block size / sizeof(number)) neighboring positions.
+	 *
+	 * Optionally keeps a position lookaside buffer (PLB), as in Freecursive ORAM:
+	 * a bounded client-side LRU cache of the underlying ORAM blocks.
+	 *
+	 * \note
+	 * With PLB disabled (default), every get and every set results in exactly one access to the underlying ORAM
+	 * (a set right after a get of the same packed block reuses it), so the access sequence does not depend on the data.
+	 *
+	 * \note
+	 * With PLB enabled, a hit skips the underlying ORAM access (and, transitively, all deeper recursion levels),
+	 * and modified blocks are written back with a regular ORAM access when evicted, so they get a fresh random path.
+	 * Each recursion level has its own storage (there is no unified tree, as in Freecursive ORAM),
+	 * so the number of underlying accesses reveals the hit/miss pattern (i.e. the locality of requests)
+	 * to the storage of each level, and this mode does not preserve the security of Path ORAM.
+	 * Enable it only if the locality of requests is not sensitive.
+	 *
+	 * \note
+	 * initialize and load rebuild the underlying ORAM off-line with ORAM::load, instead of accessing it once per block.
+	 * Unlike the other adapters, whose load only sets the given positions, this resets the underlying ORAM:
+	 * its storage is filled with zeroes and its stash is emptied, so that no stale copies of its blocks remain,
+	 * and the positions not given to load get fresh random leaves.
 	 */
 	class ORAMPositionMapAdapter : public AbsPositionMapAdapter
 	{
 		private:
 		const shared_ptr<ORAM> oram;
 
+		const number positionsPerBlock; // number of positions packed in one block of the underlying ORAM
+		const number plbCapacity;		// max number of underlying ORAM blocks held in PLB (0 disables PLB)
+
+		number blocks = 0; // number of blocks given to initialize
+		number leaves = 0; // number of leaves given to initialize
+
+		AccessStats *stats = nullptr; // passed to the underlying ORAM accesses (see recordStats)
+
+		// PLB, most recently used first; each entry is {ID in the underlying ORAM, {positions, dirty}}
+		mutable list<pair<number, pair<bytes, bool>>> plb;
+		mutable unordered_map<number, list<pair<number, pair<bytes, bool>>>::iterator> plbIndex;
+
+		/**
+		 * @brief helper that throws exception if out-of-bounds access occurs
+		 *
+		 * @param block accessed block
+		 */
+		void checkCapacity(const number block) const;
+
+		/**
+		 * @brief counts an access to the underlying ORAM in the stats (if any)
+		 */
+		void countAccess() const;
+
+		/**
+		 * @brief returns the (cached) packed positions block that holds the position for a given block
+		 *
+		 * If PLB is disabled, only the most recently fetched block is remembered,
+		 * and it is only used if reuse is set (i.e. for set).
+		 *
+		 * @param id the ID of the block in the underlying ORAM
+		 * @param reuse if set and PLB is disabled, will use the most recently fetched block if it matches id
+		 * @return pair<bytes, bool>& the positions and the dirty flag
+		 */
+		pair<bytes, bool> &fetch(const number id, const bool reuse) const;
+
 		friend class ORAMBigTest;
+		friend class PositionMapAdapterTest_PLBNeighbors_Test;
+		friend class PositionMapAdapterTest_PLBFewerAccesses_Test;
+		friend class ORAMTest_AccessStatsThrow_Test;
 
 		public:
 		/**
 		 * @brief Construct a new ORAMPositionMapAdapter object
 		 *
 		 * @param oram the intialized (with proper capacities) ORAM that will be used as a position map storage
+		 * @param plbCapacity the number of the underlying ORAM blocks to keep in PLB
+		 * (0 to disable PLB; if enabled, the hit/miss pattern leaks, see class notes)
 		 */
-		ORAMPositionMapAdapter(const shared_ptr<ORAM> oram);
+		ORAMPositionMapAdapter(const shared_ptr<ORAM> oram, const number plbCapacity = 0);
 		~ORAMPositionMapAdapter() final;
 		number get(const number block) const final;
 		void set(const number block, const number leaf) final;
+
+		void initialize(const number blocks, const number leaves) final;
+
+		/**
+		 * @brief map leaves to many blocks at once
+		 *
+		 * Blocks below the number given to initialize that are not in positions get a fresh random leaf.
+		 * The underlying ORAM is reset (see class notes), and the PLB is emptied.
+		 * Throws exception if initialize was not called (the number of leaves is unknown).
+		 *
+		 * @param positions the sequence of {block, leaf}
+		 */
+		void load(const vector<pair<number, number>> &positions) final;
+
+		/**
+		 * @brief sets the stats object for the underlying ORAM accesses
+		 *
+		 * The underlying ORAM adds its storage traffic to it, and each of its accesses counts as a recursive access
+		 * (PLB hits do not).
+		 *
+		 * @param stats the object to add to (nullptr to stop)
+		 */
+		void recordStats(AccessStats *stats) final;
+
+		/**
+		 * @brief sets the tracer on the underlying ORAM (and, transitively, on all deeper levels)
+		 *
+		 * @param tracer the tracer (nullptr to stop)
+		 */
+		void setTracer(const shared_ptr<Tracer> tracer) final;
+
+		/**
+		 * @brief Returns an estimate of the client memory held by the adapter in bytes
+		 *
+		 * @param recursive if set, includes the underlying ORAM (and, transitively, all deeper levels), otherwise only PLB
+		 * @return number the memory in bytes
+		 */
+		number memoryUsage(const bool recursive = true) const final;
+
+		/**
+		 * @brief writes all modified PLB entries back to the underlying ORAM
+		 */
+		void flush();
 	};
 }
@@ -1,7 +1,9 @@
 #pragma once
 
 #include "definitions.h"
+#include "utility.hpp"
 
+#include <functional>
 #include <iostream>
 #include <unordered_map>
 
@@ -9,6 +11,13 @@ namespace PathORAM
 {
 	using namespace std;
 
+	/**
+	 * @brief receives a stash entry in place: ID of the block, pointer to its data and the size of the data
+	 *
+	 * The data pointer is only valid until the stash is modified.
+	 */
+	using StashVisitor = function<void(const number block, const uchar *data, const number size)>;
+
 	/**
 	 * @brief Abstraction over stash
 	 *
@@ -23,6 +32,48 @@ namespace PathORAM
 		 */
 		virtual void getAll(vector<block> &response) const = 0;
 
+		/**
+		 * @brief call the visitor for every object in the stash without copying the data
+		 *
+		 * The visitor must not modify the stash.
+		 * The default implementation visits the copies made by getAll, adapters may visit the objects in place.
+		 *
+		 * @param visitor the callback to call for each object
+		 * @param shuffle if set, the objects are visited in a pseudorandom order (otherwise, in unspecified order)
+		 */
+		virtual void forEach(const StashVisitor &visitor, const bool shuffle = true) const;
+
+		/**
+		 * @brief whether the adapter keeps the leaves of its objects (see setLeaf and forEachInRange)
+		 *
+		 * If so, ORAM reports the leaf of every object it puts in the stash, and evicts with forEachInRange.
+		 * The default is false.
+		 */
+		virtual bool indexesLeaves() const;
+
+		/**
+		 * @brief record the leaf the object is mapped to
+		 *
+		 * Does nothing if the object does not exist, or if the adapter does not index leaves (default).
+		 *
+		 * @param block ID of the block
+		 * @param leaf the leaf the block is mapped to
+		 */
+		virtual void setLeaf(const number block, const number leaf);
+
+		/**
+		 * @brief call the visitor for up to limit objects mapped to leaves from fromLeaf to toLeaf (inclusive)
+		 *
+		 * The visitor must not modify the stash.
+		 * Only supported if indexesLeaves is true, the default implementation throws exception.
+		 *
+		 * @param fromLeaf the first leaf of the range
+		 * @param toLeaf the last leaf of the range
+		 * @param limit the maximum number of objects to visit
+		 * @param visitor the callback to call for each object
+		 */
+		virtual void forEachInRange(const number fromLeaf, const number toLeaf, const number limit, const StashVisitor &visitor) const;
+
 		/**
 		 * @brief put an object in the stash
 		 *
@@ -33,6 +84,18 @@ namespace PathORAM
 		 */
 		virtual void add(const number block, const bytes &data) = 0;
 
+		/**
+		 * @brief put an object in the stash
+		 *
+		 * Same as add(block, bytes), but copies the data from a buffer.
+		 * The default implementation makes a vector of the buffer, adapters may copy it directly.
+		 *
+		 * @param block ID of the block
+		 * @param data data part of the object
+		 * @param size the size of the data in bytes
+		 */
+		virtual void add(const number block, const uchar *data, const number size);
+
 		/**
 		 * @brief change an object in the stash (by ID)
 		 *
@@ -44,6 +107,17 @@ namespace PathORAM
 		 */
 		virtual void update(const number block, const bytes &data) = 0;
 
+		/**
+		 * @brief change an object in the stash (by ID) taking ownership of the data
+		 *
+		 * Same as update(block, const bytes &).
+		 * The default implementation copies the data, adapters may move it.
+		 *
+		 * @param block ID of the block
+		 * @param data data part of the object
+		 */
+		virtual void update(const number block, bytes &&data);
+
 		/**
 		 * @brief retrieve the object by ID
 		 *
@@ -52,6 +126,17 @@ namespace PathORAM
 		 */
 		virtual void get(const number block, bytes &response) const = 0;
 
+		/**
+		 * @brief copy the data of the object into a buffer
+		 *
+		 * The default implementation goes through get(block, bytes), adapters may copy directly.
+		 *
+		 * @param block ID of the block
+		 * @param response the buffer, must be large enough for the data
+		 * @return number the size of the data (0 if the object does not exist)
+		 */
+		virtual number get(const number block, uchar *response) const;
+
 		/**
 		 * @brief removes the object by ID
 		 *
@@ -61,6 +146,24 @@ namespace PathORAM
 		 */
 		virtual void remove(const number block) = 0;
 
+		/**
+		 * @brief Returns the current size of the stash (in blocks)
+		 *
+		 * The default implementation counts the objects with forEach.
+		 *
+		 * @return number the current size of the stash (in blocks)
+		 */
+		virtual number currentSize();
+
+		/**
+		 * @brief Returns an estimate of the client memory held by the stash in bytes
+		 *
+		 * The default implementation returns 0 (for adapters that keep the stash outside of this process).
+		 *
+		 * @return number the memory in bytes
+		 */
+		virtual number memoryUsage() const;
+
 		virtual ~AbsStashAdapter() = 0;
 
 		protected:
@@ -111,21 +214,24 @@ namespace PathORAM
 		~InMemoryStashAdapter() final;
 
 		void getAll(vector<block> &response) const final;
+		void forEach(const StashVisitor &visitor, const bool shuffle = true) const final;
 		void add(const number block, const bytes &data) final;
 		void update(const number block, const bytes &data) final;
+		void update(const number block, bytes &&data) final;
 		void get(const number block, bytes &response) const final;
+		number get(const number block, uchar *response) const final;
 		void remove(const number block) final;
 
-		/**
-		 * @brief Returns the current size of the stash (in blocks)
-		 *
-		 * @return number the current size of the stash (in blocks)
-		 */
-		number currentSize();
+		number currentSize() final;
+		number memoryUsage() const final;
 
 		/**
 		 * @brief write state to a binary file
 		 *
+		 * The file has a header (format version, block size, number of blocks and a checksum) followed by the blocks.
+		 * The blocks are streamed through a fixed-size buffer, so the snapshot size is not limited by memory.
+		 * All blocks must be of the same size.
+		 *
 		 * @param filename the name of the file to write to
 		 */
 		void storeToFile(const string filename) const;
@@ -133,9 +239,143 @@ namespace PathORAM
 		/**
 		 * @brief read state from a binary file
 		 *
+		 * Reads all records with buffered I/O into one region, and adds them to the stash only once they are verified.
+		 * Throws exception (and leaves the stash as it was) if the header does not match (version, block size),
+		 * the file is truncated or the checksum is wrong.
+		 * Files written before the header was introduced (blocks only) are also accepted.
+		 *
 		 * @param filename filename the name of the file to read from
 		 * @param blockSize the size of the block in the stash (same as when storeToFile was used)
 		 */
 		void loadFromFile(const string filename, const int blockSize);
 	};
+
+	/**
+	 * @brief In-memory implementation of the stash adapter with preallocated payload slots
+	 *
+	 * Uses a single buffer of capacity slots, blockSize bytes each, and an ID-to-slot index (see FixedHashMap).
+	 * Payloads are copied into and updated in their slots, so add, update and remove do not allocate.
+	 *
+	 */
+	class SlabStashAdapter : public AbsStashAdapter
+	{
+		protected:
+		const number capacity;
+		const number blockSize;
+
+		vector<uchar> payloads;	  // capacity slots of blockSize bytes
+		vector<number> ids;		  // ID stored in the slot
+		vector<number> lengths;	  // payload length of the slot (payloads may be shorter than blockSize)
+		vector<number> used;	  // occupied slots (unordered)
+		vector<number> positions; // position of the slot in used
+		vector<number> freeSlots; // unoccupied slots
+		FixedHashMap index;		  // ID to slot
+
+		/**
+		 * @brief thorows exception if an insertion of this block will cause an overflow (stash size growing beyond capacity)
+		 *
+		 * Unlike input checks, always enabled, as the slots are preallocated.
+		 *
+		 * @param block block ID in question
+		 */
+		void checkOverflow(const number block) const;
+
+		/**
+		 * @brief throws exception if the data does not fit in a slot
+		 *
+		 * Unlike input checks, always enabled, as the slots are preallocated.
+		 *
+		 * @param dataSize size of the data to be inserted
+		 */
+		void checkBlockSize(const number dataSize) const;
+
+		/**
+		 * @brief copies data in the slot
+		 */
+		void write(const number slot, const uchar *data, const number size);
+
+		bool exists(const number block) const final;
+
+		public:
+		/**
+		 * @brief Construct a new Slab Stash Adapter object
+		 *
+		 * @param capacity the maximum number of objects that should be allowed in the stash
+		 * @param blockSize the maximum size of an object payload in bytes
+		 */
+		SlabStashAdapter(const number capacity, const number blockSize);
+
+		~SlabStashAdapter();
+
+		void getAll(vector<block> &response) const final;
+		void forEach(const StashVisitor &visitor, const bool shuffle = true) const final;
+		void add(const number block, const bytes &data) final;
+		void add(const number block, const uchar *data, const number size) final;
+		void update(const number block, const bytes &data) final;
+		void get(const number block, bytes &response) const final;
+		number get(const number block, uchar *response) const final;
+		void remove(const number block) override;
+
+		number currentSize() final;
+		number memoryUsage() const override;
+	};
+
+	/**
+	 * @brief Slab stash adapter that also indexes objects by their leaves
+	 *
+	 * Leaves are split into (about capacity) contiguous groups, each group holds a linked list of its objects' slots.
+	 * A binary tree of object counts over the groups lets forEachInRange skip empty groups,
+	 * so that a range query costs O(limit * log(capacity)) regardless of the number of objects in the stash.
+	 * The index is preallocated, adding and removing objects does not allocate.
+	 *
+	 * An object is only visible to forEachInRange after setLeaf is called for it.
+	 */
+	class LeafStashAdapter : public SlabStashAdapter
+	{
+		private:
+		const number leaves; // number of leaves in the tree
+		number shift;		 // leaf >> shift is the group of the leaf
+		number groups;		 // number of groups (a power of two)
+
+		vector<number> slotLeaves; // leaf of the object in the slot (ULONG_MAX if not set)
+		vector<number> next;	   // next slot in the group (ULONG_MAX if last)
+		vector<number> previous;   // previous slot in the group (ULONG_MAX if first)
+		vector<number> heads;	   // first slot of the group (ULONG_MAX if empty)
+		vector<number> counts;	   // number of objects under the node (root is 1, group g is node groups + g)
+
+		/**
+		 * @brief adds the slot to the group of its leaf
+		 */
+		void link(const number slot);
+
+		/**
+		 * @brief removes the slot from the group of its leaf
+		 */
+		void unlink(const number slot);
+
+		/**
+		 * @brief visits the objects under the node (groups from nodeFrom to nodeTo) in a range of leaves
+		 */
+		void visit(const number node, const number nodeFrom, const number nodeTo, const number fromLeaf, const number toLeaf, const number limit, number &visited, const StashVisitor &visitor) const;
+
+		public:
+		/**
+		 * @brief Construct a new Leaf Stash Adapter object
+		 *
+		 * @param capacity the maximum number of objects that should be allowed in the stash
+		 * @param blockSize the maximum size of an object payload in bytes
+		 * @param logCapacity the height of the ORAM tree (as in ORAM constructor)
+		 */
+		LeafStashAdapter(const number capacity, const number blockSize, const number logCapacity);
+
+		~LeafStashAdapter() final;
+
+		void remove(const number block) final;
+
+		bool indexesLeaves() const final;
+		void setLeaf(const number block, const number leaf) final;
+		void forEachInRange(const number fromLeaf, const number toLeaf, const number limit, const StashVisitor &visitor) const final;
+
+		number memoryUsage() const final;
+	};
 }
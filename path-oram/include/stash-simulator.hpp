@@ -0,0 +1,138 @@
+#pragma once
+
+#include "definitions.h"
+
+#include <random>
+
+namespace PathORAM
+{
+	using namespace std;
+
+	/**
+	 * @brief how the simulated ORAM evicts blocks from the stash
+	 */
+	enum EvictionPolicy
+	{
+		EVICTION_PATH,		 // evict to the path of the access only (as ORAM by default)
+		EVICTION_BACKGROUND // also run dummy accesses while the stash is at the watermark (as ORAM::setBackgroundEviction)
+	};
+
+	/**
+	 * @brief the stash sizes observed in the trials of StashSimulator
+	 */
+	struct StashDistribution
+	{
+		vector<number> histogram; // histogram[s] is the number of sampled accesses after which the stash held s blocks
+		vector<number> maxima;	  // maxima[s] is the number of trials in which the largest stash held s blocks
+		number samples		 = 0; // the number of sampled accesses (in all trials)
+		number trials		 = 0; // the number of trials
+		number dummyAccesses = 0; // the number of background eviction accesses (in all trials)
+
+		/**
+		 * @brief the probability that the stash holds more than size blocks after an access
+		 */
+		double tail(const number size) const;
+
+		/**
+		 * @brief the probability that the stash holds more than capacity blocks at least once in a trial
+		 */
+		double overflow(const number capacity) const;
+
+		/**
+		 * @brief the smallest stash capacity that is exceeded after an access with at most the given probability
+		 *
+		 * \note
+		 * Probabilities below 1 / samples cannot be told from zero.
+		 *
+		 * @param probability the acceptable probability of overflow per access
+		 * @return number the capacity (in blocks)
+		 */
+		number capacityFor(const double probability) const;
+
+		/**
+		 * @brief adds the samples of another distribution
+		 */
+		void merge(const StashDistribution &other);
+	};
+
+	/**
+	 * @brief Monte Carlo simulator of the PathORAM stash
+	 *
+	 * Models only what the stash size depends on: the leaves of the blocks and the contents of the buckets
+	 * (no payloads, no encryption, no storage).
+	 * Accesses, eviction (greedy, from leaf to root) and background eviction follow ORAM.
+	 * Each trial gives the blocks uniformly random leaves and puts each in the deepest bucket of its path that has a free slot,
+	 * runs warm-up accesses, then samples the stash size after every access to a uniformly random block.
+	 *
+	 * Trials are independent and run on several threads.
+	 * Each trial has its own generator seeded from getRandomULong up front,
+	 * so the result does not depend on the number of threads.
+	 */
+	class StashSimulator
+	{
+		private:
+		const number height; // number of tree levels
+		const number Z;		 // number of blocks per bucket
+		const number leaves; // number of leaves
+		const number blocks; // number of blocks in the ORAM
+
+		const EvictionPolicy policy;
+		const number watermark;	   // the stash size that triggers dummy accesses (EVICTION_BACKGROUND)
+		const number maxEvictions; // the maximum number of dummy accesses after one access (EVICTION_BACKGROUND)
+
+		// the state of one trial
+		struct Trial
+		{
+			mt19937_64 random;
+			vector<number> positions; // the leaf of each block
+			vector<number> tree;	  // Z slots per bucket (heap order, ULONG_MAX if empty)
+			vector<number> stash;	  // the IDs of the blocks in the stash
+		};
+
+		/**
+		 * @brief creates the initial state of a trial (random leaves, blocks in the deepest free slots of their paths)
+		 */
+		Trial start(const number seed) const;
+
+		/**
+		 * @brief runs one trial and adds its samples to the distribution
+		 */
+		void simulate(const number seed, const number warmUp, const number accesses, StashDistribution &distribution) const;
+
+		/**
+		 * @brief reads the path into the stash, remaps the block (if not ULONG_MAX) and evicts to the path
+		 */
+		void access(Trial &trial, const number block, const number leaf) const;
+
+		/**
+		 * @brief the location of a bucket (not block) in a given path on a given level (as in ORAM)
+		 */
+		number bucketForLevelLeaf(const number level, const number leaf) const;
+
+		friend class StashSimulatorTest_BlocksConserved_Test;
+
+		public:
+		/**
+		 * @brief Construct a new Stash Simulator object
+		 *
+		 * @param logCapacity height of the tree, as in ORAM
+		 * @param Z number of blocks in a bucket
+		 * @param load the number of blocks relative to the capacity of ORAM (2^logCapacity * Z), from 0 to 1
+		 * @param policy the eviction policy
+		 * @param watermark the stash size that triggers dummy accesses (for EVICTION_BACKGROUND, must be positive)
+		 * @param maxEvictions the maximum number of dummy accesses after one access (for EVICTION_BACKGROUND)
+		 */
+		StashSimulator(const number logCapacity, const number Z, const double load, const EvictionPolicy policy = EVICTION_PATH, const number watermark = 0, const number maxEvictions = 4);
+
+		/**
+		 * @brief runs the trials
+		 *
+		 * @param accesses the number of sampled accesses per trial
+		 * @param trials the number of independent trials
+		 * @param threads the number of threads to run the trials on
+		 * @param warmUp the number of accesses before sampling starts in each trial (0 for as many as there are blocks)
+		 * @return StashDistribution the stash sizes observed in all trials
+		 */
+		StashDistribution run(const number accesses, const number trials, const number threads = 1, const number warmUp = 0) const;
+	};
+}
@@ -1,10 +1,17 @@
 #pragma once
 
 #include "definitions.h"
+#include "metrics.hpp"
+#include "tracer.hpp"
+#include "utility.hpp"
 
+#include <atomic>
 #include <boost/range/any_range.hpp>
+#include <boost/range/iterator_range.hpp>
 #include <boost/signals2/signal.hpp>
+#include <chrono>
 #include <fstream>
+#include <unordered_map>
 
 #if USE_REDIS
 #include <sw/redis++/redis++.h>
@@ -21,6 +28,20 @@ namespace PathORAM
 	// range abstraction that is iterable (will be used for vector of pairs and unordered map)
 	using request_anyrange = boost::any_range<pair<const number, bucket>, boost::forward_traversal_tag>;
 
+	// a range of {location, bucket of arena blocks} requests (e.g. the slots of the ORAM cache)
+	using arena_range = boost::iterator_range<vector<pair<number, arenaBucket>>::const_iterator>;
+
+	/**
+	 * @brief the time (in nanoseconds) spent in the parts of storage requests (see AbsStorageAdapter::recordTimes)
+	 */
+	struct StorageTimes
+	{
+		number read	   = 0; // reading raw buckets (including the round trips)
+		number decrypt = 0; // decrypting and unpacking buckets
+		number encrypt = 0; // packing and encrypting buckets
+		number write   = 0; // writing raw buckets (including the round trips)
+	};
+
 	/**
 	 * @brief An abstraction over storage adapter
 	 *
@@ -48,34 +69,112 @@ namespace PathORAM
 		void checkBlockSize(const number dataSize) const;
 
 		/**
-		 * @brief Proxy for setInternal(number location, bytes raw) that emits OnStorageRequest
+		 * @brief throws exception if a bucket does not have exactly Z blocks
+		 *
+		 * @param blocks the number of blocks in the bucket
+		 */
+		void checkBucketSize(const number blocks) const;
+
+		/**
+		 * @brief reads raw (encrypted) buckets, in batches if supported
+		 *
+		 * @param locations the locations from which to read
+		 * @param raws the raw buckets, one per location (resized to the number of locations, the buffers of the elements are reused)
+		 */
+		void getRaw(const vector<number> &locations, vector<bytes> &raws) const;
+
+		/**
+		 * @brief writes raw (encrypted) buckets, in batches if supported
+		 *
+		 * @param writes the sequence of {location, raw bucket}
+		 */
+		void setRaw(const vector<pair<number, bytes>> &writes);
+
+		/**
+		 * @brief decrypts a raw bucket into Z records of {ID padded to AES block, payload}
+		 *
+		 * @param raw IV and ciphertext
+		 * @param decrypted the plaintext (overwritten)
+		 */
+		void decryptBucket(const bytes &raw, bytes &decrypted) const;
+
+		/**
+		 * @brief decrypts a raw bucket into a given buffer
+		 *
+		 * @param raw IV and ciphertext (must be blockSize bytes)
+		 * @param decrypted the buffer of blockSize - AES_BLOCK_SIZE bytes for the plaintext
+		 */
+		void decryptBucket(const bytes &raw, uchar *decrypted) const;
+
+		/**
+		 * @brief appends a block (ID padded to AES block, then payload padded to user's block size) to the plaintext of a bucket
+		 *
+		 * @param toEncrypt the plaintext of the bucket
+		 * @param id ID of the block
+		 * @param data the payload
+		 * @param size the size of the payload
+		 */
+		void appendBlock(bytes &toEncrypt, const number id, const uchar *data, const number size) const;
+
+		/**
+		 * @brief encrypts the plaintext of a bucket with a fresh random IV
+		 *
+		 * @param toEncrypt the plaintext of the bucket
+		 * @param size the size of the plaintext
+		 * @param raw IV and ciphertext (overwritten, its buffer is reused)
+		 */
+		void encryptBucket(const uchar *toEncrypt, const number size, bytes &raw) const;
+
+		/**
+		 * @brief Proxy for setInternal(number location, bytes raw) that records metrics and emits OnStorageRequest
 		 */
 		void setAndRecord(const number location, const bytes &raw);
 
 		/**
-		 * @brief Proxy for getInternal(number location, bytes &response) that emits OnStorageRequest
+		 * @brief Proxy for getInternal(number location, bytes &response) that records metrics and emits OnStorageRequest
 		 */
 		void getAndRecord(const number location, bytes &response) const;
 
 		/**
-		 * @brief Proxy for setInternal(vector<pair<number, bytes>> &requests) that emits OnStorageRequest
+		 * @brief Proxy for setInternal(vector<pair<number, bytes>> &requests) that records metrics and emits OnStorageRequest
 		 */
 		void setAndRecord(const vector<pair<number, bytes>> &requests);
 
 		/**
-		 * @brief Proxy for getInternal(vector<number> &locations, vector<bytes> &response) that emits OnStorageRequest
+		 * @brief Proxy for getInternal(vector<number> &locations, vector<bytes> &response) that records metrics and emits OnStorageRequest
 		 */
 		void getAndRecord(const vector<number> &locations, vector<bytes> &response) const;
 
+		/**
+		 * @brief records a span of a storage call if tracing is enabled
+		 *
+		 * @param name the name of the span
+		 * @param start the time the call started
+		 * @param elapsed the duration of the call in nanoseconds
+		 * @param buckets the number of buckets read or written
+		 */
+		void traceCall(const char *name, const chrono::steady_clock::time_point start, const number elapsed, const number buckets) const;
+
 		const bytes key;		 // AES key for encryption operations
 		const number Z;			 // number of blocks in a bucket
 		const number batchLimit; // maximum number of requests in a batch
 
 		// Event handler
 		OnStorageRequest onStorageRequest;
+		atomic<bool> subscribed = false; // whether subscribe was ever called (the signal is not touched otherwise)
+
+		// always-on counters and histograms of storage calls
+		mutable StorageMetrics storageMetrics;
+
+		// if not null, the batch get and set accumulate their timings here
+		StorageTimes *times = nullptr;
+
+		// if not null, storage calls, encryption and decryption are recorded here
+		shared_ptr<Tracer> tracer;
 
 		friend class StorageAdapterTest_GetSetInternal_Test;
 		friend class MockStorage;
+		friend class SimulatedLatencyStorageAdapter;
 
 		public:
 		/**
@@ -99,11 +198,62 @@ namespace PathORAM
 		/**
 		 * @brief Subscribes to OnStorageRequest notifications.
 		 *
+		 * Until the first subscription, the signal is not checked on storage calls.
+		 *
 		 * @param handler the handler to execute with event
 		 * @return boost::signals2::connection the connection object (to be used for unsubscribing)
 		 */
 		boost::signals2::connection subscribe(const OnStorageRequest::slot_type &handler);
 
+		/**
+		 * @brief Returns a snapshot of the storage metrics
+		 *
+		 * Metrics are always recorded (one call is one read or write, a batch is one call).
+		 * Unlike OnStorageRequest, recording does not lock or allocate.
+		 * May be called at any time, from any thread.
+		 *
+		 * @param histograms whether to copy the histograms (the counters alone are cheap to read)
+		 * @return StorageMetricsSnapshot the counters and histograms since construction (or the last reset)
+		 */
+		StorageMetricsSnapshot metrics(const bool histograms = true) const;
+
+		/**
+		 * @brief Clears the storage metrics
+		 */
+		void resetMetrics();
+
+		/**
+		 * @brief Returns an estimate of the client memory held by the adapter in bytes
+		 *
+		 * Counts the data kept in this process (e.g. all buckets for in-memory storage, the key and the metrics),
+		 * not the data kept by a file system or a remote server.
+		 *
+		 * @return number the memory in bytes
+		 */
+		virtual number memoryUsage() const;
+
+		/**
+		 * @brief Starts (or stops) accumulating the time spent in the parts of batch get and set
+		 *
+		 * Used by ORAM to report its phases.
+		 * While disabled (default), no clocks are read.
+		 *
+		 * @param times where to add the timings (nullptr to stop)
+		 */
+		void recordTimes(StorageTimes *times);
+
+		/**
+		 * @brief Starts (or stops) recording the timeline of storage calls, encryption and decryption
+		 *
+		 * Each call (a batch is one call) is a "storage read" or "storage write" span,
+		 * and the batch get and set also record "decrypt" and "encrypt" spans.
+		 * While disabled (default), no clocks are read.
+		 * Must not be called concurrently with storage requests.
+		 *
+		 * @param tracer where to record the spans (nullptr to stop)
+		 */
+		void setTracer(const shared_ptr<Tracer> tracer);
+
 		/**
 		 * @brief retrives the data in batch
 		 *
@@ -130,6 +280,63 @@ namespace PathORAM
 		 */
 		void set(const request_anyrange requests);
 
+		/**
+		 * @brief retrives the data in batch, putting the payloads in arena chunks
+		 *
+		 * Same as get(locations, response), but does not allocate a vector for each payload.
+		 * The raw and decrypted buckets go through per-thread buffers, so once these and the response have grown the call does not allocate.
+		 *
+		 * @param locations the locations from which to read
+		 * @param response retrived data broken up into IDs and decrypted payloads (appended)
+		 * @param arena the arena to allocate the payloads from (its block size must be the user's block size)
+		 */
+		void get(const vector<number> &locations, vector<arenaBlock> &response, BlockArena &arena) const;
+
+		/**
+		 * @brief writes the data in batch, the payloads are in arena chunks
+		 *
+		 * Same as set(requests) for buckets of arena blocks.
+		 * The plaintext and raw buckets go through per-thread buffers, so once these have grown the call does not allocate.
+		 *
+		 * @param requests locations and data requests (IDs and payloads) to write
+		 */
+		void set(const arena_range requests);
+
+		/**
+		 * @brief the size of a record in the buffers of get(locations, records) and set(locations, records):
+		 * the ID padded to AES block size (16 bytes), then the payload (user's block size)
+		 */
+		number recordSize() const;
+
+		/**
+		 * @brief the number of blocks in a bucket (Z)
+		 */
+		number bucketCapacity() const;
+
+		/**
+		 * @brief retrives the data in batch, decrypting it straight into a buffer of fixed-size records
+		 *
+		 * Same as get(locations, response), but writes Z records per location to the buffer, in order:
+		 * the ID in the first sizeof(number) bytes, then the payload after AES_BLOCK_SIZE bytes (see recordSize).
+		 * The raw buckets are read into per-thread buffers, so once these have grown the call does not allocate.
+		 *
+		 * @param locations the locations from which to read
+		 * @param records the buffer of locations.size() * Z * recordSize() bytes (overwritten)
+		 */
+		void get(const vector<number> &locations, uchar *records) const;
+
+		/**
+		 * @brief writes the data in batch from a buffer of fixed-size records
+		 *
+		 * Counterpart of get(locations, records): the buffer holds Z records per location,
+		 * each is the ID, zero padding up to AES_BLOCK_SIZE bytes, then the payload.
+		 * The raw buckets are encrypted into per-thread buffers, so once these have grown the call does not allocate.
+		 *
+		 * @param locations the locations to write to
+		 * @param records the buffer of locations.size() * Z * recordSize() bytes
+		 */
+		void set(const vector<number> &locations, const uchar *records);
+
 		/**
 		 * @brief sets all available locations (given by CAPACITY) to zeroed bytes.
 		 * On the storage these zeroes will appear randomized encrypted.
@@ -200,7 +407,7 @@ namespace PathORAM
 		 * @brief batch version of getInternal
 		 *
 		 * @param locations sequence (ordered) of locations to read from
-		 * @param response this vector will be appended (back-inserted) with blocks of bytes in the order defined by locations
+		 * @param response holds one element per location (possibly with stale content), to be overwritten with the blocks of bytes in the order defined by locations
 		 */
 		virtual void getInternal(const vector<number> &locations, vector<bytes> &response) const;
 	};
@@ -227,6 +434,9 @@ namespace PathORAM
 		bool supportsBatchSet() const final { return false; };
 
 		friend class MockStorage;
+
+		public:
+		number memoryUsage() const final;
 	};
 
 	/**
@@ -266,6 +476,76 @@ namespace PathORAM
 		bool supportsBatchSet() const final { return false; };
 	};
 
+	/**
+	 * @brief the delays injected by SimulatedLatencyStorageAdapter
+	 */
+	struct SimulatedLatency
+	{
+		chrono::nanoseconds request = chrono::nanoseconds(0); // the round trip of a single (one bucket) call
+		chrono::nanoseconds batch	= chrono::nanoseconds(0); // the round trip of a batch call
+		double perByte				= 0;					  // the transfer time of a raw byte in nanoseconds (e.g. 8 for 1 Gbit/s)
+		chrono::nanoseconds jitter	= chrono::nanoseconds(0); // the max extra delay of a call (uniformly random)
+		bool batching				= true;					  // whether batch calls are supported (otherwise a batch is a sequence of single calls)
+	};
+
+	/**
+	 * @brief A decorator that makes another storage adapter behave as if it was behind a network
+	 *
+	 * Every call to the underlying storage takes at least the round trip of its kind (single or batch),
+	 * plus the transfer time of its raw bytes, plus a random jitter.
+	 * The time the underlying storage takes counts towards the delay.
+	 * This lets one tune batch sizes and pipelining locally, e.g. with an in-memory storage.
+	 *
+	 * The decorator uses the key, capacity, block size, Z and batch limit of the underlying storage,
+	 * so the data already written to it remains readable.
+	 *
+	 * \note
+	 * Delays are slept and the last 100 microseconds are spun (sleeping alone overshoots by tens of microseconds).
+	 */
+	class SimulatedLatencyStorageAdapter : public AbsStorageAdapter
+	{
+		private:
+		inline static const auto SPIN = chrono::microseconds(100); // the part of a delay that is spun rather than slept
+
+		const shared_ptr<AbsStorageAdapter> storage;
+		const SimulatedLatency latency;
+
+		/**
+		 * @brief blocks until the simulated call that started at start completes
+		 *
+		 * @param start the time the call started
+		 * @param roundTrip the round trip of the call
+		 * @param size the number of raw bytes transferred
+		 */
+		void delay(const chrono::steady_clock::time_point start, const chrono::nanoseconds roundTrip, const number size) const;
+
+		public:
+		/**
+		 * @brief Construct a new Simulated Latency Storage Adapter object
+		 *
+		 * @param storage the storage to wrap (should not be used directly afterwards)
+		 * @param latency the delays to inject
+		 */
+		SimulatedLatencyStorageAdapter(const shared_ptr<AbsStorageAdapter> storage, const SimulatedLatency latency);
+		~SimulatedLatencyStorageAdapter() final;
+
+		protected:
+		void setInternal(const number location, const bytes &raw) final;
+		void getInternal(const number location, bytes &reponse) const final;
+
+		void setInternal(const vector<pair<number, bytes>> &requests) final;
+		void getInternal(const vector<number> &locations, vector<bytes> &response) const final;
+
+		bool supportsBatchGet() const final { return latency.batching; };
+		bool supportsBatchSet() const final { return latency.batching; };
+
+		public:
+		/**
+		 * @brief the memory of the decorator and of the wrapped storage
+		 */
+		number memoryUsage() const final;
+	};
+
 #if USE_REDIS
 	/**
 	 * @brief Redis implementation of the storage adapter.
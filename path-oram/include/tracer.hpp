@@ -0,0 +1,165 @@
+#pragma once
+
+#include "definitions.h"
+
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <memory>
+
+namespace PathORAM
+{
+	using namespace std;
+
+	/**
+	 * @brief a span recorded by Tracer (a Chrome trace "complete" event, i.e. begin and end in one record)
+	 */
+	struct TraceEvent
+	{
+		const char *name	 = nullptr; // the name of the span (a string literal)
+		const char *category = nullptr; // the category of the span, e.g. "oram" or "storage" (a string literal)
+		number start		 = 0;		// the beginning, in nanoseconds since the tracer was constructed
+		number duration		 = 0;		// the duration in nanoseconds
+		number thread		 = 0;		// the ID of the thread that recorded the span (see Tracer::threadId)
+		number batch		 = 0;		// the ID of the batch the span belongs to (0 if none, see Tracer::beginBatch)
+		number buckets		 = 0;		// the number of buckets read or written (storage calls only)
+	};
+
+	/**
+	 * @brief Lock-free recorder of ORAM access timelines, exported as Chrome trace JSON (loads in Perfetto and chrome://tracing)
+	 *
+	 * Spans are written into a fixed-size ring buffer: a writer claims a slot with one atomic increment,
+	 * so recording does not lock or allocate, and once the buffer is full the oldest spans are overwritten.
+	 * Each span carries the thread that recorded it and the batch (ORAM call) it belongs to.
+	 *
+	 * Attach a tracer with ORAM::setTracer (phases and calls, position map ORAMs included)
+	 * and AbsStorageAdapter::setTracer (storage calls, encryption and decryption).
+	 */
+	class Tracer
+	{
+		private:
+		struct Slot
+		{
+			atomic<number> sequence = 0; // 2 * index + 2 once the span with this index is written (odd while writing)
+			TraceEvent event;
+		};
+
+		const number capacity;
+		const unique_ptr<Slot[]> slots;
+		const chrono::steady_clock::time_point origin;
+
+		atomic<number> head	   = 0; // the number of spans recorded so far
+		atomic<number> batches = 0; // the last batch ID given out
+
+		inline static atomic<number> threads			= 0; // the last thread ID given out
+		inline static thread_local number batch			= 0; // the batch of the calling thread (0 if none)
+		inline static thread_local number batchDepth	= 0; // the number of nested beginBatch calls on the calling thread
+
+		public:
+		/**
+		 * @brief Construct a new Tracer object
+		 *
+		 * @param capacity the number of spans to keep (must be a power of two)
+		 */
+		Tracer(const number capacity = 1 << 16);
+
+		/**
+		 * @brief records a span on the calling thread, in its current batch
+		 *
+		 * Lock-free and wait-free; may be called from any thread.
+		 *
+		 * @param name the name of the span (must be a string literal, it is not copied)
+		 * @param category the category of the span (must be a string literal, it is not copied)
+		 * @param start the beginning of the span
+		 * @param end the end of the span
+		 * @param buckets the number of buckets read or written (0 if not applicable)
+		 */
+		void record(const char *name, const char *category, const chrono::steady_clock::time_point start, const chrono::steady_clock::time_point end, const number buckets = 0);
+
+		/**
+		 * @brief starts a batch on the calling thread, unless one is already started
+		 *
+		 * Calls nest: an ORAM call made within another one (e.g. to a position map ORAM) joins the outer batch.
+		 * Each beginBatch must be matched by endBatch, also if the code in between throws (see TraceBatch).
+		 *
+		 * @return number the ID of the current batch of the calling thread
+		 */
+		number beginBatch();
+
+		/**
+		 * @brief ends the batch started by the matching beginBatch
+		 */
+		void endBatch();
+
+		/**
+		 * @brief copies the spans that have not been overwritten, oldest first
+		 *
+		 * Spans that are being written (or overwritten) during the call are skipped.
+		 *
+		 * @return vector<TraceEvent> the spans
+		 */
+		vector<TraceEvent> events() const;
+
+		/**
+		 * @brief the number of spans recorded since construction
+		 */
+		number recorded() const;
+
+		/**
+		 * @brief the number of spans lost because the buffer was full
+		 */
+		number overwritten() const;
+
+		/**
+		 * @brief writes the spans as Chrome trace JSON (timestamps in microseconds, batch and buckets as arguments)
+		 *
+		 * @param output the stream to write to
+		 */
+		void dump(ostream &output) const;
+
+		/**
+		 * @brief writes the spans as Chrome trace JSON to a file
+		 *
+		 * @param filename the name of the file to write to
+		 */
+		void dump(const string &filename) const;
+
+		/**
+		 * @brief a small sequential ID of the calling thread (given on the first call, starting from 1)
+		 */
+		static number threadId();
+	};
+
+	/**
+	 * @brief scope guard of a trace batch: Tracer::beginBatch on construction,
+	 * and on destruction (also during unwinding) records the span of the whole scope and calls Tracer::endBatch
+	 *
+	 * Does nothing if the tracer is null.
+	 */
+	class TraceBatch
+	{
+		private:
+		Tracer *const tracer;
+		const char *const name;
+		const char *const category;
+		const chrono::steady_clock::time_point start;
+
+		public:
+		/**
+		 * @brief starts the batch (or joins the current one) and the span
+		 *
+		 * @param tracer the tracer to record to (may be nullptr)
+		 * @param name the name of the span (must be a string literal, it is not copied)
+		 * @param category the category of the span (must be a string literal, it is not copied)
+		 */
+		TraceBatch(Tracer *tracer, const char *name, const char *category);
+
+		/**
+		 * @brief records the span and ends the batch
+		 */
+		~TraceBatch();
+
+		TraceBatch(const TraceBatch &) = delete;
+		TraceBatch &operator=(const TraceBatch &) = delete;
+	};
+}
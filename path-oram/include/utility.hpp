@@ -2,6 +2,7 @@
 
 #include "definitions.h"
 
+#include <memory>
 #include <string>
 
 namespace PathORAM
@@ -20,6 +21,16 @@ namespace PathORAM
 	 */
 	bytes getRandomBlock(const number blockSize);
 
+	/**
+	 * @brief fill a buffer pseudorandomly
+	 *
+	 * Same as getRandomBlock, but writes to a given buffer.
+	 *
+	 * @param buffer the buffer to write to
+	 * @param size the number of bytes to generate
+	 */
+	void getRandomBlock(uchar *buffer, const number size);
+
 	/**
 	 * @brief returns a pseudorandom number
 	 *
@@ -71,6 +82,20 @@ namespace PathORAM
 		bytes &output,
 		const EncryptionMode mode);
 
+	/**
+	 * @brief Encryption routine on raw buffers
+	 *
+	 * Same as the iterator version, but writes to a given buffer (does not allocate).
+	 *
+	 * @param key the AES key (KEYSIZE bytes)
+	 * @param iv the initialization vector (AES block size, 16 bytes; not modified)
+	 * @param input the plaintext or ciphertext material, without IV
+	 * @param size the size of the input, must be the multiple of AES block size (16 bytes)
+	 * @param output the buffer of at least size bytes to put the result in (must not overlap the input)
+	 * @param mode ENCRYPTION or DECRYPTION
+	 */
+	void encrypt(const uchar *key, const uchar *iv, const uchar *input, const number size, uchar *output, const EncryptionMode mode);
+
 	/**
 	 * @brief helper to convert string to bytes and pad (from right with zeros)
 	 *
@@ -123,4 +148,246 @@ namespace PathORAM
 	 * @return number the hash of the message as a number [0, max)
 	 */
 	number hashToNumber(const bytes &input, number max);
+
+	/**
+	 * @brief an estimate of the memory held by a node-based hash table (unordered_map or unordered_set), in bytes
+	 *
+	 * Each node holds the entry and a pointer, the table also has its bucket array.
+	 * Memory owned by the entries themselves (e.g. the buffers of vectors) is not included.
+	 *
+	 * @param table the hash table in question
+	 * @return number the footprint of the table in bytes
+	 */
+	template <class M>
+	number hashMapMemory(const M &table)
+	{
+		return table.size() * (sizeof(typename M::value_type) + sizeof(void *)) + table.bucket_count() * sizeof(void *);
+	}
+
+	/**
+	 * @brief Fixed-capacity open-addressing hash map from number to number
+	 *
+	 * All memory is allocated in the constructor, no insertion or removal allocates.
+	 * Slots are split in groups of 16, and each slot has a control byte (empty, deleted or 7 bits of the hash).
+	 * A lookup compares the control bytes of a whole group at once (SSE2 if available) and only compares keys on a match.
+	 * Removed slots become tombstones; when they use up the free slots, the table is rehashed in place into a spare, preallocated copy.
+	 */
+	class FixedHashMap
+	{
+		private:
+		inline static const number GROUP = 16;
+
+		const number maxSize; // maximum number of entries
+		const number slots;	  // number of slots (power of two, multiple of GROUP)
+
+		number count   = 0; // number of entries
+		number deleted = 0; // number of tombstones
+
+		vector<signed char> control, spareControl;
+		vector<number> keys, spareKeys;
+		vector<number> values, spareValues;
+
+		/**
+		 * @brief mixes the bits of the key
+		 */
+		static number hash(const number key);
+
+		/**
+		 * @brief bitmask of the slots in the group whose control byte is equal to value
+		 */
+		uint match(const number group, const signed char value) const;
+
+		/**
+		 * @brief bitmask of the slots in the group that are empty or deleted
+		 */
+		uint matchFree(const number group) const;
+
+		/**
+		 * @brief slot of the key, or slots if it is not present
+		 */
+		number slot(const number key) const;
+
+		/**
+		 * @brief reinserts all entries, dropping tombstones
+		 */
+		void rehash();
+
+		public:
+		/**
+		 * @brief Construct a new Fixed Hash Map object
+		 *
+		 * @param maxSize the maximum number of entries (insertion of more throws exception)
+		 */
+		FixedHashMap(const number maxSize);
+
+		/**
+		 * @brief looks up the key
+		 *
+		 * @param key the key in question
+		 * @param value the value for the key (untouched if key is not present)
+		 * @return true if the key is present
+		 * @return false otherwise
+		 */
+		bool get(const number key, number &value) const;
+
+		/**
+		 * @brief inserts the key or overrides its value
+		 *
+		 * Throws exception if the key is new and the map is full.
+		 *
+		 * @param key the key in question
+		 * @param value the value to set
+		 */
+		void set(const number key, const number value);
+
+		/**
+		 * @brief removes the key
+		 *
+		 * Does nothing if the key is not present.
+		 *
+		 * @param key the key in question
+		 * @return true if the key was present
+		 * @return false otherwise
+		 */
+		bool remove(const number key);
+
+		/**
+		 * @brief removes all entries
+		 */
+		void clear();
+
+		/**
+		 * @brief the number of entries
+		 */
+		number size() const;
+
+		/**
+		 * @brief the heap memory held by the map in bytes (the slots and the spare slots for rehashing)
+		 */
+		number memoryUsage() const;
+	};
+
+	class BlockArena;
+
+	/**
+	 * @brief Move-only handle to a fixed-size chunk of a BlockArena
+	 *
+	 * Returns the chunk to the arena when destroyed or reset.
+	 * Must not outlive the arena.
+	 */
+	class BlockHandle
+	{
+		private:
+		BlockArena *arena = nullptr;
+		uchar *chunk	  = nullptr;
+
+		BlockHandle(BlockArena *arena, uchar *chunk);
+
+		friend class BlockArena;
+
+		public:
+		/**
+		 * @brief Construct an empty handle (holds no chunk)
+		 */
+		BlockHandle() = default;
+
+		BlockHandle(const BlockHandle &) = delete;
+		BlockHandle &operator=(const BlockHandle &) = delete;
+
+		BlockHandle(BlockHandle &&other) noexcept;
+		BlockHandle &operator=(BlockHandle &&other) noexcept;
+
+		~BlockHandle();
+
+		/**
+		 * @brief the chunk (nullptr if empty)
+		 */
+		uchar *data() const;
+
+		/**
+		 * @brief the size of the chunk in bytes (0 if empty)
+		 */
+		number size() const;
+
+		/**
+		 * @brief copies the data to the chunk, and pads it with zeroes
+		 *
+		 * Throws exception if the data is longer than the chunk.
+		 *
+		 * @param data the data to copy
+		 * @param size the size of the data in bytes
+		 */
+		void assign(const uchar *data, const number size);
+
+		/**
+		 * @brief returns the chunk to the arena (the handle becomes empty)
+		 */
+		void reset();
+	};
+
+	/**
+	 * @brief Pool of fixed-size chunks (blocks) allocated in slabs
+	 *
+	 * Chunks are handed out as BlockHandle and come back to the free list when handles are destroyed.
+	 * Slabs are only released with the arena, so once the arena has grown to the working set, allocating a block does not touch the heap.
+	 * Not thread-safe; meant to be owned by a single ORAM (so that ORAMs do not contend on the allocator).
+	 */
+	class BlockArena
+	{
+		private:
+		const number blockSize; // size of a chunk in bytes
+		const number slabSize;	// number of chunks in a slab
+
+		vector<unique_ptr<uchar[]>> slabs;
+		vector<uchar *> freeChunks;
+
+		/**
+		 * @brief puts the chunk back in the free list
+		 */
+		void release(uchar *chunk);
+
+		friend class BlockHandle;
+
+		public:
+		/**
+		 * @brief Construct a new Block Arena object
+		 *
+		 * @param blockSize the size of a chunk in bytes
+		 * @param slabSize the number of chunks allocated at once, when the free list is empty
+		 */
+		BlockArena(const number blockSize, const number slabSize = 64);
+
+		BlockArena(const BlockArena &) = delete;
+		BlockArena &operator=(const BlockArena &) = delete;
+
+		/**
+		 * @brief hands out a chunk (its content is undefined)
+		 *
+		 * @return BlockHandle the handle owning the chunk
+		 */
+		BlockHandle allocate();
+
+		/**
+		 * @brief the size of a chunk in bytes
+		 */
+		number chunkSize() const;
+
+		/**
+		 * @brief the number of chunks allocated so far (in use or free)
+		 */
+		number capacity() const;
+
+		/**
+		 * @brief the number of free chunks
+		 */
+		number available() const;
+
+		/**
+		 * @brief the heap memory held by the arena in bytes (all slabs, whether the chunks are in use or free)
+		 */
+		number memoryUsage() const;
+	};
+
+	using arenaBlock  = pair<number, BlockHandle>; // {ID, payload in arena chunk}
+	using arenaBucket = vector<arenaBlock>;
 }
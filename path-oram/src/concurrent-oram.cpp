@@ -0,0 +1,135 @@
+#include "concurrent-oram.hpp"
+
+#include <boost/format.hpp>
+
+namespace PathORAM
+{
+	using namespace std;
+	using boost::format;
+
+	ConcurrentORAM::ConcurrentORAM(const shared_ptr<ORAM> oram, const number batchSize, const chrono::microseconds deadline) :
+		oram(oram),
+		batchSize(batchSize),
+		deadline(deadline)
+	{
+#if INPUT_CHECKS
+		if (batchSize == 0)
+		{
+			throw Exception("batch size must be positive");
+		}
+#endif
+
+		dispatcher = thread(&ConcurrentORAM::run, this);
+	}
+
+	ConcurrentORAM::~ConcurrentORAM()
+	{
+		{
+			lock_guard<mutex> guard(lock);
+			stopping = true;
+		}
+		pending.notify_one();
+
+		dispatcher.join();
+	}
+
+	future<bytes> ConcurrentORAM::get(const number block)
+	{
+		return submit(block, bytes());
+	}
+
+	future<bytes> ConcurrentORAM::put(const number block, bytes data)
+	{
+#if INPUT_CHECKS
+		if (data.size() == 0)
+		{
+			throw Exception("cannot put empty data (empty payload means GET)");
+		}
+#endif
+
+		return submit(block, move(data));
+	}
+
+	number ConcurrentORAM::dispatchedBatches()
+	{
+		lock_guard<mutex> guard(lock);
+		return batches;
+	}
+
+	future<bytes> ConcurrentORAM::submit(const number block, bytes &&data)
+	{
+		future<bytes> result;
+		bool wake;
+		{
+			lock_guard<mutex> guard(lock);
+			queue.push_back({block, move(data), promise<bytes>(), chrono::steady_clock::now()});
+			result = queue.back().result.get_future();
+			wake   = queue.size() == 1 || queue.size() >= batchSize;
+		}
+
+		// the dispatcher only needs to wake up for the first request (to start the deadline) and for a full batch
+		if (wake)
+		{
+			pending.notify_one();
+		}
+
+		return result;
+	}
+
+	void ConcurrentORAM::run()
+	{
+		unique_lock<mutex> guard(lock);
+		while (true)
+		{
+			pending.wait(guard, [this] { return stopping || !queue.empty(); });
+			if (queue.empty())
+			{
+				// stopping and nothing left to answer
+				return;
+			}
+
+			// wait for the batch to fill, but not longer than the deadline of the oldest request
+			pending.wait_until(guard, queue.front().submitted + deadline, [this] { return stopping || queue.size() >= batchSize; });
+
+			vector<Request> batch;
+			const auto size = min(batchSize, (number)queue.size());
+			batch.reserve(size);
+			for (number i = 0; i < size; i++)
+			{
+				batch.push_back(move(queue.front()));
+				queue.pop_front();
+			}
+			batches++;
+
+			// new requests may be queued while the batch runs
+			guard.unlock();
+
+			vector<block> requests;
+			requests.reserve(batch.size());
+			for (auto &&request : batch)
+			{
+				requests.push_back({request.block, move(request.data)});
+			}
+
+			try
+			{
+				vector<bytes> response;
+				oram->multiple(requests, response);
+
+				for (number i = 0; i < batch.size(); i++)
+				{
+					batch[i].result.set_value(move(response[i]));
+				}
+			}
+			catch (...)
+			{
+				for (auto &&request : batch)
+				{
+					request.result.set_exception(current_exception());
+				}
+			}
+
+			guard.lock();
+		}
+	}
+}
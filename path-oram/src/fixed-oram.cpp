@@ -0,0 +1,8 @@
+#include "fixed-oram.hpp"
+
+namespace PathORAM
+{
+	template class FixedORAM<3, 32>;
+	template class FixedORAM<4, 64>;
+	template class FixedORAM<4, 4096>;
+}
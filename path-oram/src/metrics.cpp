@@ -0,0 +1,171 @@
+#include "metrics.hpp"
+
+#include <cmath>
+
+namespace PathORAM
+{
+	using namespace std;
+
+#pragma region HistogramSnapshot
+
+	number HistogramSnapshot::percentile(const double quantile) const
+	{
+		if (count == 0)
+		{
+			return 0;
+		}
+
+		// the rank of the value, from 1 to count
+		const auto rank = std::max(1uLL, (number)ceil(quantile * count));
+
+		number seen = 0;
+		for (number i = 0; i < counts.size(); i++)
+		{
+			seen += counts[i];
+			if (seen >= rank)
+			{
+				return Histogram::lowerBound(i);
+			}
+		}
+		return Histogram::lowerBound(counts.size() - 1);
+	}
+
+	double HistogramSnapshot::mean() const
+	{
+		return count == 0 ? 0 : (double)sum / count;
+	}
+
+#pragma endregion HistogramSnapshot
+
+#pragma region Histogram
+
+	number Histogram::bucket(const number value)
+	{
+		if (value < SUB_BUCKETS)
+		{
+			return value;
+		}
+
+		// position of the highest set bit, then the next SUB_BITS bits select the linear bucket
+		const number exponent = 63 - __builtin_clzll(value);
+		const auto sub		  = (value >> (exponent - SUB_BITS)) & (SUB_BUCKETS - 1);
+		return (exponent - SUB_BITS + 1) * SUB_BUCKETS + sub;
+	}
+
+	number Histogram::lowerBound(const number bucket)
+	{
+		if (bucket < SUB_BUCKETS)
+		{
+			return bucket;
+		}
+
+		const auto exponent = bucket / SUB_BUCKETS + SUB_BITS - 1;
+		const auto sub		= bucket % SUB_BUCKETS;
+		return (1uLL << exponent) + (sub << (exponent - SUB_BITS));
+	}
+
+	void Histogram::record(const number value)
+	{
+		counts[bucket(value)].fetch_add(1, memory_order_relaxed);
+		count.fetch_add(1, memory_order_relaxed);
+		sum.fetch_add(value, memory_order_relaxed);
+
+		auto current = max.load(memory_order_relaxed);
+		while (value > current && !max.compare_exchange_weak(current, value, memory_order_relaxed))
+		{
+		}
+	}
+
+	HistogramSnapshot Histogram::snapshot() const
+	{
+		HistogramSnapshot result;
+		result.count = count.load(memory_order_relaxed);
+		result.sum	 = sum.load(memory_order_relaxed);
+		result.max	 = max.load(memory_order_relaxed);
+
+		// trailing empty buckets are not copied
+		number last = 0;
+		for (number i = 0; i < BUCKETS; i++)
+		{
+			if (counts[i].load(memory_order_relaxed) > 0)
+			{
+				last = i + 1;
+			}
+		}
+		result.counts.reserve(last);
+		for (number i = 0; i < last; i++)
+		{
+			result.counts.push_back(counts[i].load(memory_order_relaxed));
+		}
+
+		return result;
+	}
+
+	void Histogram::reset()
+	{
+		for (auto &&bucket : counts)
+		{
+			bucket.store(0, memory_order_relaxed);
+		}
+		count.store(0, memory_order_relaxed);
+		sum.store(0, memory_order_relaxed);
+		max.store(0, memory_order_relaxed);
+	}
+
+#pragma endregion Histogram
+
+#pragma region StorageMetrics
+
+	void StorageMetrics::recordRead(const number buckets, const number size, const number elapsed)
+	{
+		reads.fetch_add(1, memory_order_relaxed);
+		readBuckets.fetch_add(buckets, memory_order_relaxed);
+		readBytes.fetch_add(size, memory_order_relaxed);
+		readLatency.record(elapsed);
+		readBatch.record(buckets);
+	}
+
+	void StorageMetrics::recordWrite(const number buckets, const number size, const number elapsed)
+	{
+		writes.fetch_add(1, memory_order_relaxed);
+		writtenBuckets.fetch_add(buckets, memory_order_relaxed);
+		writtenBytes.fetch_add(size, memory_order_relaxed);
+		writeLatency.record(elapsed);
+		writeBatch.record(buckets);
+	}
+
+	StorageMetricsSnapshot StorageMetrics::snapshot(const bool histograms) const
+	{
+		StorageMetricsSnapshot result;
+		result.reads		  = reads.load(memory_order_relaxed);
+		result.writes		  = writes.load(memory_order_relaxed);
+		result.readBuckets	  = readBuckets.load(memory_order_relaxed);
+		result.writtenBuckets = writtenBuckets.load(memory_order_relaxed);
+		result.readBytes	  = readBytes.load(memory_order_relaxed);
+		result.writtenBytes	  = writtenBytes.load(memory_order_relaxed);
+		if (!histograms)
+		{
+			return result;
+		}
+
+		result.readLatency	  = readLatency.snapshot();
+		result.writeLatency	  = writeLatency.snapshot();
+		result.readBatch	  = readBatch.snapshot();
+		result.writeBatch	  = writeBatch.snapshot();
+		return result;
+	}
+
+	void StorageMetrics::reset()
+	{
+		for (auto counter : {&reads, &writes, &readBuckets, &writtenBuckets, &readBytes, &writtenBytes})
+		{
+			counter->store(0, memory_order_relaxed);
+		}
+		for (auto histogram : {&readLatency, &writeLatency, &readBatch, &writeBatch})
+		{
+			histogram->reset();
+		}
+	}
+
+#pragma endregion StorageMetrics
+}
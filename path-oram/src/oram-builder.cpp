@@ -0,0 +1,155 @@
+#include "oram-builder.hpp"
+
+#include <boost/format.hpp>
+#include <openssl/aes.h>
+
+namespace PathORAM
+{
+	using namespace std;
+	using boost::format;
+
+	/**
+	 * @brief the smallest tree height such that n blocks fill at most 3/4 of the tree
+	 */
+	number logCapacityFor(const number n, const number Z)
+	{
+		number logCapacity = 3;
+		while (((1uLL << logCapacity) * Z * 3) < n * 4)
+		{
+			logCapacity++;
+		}
+		return logCapacity;
+	}
+
+	/**
+	 * @brief a level with the stash capacity used throughout (3 * height * Z)
+	 */
+	ORAMLevel makeLevel(const number logCapacity, const number blockSize, const number Z, const number plbCapacity)
+	{
+		return {logCapacity, blockSize, Z, 3 * logCapacity * Z, plbCapacity};
+	}
+
+	/**
+	 * @brief bytes transferred per access to the data level (each access makes a get and a set to the next level)
+	 */
+	number plannedBandwidth(const vector<ORAMLevel> &levels)
+	{
+		number bandwidth = 0;
+		for (auto i = 0uLL; i < levels.size(); i++)
+		{
+			const auto bucketSize = (levels[i].blockSize + AES_BLOCK_SIZE) * levels[i].Z + AES_BLOCK_SIZE;
+			// read and write the path, 2^i times
+			bandwidth += (1uLL << i) * 2 * levels[i].logCapacity * bucketSize;
+		}
+		return bandwidth;
+	}
+
+	number plannedMemoryUsage(const vector<ORAMLevel> &levels)
+	{
+		number memory = 0;
+		for (auto &&level : levels)
+		{
+			memory += level.stashCapacity * (level.blockSize + sizeof(number));
+			memory += level.plbCapacity * level.blockSize;
+		}
+
+		// in-memory position map of the last level
+		memory += ((1uLL << levels.back().logCapacity) * levels.back().Z) * sizeof(number);
+
+		return memory;
+	}
+
+	vector<ORAMLevel> planRecursiveORAM(const number capacity, const number blockSize, const number Z, const number memoryBudget, const number plbCapacity)
+	{
+		vector<ORAMLevel> best;
+		number smallest = ULLONG_MAX;
+
+		for (auto &&mapBlockSize : {32uLL, 64uLL, 128uLL, 256uLL})
+		{
+			for (auto &&mapZ : {3uLL, 4uLL})
+			{
+				vector<ORAMLevel> levels = {makeLevel(logCapacityFor(capacity, Z), blockSize, Z, 0)};
+
+				while (true)
+				{
+					const auto memory = plannedMemoryUsage(levels);
+					smallest		  = min(smallest, memory);
+					if (memory <= memoryBudget)
+					{
+						if (best.size() == 0 || plannedBandwidth(levels) < plannedBandwidth(best))
+						{
+							best = levels;
+						}
+						break;
+					}
+
+					// positions of all blocks of the last level packed into blocks of the next level
+					const auto blocks	  = (1uLL << levels.back().logCapacity) * levels.back().Z;
+					const auto positions  = mapBlockSize / sizeof(number);
+					const auto next		  = makeLevel(logCapacityFor((blocks + positions - 1) / positions, mapZ), mapBlockSize, mapZ, plbCapacity);
+					const auto nextBlocks = (1uLL << next.logCapacity) * next.Z;
+					if (nextBlocks >= blocks)
+					{
+						// recursion does not shrink the position map anymore
+						break;
+					}
+					levels.push_back(next);
+				}
+			}
+		}
+
+		if (best.size() == 0)
+		{
+			throw Exception(boost::format("memory budget of %1% bytes is too small (need at least %2% bytes)") % memoryBudget % smallest);
+		}
+
+		return best;
+	}
+
+	unique_ptr<ORAM> buildRecursiveORAM(const vector<ORAMLevel> &levels, const StorageFactory &storageFactory, const number batchSize)
+	{
+		const auto factory = storageFactory ?
+								 storageFactory :
+								 [](const number level, const number capacity, const number blockSize, const number Z) -> shared_ptr<AbsStorageAdapter> {
+									 return make_shared<InMemoryStorageAdapter>(capacity, blockSize, bytes(), Z);
+								 };
+
+		if (levels.size() == 0)
+		{
+			throw Exception("no levels to build");
+		}
+
+		const auto &last = levels.back();
+		shared_ptr<AbsPositionMapAdapter> map = make_shared<InMemoryPositionMapAdapter>((1uLL << last.logCapacity) * last.Z);
+
+		// build from the last position map level up to the data level
+		for (auto i = (long long)levels.size() - 1; i >= 0; i--)
+		{
+			const auto &level = levels[i];
+
+			auto oram = make_unique<ORAM>(
+				level.logCapacity,
+				level.blockSize,
+				level.Z,
+				factory(i, 1uLL << level.logCapacity, level.blockSize, level.Z),
+				map,
+				make_shared<InMemoryStashAdapter>(level.stashCapacity),
+				true,
+				i == 0 ? batchSize : 1);
+
+			if (i == 0)
+			{
+				return oram;
+			}
+
+			map = make_shared<ORAMPositionMapAdapter>(move(oram), level.plbCapacity);
+		}
+
+		return nullptr;
+	}
+
+	unique_ptr<ORAM> buildRecursiveORAM(const number capacity, const number blockSize, const number Z, const number memoryBudget, const StorageFactory &storageFactory, const number plbCapacity, const number batchSize)
+	{
+		return buildRecursiveORAM(planRecursiveORAM(capacity, blockSize, Z, memoryBudget, plbCapacity), storageFactory, batchSize);
+	}
+}
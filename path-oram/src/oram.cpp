@@ -2,6 +2,7 @@
 
 #include "utility.hpp"
 
+#include <algorithm>
 #include <boost/format.hpp>
 
 namespace PathORAM
@@ -9,6 +10,9 @@ namespace PathORAM
 	using namespace std;
 	using boost::format;
 
+	// the span names of the phases (see ORAMPhase)
+	const char *const PHASE_NAMES[] = {"position map", "path read", "decrypt", "stash", "evict", "encrypt", "write back"};
+
 	ORAM::ORAM(
 		const number logCapacity,
 		const number blockSize,
@@ -26,7 +30,10 @@ namespace PathORAM
 		height(logCapacity),
 		buckets((number)1 << logCapacity),
 		blocks(((number)1 << logCapacity) * Z),
-		batchSize(batchSize)
+		batchSize(batchSize),
+		arena(blockSize),
+		cacheIndex(make_unique<FixedHashMap>(batchSize * logCapacity)),
+		cacheCapacity(batchSize * logCapacity)
 	{
 		if (initialize)
 		{
@@ -34,10 +41,7 @@ namespace PathORAM
 			storage->fillWithZeroes();
 
 			// generate random position map
-			for (number i = 0; i < blocks; ++i)
-			{
-				map->set(i, getRandomULong(1 << (height - 1)));
-			}
+			map->initialize(blocks, 1 << (height - 1));
 		}
 	}
 
@@ -51,21 +55,142 @@ namespace PathORAM
 	{
 	}
 
-	void ORAM::get(const number block, bytes &response)
+	void ORAM::get(const number block, bytes &response, AccessStats *stats)
+	{
+		const Call call(this, stats, "get");
+		response.resize(dataSize);
+		response.resize(access(block, nullptr, response.data()));
+		syncCache();
+	}
+
+	void ORAM::put(const number block, const bytes &data, AccessStats *stats)
+	{
+		const Call call(this, stats, "put");
+		auto copy = data;
+		access(block, &copy, nullptr);
+		syncCache();
+	}
+
+	number ORAM::get(const number block, uchar *response, AccessStats *stats)
+	{
+		const Call call(this, stats, "get");
+		const auto size = access(block, nullptr, response);
+		syncCache();
+		return size;
+	}
+
+	void ORAM::put(const number block, bytes &&data, AccessStats *stats)
 	{
-		bytes data;
-		access(true, block, data, response);
+		const Call call(this, stats, "put");
+		access(block, &data, nullptr);
+		syncCache();
+	}
+
+	void ORAM::multiple(const vector<block> &requests, vector<bytes> &response, AccessStats *stats)
+	{
+		const Call call(this, stats, "multiple");
+		vector<pair<number, vector<number>>> groups;
+		vector<pair<number, number>> dummies;
+		prefetch(requests, groups, dummies);
+
+		// run ORAM protocol (will use cache), one access per distinct ID
+		response.resize(requests.size());
+		for (auto &&[id, indices] : groups)
+		{
+			const auto put = lastPut(requests, indices);
+
+			// the content before the access is only needed if the first request is GET
+			bytes current;
+			const auto needsCurrent = requests[indices.front()].second.size() == 0;
+			if (needsCurrent)
+			{
+				current.resize(dataSize);
+			}
+			if (put != ULONG_MAX)
+			{
+				auto copy = requests[put].second;
+				current.resize(access(id, &copy, needsCurrent ? current.data() : nullptr));
+			}
+			else
+			{
+				current.resize(access(id, nullptr, current.data()));
+			}
+
+			// apply the requests in order
+			const bytes *latest = &current;
+			for (auto &&index : indices)
+			{
+				if (requests[index].second.size() > 0)
+				{
+					latest = &requests[index].second;
+				}
+				response[index] = *latest;
+			}
+		}
+
+		dummyRequests(dummies);
+
+		// upload resulting new data
 		syncCache();
 	}
 
-	void ORAM::put(const number block, const bytes &data)
+	void ORAM::multiple(vector<block> &&requests, uchar *response, AccessStats *stats)
 	{
-		bytes response;
-		access(false, block, data, response);
+		const Call call(this, stats, "multiple");
+		vector<pair<number, vector<number>>> groups;
+		vector<pair<number, number>> dummies;
+		prefetch(requests, groups, dummies);
+
+		// run ORAM protocol (will use cache), one access per distinct ID
+		for (auto &&[id, indices] : groups)
+		{
+			const auto put	 = lastPut(requests, indices);
+			const auto first = response + indices.front() * dataSize;
+
+			// a PUT is answered with its payload, copied before the last one is moved into the stash
+			for (auto &&index : indices)
+			{
+				const auto &data = requests[index].second;
+				if (data.size() > 0)
+				{
+#if INPUT_CHECKS
+					if (data.size() > dataSize)
+					{
+						throw Exception(boost::format("data of size %1% does not fit in a block of size %2%") % data.size() % dataSize);
+					}
+#endif
+					const auto answer = copy(data.begin(), data.end(), response + index * dataSize);
+					fill(answer, response + (index + 1) * dataSize, 0x00);
+				}
+			}
+
+			// the content before the access is only needed if the first request is GET
+			const auto needsCurrent = requests[indices.front()].second.size() == 0;
+			access(id, put != ULONG_MAX ? &requests[put].second : nullptr, needsCurrent ? first : nullptr);
+
+			// GETs are answered with the latest content (the payload of the last PUT has been moved out)
+			const uchar *latest = first;
+			for (auto &&index : indices)
+			{
+				const auto answer = response + index * dataSize;
+				if (requests[index].second.size() > 0 || index == put || index == indices.front())
+				{
+					latest = answer;
+				}
+				else
+				{
+					copy(latest, latest + dataSize, answer);
+				}
+			}
+		}
+
+		dummyRequests(dummies);
+
+		// upload resulting new data
 		syncCache();
 	}
 
-	void ORAM::multiple(const vector<block> &requests, vector<bytes> &response)
+	void ORAM::prefetch(const vector<block> &requests, vector<pair<number, vector<number>>> &groups, vector<pair<number, number>> &dummies)
 	{
 #if INPUT_CHECKS
 		if (requests.size() > batchSize)
@@ -74,25 +199,58 @@ namespace PathORAM
 		}
 #endif
 
-		// populate cache
-		unordered_set<number> locations;
-		for (auto &&request : requests)
+		// populate cache, duplicates are replaced with dummy accesses to random paths
+		unordered_map<number, number> group; // ID to its index in groups
+		path.clear();
+		for (auto i = 0uLL; i < requests.size(); i++)
 		{
-			readPath(map->get(request.first), locations, false);
+			const auto id	= requests[i].first;
+			const auto leaf = map->get(id);
+
+			const auto [found, inserted] = group.insert({id, groups.size()});
+			if (inserted)
+			{
+				groups.push_back({id, {i}});
+				readPath(leaf, path, false);
+			}
+			else
+			{
+				groups[found->second].second.push_back(i);
+
+				const auto dummyLeaf = getRandomULong(1 << (height - 1));
+				dummies.push_back({id, dummyLeaf});
+				readPath(dummyLeaf, path, false);
+			}
 		}
 
-		vector<block> cacheResponse;
-		getCache(locations, cacheResponse, true);
+		// the paths share buckets (at least the root)
+		sort(path.begin(), path.end());
+		path.erase(unique(path.begin(), path.end()), path.end());
+		getCache(path, pathBlocks, true);
+	}
 
-		// run ORAM protocol (will use cache)
-		response.resize(requests.size());
-		for (auto i = 0u; i < requests.size(); i++)
+	number ORAM::lastPut(const vector<block> &requests, const vector<number> &indices) const
+	{
+		for (auto index = indices.rbegin(); index != indices.rend(); index++)
 		{
-			access(requests[i].second.size() == 0, requests[i].first, requests[i].second, response[i]);
+			if (requests[*index].second.size() > 0)
+			{
+				return *index;
+			}
 		}
+		return ULONG_MAX;
+	}
 
-		// upload resulting new data
-		syncCache();
+	void ORAM::dummyRequests(const vector<pair<number, number>> &dummies)
+	{
+		for (auto &&[id, leaf] : dummies)
+		{
+			// same position map traffic as access (the leaf does not change)
+			map->set(id, map->get(id));
+
+			dummyAccess(leaf);
+			afterAccess();
+		}
 	}
 
 	void ORAM::load(vector<block> &data)
@@ -121,6 +279,9 @@ namespace PathORAM
 			}
 		}
 
+		vector<pair<number, number>> positions;
+		positions.reserve(n);
+
 		auto iteration = 0uLL;
 		bucket bucket;
 		for (auto &&record : data)
@@ -128,7 +289,7 @@ namespace PathORAM
 			// to disperse locations evenly from 1 to maxLocation
 			const auto location	  = (number)floor(1 + iteration * step);
 			const auto [from, to] = leavesForLocation(location);
-			map->set(record.first, getRandomULong(to - from + 1) + from);
+			positions.push_back({record.first, getRandomULong(to - from + 1) + from});
 
 			if (bucket.size() < Z)
 			{
@@ -152,126 +313,263 @@ namespace PathORAM
 		}
 
 		storage->set(boost::make_iterator_range(writeRequests.begin(), writeRequests.end()));
+
+		// set all positions at once (recursive maps are rebuilt off-line)
+		map->load(positions);
 	}
 
-	void ORAM::access(const bool read, const number block, const bytes &data, bytes &response)
+	number ORAM::access(const number block, bytes *data, uchar *response)
 	{
+#if INPUT_CHECKS
+		if (data != nullptr && data->size() > dataSize)
+		{
+			throw Exception(boost::format("data of size %1% does not fit in a block of size %2%") % data->size() % dataSize);
+		}
+#endif
+
 		// step 1 from paper: remap block
+		auto start					= startPhase();
 		const auto previousPosition = map->get(block);
-		map->set(block, getRandomULong(1 << (height - 1)));
+		const auto newPosition		= getRandomULong(1 << (height - 1));
+		map->set(block, newPosition);
+		stopPhase(PHASE_POSITION_MAP, start);
 
 		// step 2 from paper: read path
-		unordered_set<number> path;
-		readPath(previousPosition, path, true); // stash updated
+		// the response is served from the cached path if the block is there (not copied back out of the stash)
+		path.clear();
+		const auto served = readPath(previousPosition, path, true, block, response); // stash updated
 
 		// step 3 from paper: update block
-		if (!read) // if "write"
+		start		= startPhase();
+		number size = 0;
+		if (response != nullptr)
 		{
-			stash->update(block, data);
+			size = served ? dataSize : stash->get(block, response);
+			fill(response + size, response + dataSize, 0x00);
 		}
-		stash->get(block, response);
+		if (data != nullptr) // if "write"
+		{
+			stash->update(block, move(*data));
+		}
+		stash->setLeaf(block, newPosition);
+		stopPhase(PHASE_STASH, start);
 
 		// step 4 from paper: write path
 		writePath(previousPosition); // stash updated
+
+		afterAccess();
+
+		return size;
+	}
+
+	void ORAM::dummyAccess(const number leaf)
+	{
+		path.clear();
+		readPath(leaf, path, true);
+		writePath(leaf);
+	}
+
+	void ORAM::afterAccess()
+	{
+		auto size = stash->currentSize();
+		if (evictionWatermark > 0)
+		{
+			for (number i = 0; i < maxEvictions && size >= evictionWatermark; i++)
+			{
+				dummyAccess(getRandomULong(1 << (height - 1)));
+				occupancy.dummyAccesses++;
+				size = stash->currentSize();
+			}
+		}
+
+		occupancy.current = size;
+		occupancy.max	  = max(occupancy.max, size);
+		occupancy.accesses++;
+		if (occupancy.histogram.size() <= size)
+		{
+			occupancy.histogram.resize(size + 1, 0);
+		}
+		occupancy.histogram[size]++;
+	}
+
+	void ORAM::setBackgroundEviction(const number watermark, const number maxAccesses)
+	{
+		evictionWatermark = watermark;
+		maxEvictions	  = maxAccesses;
+	}
+
+	StashOccupancy ORAM::stashOccupancy() const
+	{
+		return occupancy;
+	}
+
+	MemoryUsage ORAM::memoryUsage() const
+	{
+		MemoryUsage usage;
+		usage.storage	  = storage->memoryUsage();
+		usage.positionMap = map->memoryUsage(false);
+		usage.recursive	  = map->memoryUsage(true) - usage.positionMap;
+		usage.stash		  = stash->memoryUsage();
+
+		// the slots, the index and the arena are kept between calls, so are the scratch buffers
+		usage.cache = cache.capacity() * sizeof(pair<number, arenaBucket>) + cacheIndex->memoryUsage();
+		for (auto &&[location, bucket] : cache)
+		{
+			usage.cache += bucket.capacity() * sizeof(arenaBlock);
+		}
+		for (auto &&[location, bucket] : evicted)
+		{
+			usage.cache += bucket.capacity() * sizeof(arenaBlock);
+		}
+		usage.cache += arena.memoryUsage();
+		usage.cache += (path.capacity() + missing.capacity() + evictedIDs.capacity()) * sizeof(number);
+		usage.cache += downloaded.capacity() * sizeof(arenaBlock) + pathBlocks.capacity() * sizeof(const arenaBlock *);
+		usage.cache += eligible.capacity() * sizeof(tuple<number, number, const uchar *, number>) + evicted.capacity() * sizeof(pair<number, arenaBucket>);
+
+		return usage;
+	}
+
+	number MemoryUsage::total() const
+	{
+		return storage + positionMap + stash + cache + recursive;
 	}
 
-	void ORAM::readPath(const number leaf, unordered_set<number> &path, const bool putInStash)
+	bool ORAM::readPath(const number leaf, vector<number> &path, const bool putInStash, const number wanted, uchar *response)
 	{
 		// for levels from root to leaf
 		for (number level = 0; level < height; level++)
 		{
 			const auto bucket = bucketForLevelLeaf(level, leaf);
-			path.insert(bucket);
+			path.push_back(bucket);
 		}
 
 		// we may only want to populate cache
+		auto served = false;
 		if (putInStash)
 		{
-			vector<block> blocks;
-			getCache(path, blocks, false);
+			pathBlocks.clear();
+			getCache(path, pathBlocks, false);
 
-			for (auto &&[id, data] : blocks)
+			const auto start = startPhase();
+			for (auto &&block : pathBlocks)
 			{
+				const auto &[id, data] = *block;
 				// skip "empty" buckets
 				if (id != ULONG_MAX)
 				{
-					stash->add(id, data);
+					stash->add(id, data.data(), data.size());
+					if (stash->indexesLeaves())
+					{
+						stash->setLeaf(id, map->get(id));
+					}
+					if (id == wanted && response != nullptr)
+					{
+						copy(data.data(), data.data() + data.size(), response);
+						served = true;
+					}
 				}
 			}
+			stopPhase(PHASE_STASH, start);
 		}
+		return served;
 	}
 
 	void ORAM::writePath(const number leaf)
 	{
-		vector<block> currentStash;
-		stash->getAll(currentStash);
+		const auto start = startPhase();
+		if (stash->indexesLeaves())
+		{
+			writePathIndexed(leaf);
+			stopPhase(PHASE_EVICT, start);
+			return;
+		}
+
+		// stash entries in place {ID, leaf, data, size}, each leaf is looked up once
+		// the order does not matter, so the stash is not shuffled
+		eligible.clear();
+		stash->forEach(
+			[this](const number id, const uchar *data, const number size) {
+				eligible.push_back({id, map->get(id), data, size});
+			},
+			false);
 
-		vector<int> toDelete;				   // rember the records that will need to be deleted from stash
-		vector<pair<number, bucket>> requests; // storage SET requests (batching)
+		evictedIDs.clear(); // rember the records that will need to be deleted from stash
+		evicted.resize(height); // storage SET requests (batching), the buckets come back from the cache emptied
 
 		// following the path from leaf to root (greedy)
 		for (int level = height - 1; level >= 0; level--)
 		{
-			vector<block> toInsert;		  // block to be insterted in the bucket (up to Z)
-			vector<number> toDeleteLocal; // same blocks needs to be deleted from stash (these hold indices of elements in currentStash)
+			auto &[bucketId, bucket] = evicted[height - 1 - level];
+			bucketId				 = bucketForLevelLeaf(level, leaf);
 
-			for (number i = 0; i < currentStash.size(); i++)
+			// see which blocks from stash fit in this bucket (up to Z), keep the rest in local stash
+			number kept = 0;
+			for (number i = 0; i < eligible.size(); i++)
 			{
-				const auto &entry	 = currentStash[i];
-				const auto entryLeaf = map->get(entry.first);
-				// see if this block from stash fits in this bucket
-				if (canInclude(entryLeaf, leaf, level))
+				const auto &[id, entryLeaf, data, size] = eligible[i];
+				if (bucket.size() < Z && canInclude(entryLeaf, leaf, level))
 				{
-					toInsert.push_back(entry);
-					toDelete.push_back(entry.first);
-
-					toDeleteLocal.push_back(i);
-
-					// look up to Z
-					if (toInsert.size() == Z)
-					{
-						break;
-					}
-				}
-			}
-			// delete inserted blocks from local stash
-			// we remove elements by location, so after operation vector shrinks (nasty bug...)
-			sort(toDeleteLocal.begin(), toDeleteLocal.end(), greater<number>());
-			for (auto &&removed : toDeleteLocal)
-			{
-				currentStash.erase(currentStash.begin() + removed);
-			}
-
-			const auto bucketId = bucketForLevelLeaf(level, leaf);
-			bucket bucket;
-			bucket.resize(Z);
-
-			// write the bucket
-			for (number i = 0; i < Z; i++)
-			{
-				// auto block = bucket * Z + i;
-				if (toInsert.size() != 0)
-				{
-					bucket[i] = toInsert.back();
-					toInsert.pop_back();
+					bucket.push_back({id, arena.allocate()});
+					bucket.back().second.assign(data, size);
+					evictedIDs.push_back(id);
 				}
 				else
 				{
-					// if nothing to insert, insert dummy (for security)
-					bucket[i] = {ULONG_MAX, getRandomBlock(dataSize)};
+					eligible[kept++] = eligible[i];
 				}
 			}
+			eligible.resize(kept);
 
-			requests.push_back({bucketId, bucket});
+			// if nothing to insert, insert dummy (for security)
+			while (bucket.size() < Z)
+			{
+				bucket.push_back({ULONG_MAX, arena.allocate()});
+				getRandomBlock(bucket.back().second.data(), dataSize);
+			}
 		}
 
-		setCache(requests);
+		setCache(evicted);
 
-		// update the stash adapter, remove newly inserted blocks
-		for (auto &&removed : toDelete)
+		// update the stash adapter, remove newly inserted blocks (data views are no longer used)
+		for (auto &&removed : evictedIDs)
 		{
 			stash->remove(removed);
 		}
+		stopPhase(PHASE_EVICT, start);
+	}
+
+	void ORAM::writePathIndexed(const number leaf)
+	{
+		evicted.resize(height); // storage SET requests (batching), the buckets come back from the cache emptied
+
+		// following the path from leaf to root (greedy)
+		for (int level = height - 1; level >= 0; level--)
+		{
+			auto &[bucketId, bucket] = evicted[height - 1 - level];
+			bucketId				 = bucketForLevelLeaf(level, leaf);
+
+			// the blocks that fit in this bucket are the ones mapped to the leaves under it
+			const auto [from, to] = leavesForLocation(bucketId);
+			stash->forEachInRange(from, to, Z, [this, &bucket](const number id, const uchar *data, const number size) {
+				bucket.push_back({id, arena.allocate()});
+				bucket.back().second.assign(data, size);
+			});
+
+			// the data is copied, so the blocks can leave the stash right away (and are not found again on the upper levels)
+			for (auto &&block : bucket)
+			{
+				stash->remove(block.first);
+			}
+
+			// if nothing to insert, insert dummy (for security)
+			while (bucket.size() < Z)
+			{
+				bucket.push_back({ULONG_MAX, arena.allocate()});
+				getRandomBlock(bucket.back().second.data(), dataSize);
+			}
+		}
+
+		setCache(evicted);
 	}
 
 	number ORAM::bucketForLevelLeaf(const number level, const number leaf) const
@@ -292,59 +590,210 @@ namespace PathORAM
 		return {location * (1 << toLeaves) - (1 << (height - 1)), (location + 1) * (1 << toLeaves) - 1 - (1 << (height - 1))};
 	}
 
-	void ORAM::getCache(const unordered_set<number> &locations, vector<block> &response, const bool dryRun)
+	void ORAM::getCache(const vector<number> &locations, vector<const arenaBlock *> &response, const bool dryRun)
 	{
 		// get those locations not present in the cache
-		vector<number> toGet;
+		missing.clear();
+		number slot;
 		for (auto &&location : locations)
 		{
-			const auto bucketIt = cache.find(location);
-			if (bucketIt == cache.end())
+			if (!cacheIndex->get(location, slot))
 			{
-				toGet.push_back(location);
-			}
-			else if (!dryRun)
-			{
-				response.insert(response.begin(), (*bucketIt).second.begin(), (*bucketIt).second.end());
+				missing.push_back(location);
 			}
 		}
 
-		if (toGet.size() > 0)
+		if (stats != nullptr)
 		{
-			// download those blocks
-			vector<block> downloaded;
-			storage->get(toGet, downloaded);
+			stats->cacheHits += locations.size() - missing.size();
+		}
 
-			// add them to the cache and the result
-			bucket bucket;
-			for (auto i = 0uLL; i < downloaded.size(); i++)
+		if (missing.size() > 0)
+		{
+			// download those blocks and add them to the cache
+			downloaded.clear();
+			StorageTimes times;
+			if (timing)
 			{
-				if (!dryRun)
+				storage->recordTimes(&times);
+			}
+			storage->get(missing, downloaded, arena);
+			if (timing)
+			{
+				storage->recordTimes(nullptr);
+				onPhase(PHASE_PATH_READ, times.read);
+				onPhase(PHASE_DECRYPT, times.decrypt);
+			}
+
+			for (auto i = 0uLL; i < missing.size(); i++)
+			{
+				auto &bucket = cache[cacheSlot(missing[i])].second;
+				bucket.clear();
+				for (auto j = 0uLL; j < Z; j++)
 				{
-					response.push_back(downloaded[i]);
+					bucket.push_back(move(downloaded[i * Z + j]));
 				}
-				bucket.push_back(downloaded[i]);
-				if (i % Z == Z - 1)
+			}
+		}
+
+		if (!dryRun)
+		{
+			for (auto &&location : locations)
+			{
+				cacheIndex->get(location, slot);
+				for (auto &&block : cache[slot].second)
 				{
-					cache[toGet[i / Z]] = bucket;
-					bucket.clear();
+					response.push_back(&block);
 				}
 			}
 		}
 	}
 
-	void ORAM::setCache(const vector<pair<number, bucket>> &requests)
+	void ORAM::setCache(vector<pair<number, arenaBucket>> &requests)
+	{
+		for (auto &&[location, bucket] : requests)
+		{
+			swap(cache[cacheSlot(location)].second, bucket);
+
+			// the payloads of the replaced bucket go back to the arena
+			bucket.clear();
+		}
+	}
+
+	number ORAM::cacheSlot(const number location)
 	{
-		for (auto &&request : requests)
+		number slot;
+		if (cacheIndex->get(location, slot))
+		{
+			return slot;
+		}
+
+		// more buckets than expected for a call (e.g. dummy accesses of background eviction)
+		if (cacheSize == cacheCapacity)
 		{
-			cache[request.first] = request.second;
+			cacheCapacity *= 2;
+			cacheIndex = make_unique<FixedHashMap>(cacheCapacity);
+			for (number i = 0; i < cacheSize; i++)
+			{
+				cacheIndex->set(cache[i].first, i);
+			}
 		}
+
+		slot = cacheSize++;
+		if (cache.size() < cacheSize)
+		{
+			cache.emplace_back();
+		}
+		cache[slot].first = location;
+		cacheIndex->set(location, slot);
+		return slot;
 	}
 
 	void ORAM::syncCache()
 	{
-		storage->set(boost::make_iterator_range(cache.begin(), cache.end()));
+		StorageTimes times;
+		if (timing)
+		{
+			storage->recordTimes(&times);
+		}
+		storage->set(boost::make_iterator_range(cache.cbegin(), cache.cbegin() + cacheSize));
+		if (timing)
+		{
+			storage->recordTimes(nullptr);
+			onPhase(PHASE_ENCRYPT, times.encrypt);
+			onPhase(PHASE_WRITE_BACK, times.write);
+		}
+
+		clearCache();
+	}
+
+	void ORAM::clearCache()
+	{
+		// the payloads go back to the arena, the slots keep their buckets
+		for (number i = 0; i < cacheSize; i++)
+		{
+			cache[i].second.clear();
+		}
+		cacheIndex->clear();
+		cacheSize = 0;
+	}
+
+	boost::signals2::connection ORAM::subscribe(const OnPhase::slot_type &handler)
+	{
+		return onPhase.connect(handler);
+	}
+
+	void ORAM::setTracer(const shared_ptr<Tracer> tracer)
+	{
+		this->tracer = tracer;
+		storage->setTracer(tracer);
+		map->setTracer(tracer);
+	}
+
+	void ORAM::startCall(AccessStats *stats)
+	{
+		timing = !onPhase.empty();
+
+		// the position map is always told, so that it never keeps the stats of a previous call
+		this->stats = stats;
+		map->recordStats(stats);
+		if (stats != nullptr)
+		{
+			statsStart = storage->metrics(false);
+		}
+	}
+
+	void ORAM::finishCall()
+	{
+		if (stats == nullptr)
+		{
+			return;
+		}
+
+		const auto end = storage->metrics(false);
+		stats->bucketsRead += end.readBuckets - statsStart.readBuckets;
+		stats->bucketsWritten += end.writtenBuckets - statsStart.writtenBuckets;
+		stats->bytesRead += end.readBytes - statsStart.readBytes;
+		stats->bytesWritten += end.writtenBytes - statsStart.writtenBytes;
+		stats->storageCalls += (end.reads - statsStart.reads) + (end.writes - statsStart.writes);
+		stats->stashSize = occupancy.current;
+
+		map->recordStats(nullptr);
+		stats = nullptr;
+	}
+
+	ORAM::Call::Call(ORAM *oram, AccessStats *stats, const char *name) :
+		oram(oram),
+		batch(oram->tracer.get(), name, "oram")
+	{
+		oram->startCall(stats);
+	}
 
-		cache.clear();
+	ORAM::Call::~Call()
+	{
+		oram->finishCall();
+	}
+
+	chrono::steady_clock::time_point ORAM::startPhase() const
+	{
+		return timing || tracer != nullptr ? chrono::steady_clock::now() : chrono::steady_clock::time_point();
+	}
+
+	void ORAM::stopPhase(const ORAMPhase phase, const chrono::steady_clock::time_point start)
+	{
+		if (!timing && tracer == nullptr)
+		{
+			return;
+		}
+
+		const auto end = chrono::steady_clock::now();
+		if (timing)
+		{
+			onPhase(phase, chrono::duration_cast<chrono::nanoseconds>(end - start).count());
+		}
+		if (tracer != nullptr)
+		{
+			tracer->record(PHASE_NAMES[phase], "oram", start, end);
+		}
 	}
 }
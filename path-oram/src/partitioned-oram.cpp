@@ -0,0 +1,331 @@
+#include "partitioned-oram.hpp"
+
+#include "utility.hpp"
+
+#include <algorithm>
+#include <boost/format.hpp>
+#include <unordered_set>
+
+namespace PathORAM
+{
+	using namespace std;
+	using boost::format;
+
+	/**
+	 * @brief the number of slots of each partition: twice the even share
+	 */
+	number partitionCapacityFor(const number capacity, const number partitions)
+	{
+		return 2 * ((capacity + partitions - 1) / partitions);
+	}
+
+	/**
+	 * @brief in-memory partitions, each tree is at most 3/4 full
+	 */
+	vector<shared_ptr<ORAM>> makePartitions(const number capacity, const number blockSize, const number Z, const number partitions, const number batchSize)
+	{
+		const auto slots   = partitionCapacityFor(capacity, partitions);
+		number logCapacity = 3;
+		while (((1uLL << logCapacity) * Z * 3) < slots * 4)
+		{
+			logCapacity++;
+		}
+
+		vector<shared_ptr<ORAM>> result;
+		for (number i = 0; i < partitions; i++)
+		{
+			result.push_back(make_shared<ORAM>(
+				logCapacity,
+				blockSize,
+				Z,
+				make_shared<InMemoryStorageAdapter>((1uLL << logCapacity), blockSize, bytes(), Z),
+				make_shared<InMemoryPositionMapAdapter>(((1uLL << logCapacity) * Z) + Z),
+				make_shared<InMemoryStashAdapter>(3 * logCapacity * Z),
+				true,
+				batchSize));
+		}
+		return result;
+	}
+
+	PartitionedORAM::PartitionedORAM(const vector<shared_ptr<ORAM>> &partitions, const number partitionCapacity, const number batchSize, const number evictionRate) :
+		partitions(partitions),
+		partitionCapacity(partitionCapacity),
+		batchSize(batchSize),
+		evictionRate(evictionRate)
+	{
+#if INPUT_CHECKS
+		if (partitions.size() == 0)
+		{
+			throw Exception("no partitions");
+		}
+		if (partitionCapacity == 0 || batchSize == 0 || evictionRate == 0)
+		{
+			throw Exception("partition capacity, batch size and eviction rate must be positive");
+		}
+#endif
+
+		evictionCaches.resize(partitions.size());
+		freeSlots.resize(partitions.size());
+		for (auto &&slots : freeSlots)
+		{
+			// the lowest slots are used first
+			slots.reserve(partitionCapacity);
+			for (number slot = 0; slot < partitionCapacity; slot++)
+			{
+				slots.push_back(partitionCapacity - 1 - slot);
+			}
+		}
+
+		for (number i = 0; i < partitions.size(); i++)
+		{
+			workers.push_back(make_unique<Worker>());
+			workers.back()->runner = thread(&PartitionedORAM::work, workers.back().get());
+		}
+	}
+
+	PartitionedORAM::PartitionedORAM(const number capacity, const number blockSize, const number Z, const number partitions, const number batchSize, const number evictionRate) :
+		PartitionedORAM(makePartitions(capacity, blockSize, Z, partitions, batchSize), partitionCapacityFor(capacity, partitions), batchSize, evictionRate)
+	{
+	}
+
+	PartitionedORAM::~PartitionedORAM()
+	{
+		for (auto &&worker : workers)
+		{
+			{
+				lock_guard<mutex> guard(worker->lock);
+				worker->stopping = true;
+			}
+			worker->pending.notify_one();
+		}
+
+		for (auto &&worker : workers)
+		{
+			worker->runner.join();
+		}
+	}
+
+	void PartitionedORAM::get(const number block, bytes &response)
+	{
+		vector<bytes> responses;
+		multiple({{block, bytes()}}, responses);
+		response = move(responses[0]);
+	}
+
+	void PartitionedORAM::put(const number block, const bytes &data)
+	{
+		vector<bytes> responses;
+		multiple({{block, data}}, responses);
+	}
+
+	void PartitionedORAM::multiple(const vector<block> &requests, vector<bytes> &response)
+	{
+		// distinct IDs, in order of appearance, and their current values
+		vector<number> distinct;
+		unordered_map<number, bytes> values;
+		for (auto &&request : requests)
+		{
+			if (values.insert({request.first, bytes()}).second)
+			{
+				distinct.push_back(request.first);
+			}
+		}
+
+		// check before any state changes (not only an input check, allocate cannot succeed on full partitions)
+		unordered_set<number> added;
+		for (auto &&request : requests)
+		{
+			if (request.second.size() > 0 && locations.count(request.first) == 0)
+			{
+				added.insert(request.first);
+			}
+		}
+		if (locations.size() + added.size() > partitions.size() * partitionCapacity)
+		{
+			throw Exception(boost::format("all %1% partitions are full (%2% slots each)") % partitions.size() % partitionCapacity);
+		}
+
+		// read each block from its partition (or its eviction cache) and release its slot (the block will move)
+		vector<vector<block>> reads(partitions.size());
+		vector<vector<number>> readIds(partitions.size()); // ULONG_MAX for a dummy read
+		for (auto &&id : distinct)
+		{
+			const auto found = locations.find(id);
+			if (found != locations.end())
+			{
+				const auto [partition, slot] = found->second;
+				const auto cached			 = evictionCaches[partition].find(id);
+				if (cached != evictionCaches[partition].end())
+				{
+					// not written to the partition yet, read a random slot of it
+					values[id] = move(cached->second);
+					evictionCaches[partition].erase(cached);
+					reads[partition].push_back({getRandomULong(partitionCapacity), bytes()});
+					readIds[partition].push_back(ULONG_MAX);
+				}
+				else
+				{
+					reads[partition].push_back({slot, bytes()});
+					readIds[partition].push_back(id);
+				}
+				freeSlots[partition].push_back(slot);
+				locations.erase(found);
+			}
+			else
+			{
+				// never written, read a random slot of a random partition
+				const auto partition = getRandomULong(partitions.size());
+				reads[partition].push_back({getRandomULong(partitionCapacity), bytes()});
+				readIds[partition].push_back(ULONG_MAX);
+			}
+		}
+
+		vector<vector<bytes>> answers;
+		run(reads, answers);
+
+		for (number partition = 0; partition < partitions.size(); partition++)
+		{
+			for (number i = 0; i < readIds[partition].size(); i++)
+			{
+				if (readIds[partition][i] != ULONG_MAX)
+				{
+					values[readIds[partition][i]] = move(answers[partition][i]);
+				}
+			}
+		}
+
+		// apply the requests in order
+		response.resize(requests.size());
+		for (number i = 0; i < requests.size(); i++)
+		{
+			auto &value = values[requests[i].first];
+			if (requests[i].second.size() > 0)
+			{
+				value = requests[i].second;
+			}
+			response[i] = value;
+		}
+
+		// assign each block to a fresh random partition, it waits in that partition's eviction cache
+		for (auto &&id : distinct)
+		{
+			auto &value = values[id];
+			if (value.size() > 0)
+			{
+				const auto [partition, slot] = allocate();
+				locations[id]				 = {partition, slot};
+				evictionCaches[partition][id] = move(value);
+			}
+		}
+
+		// the writes do not depend on the blocks just read
+		vector<vector<block>> writes(partitions.size());
+		evict(evictionRate * distinct.size(), writes);
+
+		run(writes, answers);
+	}
+
+	void PartitionedORAM::evict(const number count, vector<vector<block>> &writes)
+	{
+		for (number i = 0; i < count; i++)
+		{
+			const auto partition = getRandomULong(partitions.size());
+			auto &cache			 = evictionCaches[partition];
+			if (cache.size() > 0)
+			{
+				const auto evicted = cache.begin();
+				writes[partition].push_back({locations[evicted->first].second, move(evicted->second)});
+				cache.erase(evicted);
+			}
+			else
+			{
+				// nothing to evict, make a dummy access instead
+				writes[partition].push_back({getRandomULong(partitionCapacity), bytes()});
+			}
+		}
+	}
+
+	pair<number, number> PartitionedORAM::allocate()
+	{
+		// not only an input check, with no free slots rejection sampling would never terminate
+		if (none_of(freeSlots.begin(), freeSlots.end(), [](const vector<number> &slots) { return slots.size() > 0; }))
+		{
+			throw Exception(boost::format("all %1% partitions are full (%2% slots each)") % partitions.size() % partitionCapacity);
+		}
+
+		while (true)
+		{
+			const auto partition = getRandomULong(partitions.size());
+			if (freeSlots[partition].size() > 0)
+			{
+				const auto slot = freeSlots[partition].back();
+				freeSlots[partition].pop_back();
+				return {partition, slot};
+			}
+		}
+	}
+
+	void PartitionedORAM::run(const vector<vector<block>> &requests, vector<vector<bytes>> &response)
+	{
+		response.clear();
+		response.resize(partitions.size());
+
+		vector<future<void>> done;
+		for (number partition = 0; partition < partitions.size(); partition++)
+		{
+			if (requests[partition].size() == 0)
+			{
+				continue;
+			}
+
+			packaged_task<void()> task([this, partition, &requests, &response]() {
+				const auto &partitionRequests = requests[partition];
+				for (number from = 0; from < partitionRequests.size(); from += batchSize)
+				{
+					const auto to = min(from + batchSize, (number)partitionRequests.size());
+					vector<bytes> answer;
+					partitions[partition]->multiple(vector<block>(partitionRequests.begin() + from, partitionRequests.begin() + to), answer);
+					move(answer.begin(), answer.end(), back_inserter(response[partition]));
+				}
+			});
+			done.push_back(task.get_future());
+
+			auto &worker = workers[partition];
+			{
+				lock_guard<mutex> guard(worker->lock);
+				worker->tasks.push_back(move(task));
+			}
+			worker->pending.notify_one();
+		}
+
+		// wait for all partitions before rethrowing (the tasks reference requests and response)
+		for (auto &&result : done)
+		{
+			result.wait();
+		}
+		for (auto &&result : done)
+		{
+			result.get();
+		}
+	}
+
+	void PartitionedORAM::work(Worker *worker)
+	{
+		while (true)
+		{
+			packaged_task<void()> task;
+			{
+				unique_lock<mutex> guard(worker->lock);
+				worker->pending.wait(guard, [worker] { return worker->stopping || !worker->tasks.empty(); });
+				if (worker->tasks.empty())
+				{
+					return;
+				}
+				task = move(worker->tasks.front());
+				worker->tasks.pop_front();
+			}
+
+			task();
+		}
+	}
+}
@@ -1,5 +1,7 @@
 #include "position-map-adapter.hpp"
 
+#include "utility.hpp"
+
 #include <boost/format.hpp>
 #include <cstring>
 #include <fstream>
@@ -11,6 +13,35 @@ namespace PathORAM
 
 	AbsPositionMapAdapter::~AbsPositionMapAdapter(){};
 
+	void AbsPositionMapAdapter::initialize(const number blocks, const number leaves)
+	{
+		for (number i = 0; i < blocks; ++i)
+		{
+			set(i, getRandomULong(leaves));
+		}
+	}
+
+	void AbsPositionMapAdapter::load(const vector<pair<number, number>> &positions)
+	{
+		for (auto &&[block, leaf] : positions)
+		{
+			set(block, leaf);
+		}
+	}
+
+	void AbsPositionMapAdapter::recordStats(AccessStats *stats)
+	{
+	}
+
+	void AbsPositionMapAdapter::setTracer(const shared_ptr<Tracer> tracer)
+	{
+	}
+
+	number AbsPositionMapAdapter::memoryUsage(const bool recursive) const
+	{
+		return 0;
+	}
+
 	InMemoryPositionMapAdapter::~InMemoryPositionMapAdapter()
 	{
 		delete[] map;
@@ -36,6 +67,11 @@ namespace PathORAM
 		map[block] = leaf;
 	}
 
+	number InMemoryPositionMapAdapter::memoryUsage(const bool recursive) const
+	{
+		return capacity * sizeof(number);
+	}
+
 	void InMemoryPositionMapAdapter::storeToFile(const string filename) const
 	{
 		fstream file;
@@ -76,32 +112,256 @@ namespace PathORAM
 #endif
 	}
 
+	SparsePositionMapAdapter::~SparsePositionMapAdapter()
+	{
+	}
+
+	SparsePositionMapAdapter::SparsePositionMapAdapter(const number capacity, const number leaves) :
+		map(capacity),
+		leaves(leaves)
+	{
+	}
+
+	number SparsePositionMapAdapter::get(const number block) const
+	{
+		number leaf;
+		if (!map.get(block, leaf))
+		{
+			// not only an input check, a fixed fallback leaf would make the paths of new blocks observable
+			if (leaves == 0)
+			{
+				throw Exception(boost::format("block %1% is not mapped and the number of leaves is unknown (initialize was not called)") % block);
+			}
+
+			// remember, so that subsequent gets agree (e.g. in ORAM::multiple)
+			leaf = getRandomULong(leaves);
+			map.set(block, leaf);
+		}
+
+		return leaf;
+	}
+
+	void SparsePositionMapAdapter::set(const number block, const number leaf)
+	{
+		map.set(block, leaf);
+	}
+
+	void SparsePositionMapAdapter::initialize(const number blocks, const number leaves)
+	{
+		this->leaves = leaves;
+	}
+
+	number SparsePositionMapAdapter::size() const
+	{
+		return map.size();
+	}
+
+	number SparsePositionMapAdapter::memoryUsage(const bool recursive) const
+	{
+		return map.memoryUsage();
+	}
+
 	ORAMPositionMapAdapter::~ORAMPositionMapAdapter()
 	{
+		flush();
 	}
 
-	ORAMPositionMapAdapter::ORAMPositionMapAdapter(const shared_ptr<ORAM> oram) :
-		oram(oram)
+	ORAMPositionMapAdapter::ORAMPositionMapAdapter(const shared_ptr<ORAM> oram, const number plbCapacity) :
+		oram(oram),
+		positionsPerBlock(oram->dataSize / sizeof(number)),
+		plbCapacity(plbCapacity)
 	{
+		plbIndex.reserve(max(plbCapacity, 1uLL));
 	}
 
 	number ORAMPositionMapAdapter::get(const number block) const
 	{
-		bytes returned;
-		oram->get(block, returned);
-		uchar buffer[returned.size()];
-		copy(returned.begin(), returned.end(), buffer);
+		checkCapacity(block);
+
+		const auto &positions = fetch(block / positionsPerBlock, false).first;
 
-		return ((number *)buffer)[0];
+		return ((number *)positions.data())[block % positionsPerBlock];
 	}
 
 	void ORAMPositionMapAdapter::set(const number block, const number leaf)
 	{
-		number buffer[1];
-		buffer[0] = leaf;
+		checkCapacity(block);
+
+		const auto id			 = block / positionsPerBlock;
+		auto &[positions, dirty] = fetch(id, true);
 
-		auto data = bytes((uchar *)buffer, (uchar *)buffer + sizeof(number));
+		((number *)positions.data())[block % positionsPerBlock] = leaf;
 
-		oram->put(block, data);
+		if (plbCapacity == 0)
+		{
+			// write-through
+			countAccess();
+			oram->put(id, positions, stats);
+		}
+		else
+		{
+			// write-back (on eviction or flush)
+			dirty = true;
+		}
+	}
+
+	void ORAMPositionMapAdapter::initialize(const number blocks, const number leaves)
+	{
+		this->blocks = blocks;
+		this->leaves = leaves;
+
+		load({});
+	}
+
+	void ORAMPositionMapAdapter::load(const vector<pair<number, number>> &positions)
+	{
+		// not only an input check, a fixed fallback leaf would make the paths of the blocks not in positions observable
+		if (leaves == 0)
+		{
+			throw Exception("the number of leaves is unknown (initialize was not called)");
+		}
+
+		auto count = blocks;
+		for (auto &&position : positions)
+		{
+			checkCapacity(position.first);
+			count = max(count, position.first + 1);
+		}
+
+		// pack positions into the blocks of the underlying ORAM
+		vector<block> data;
+		data.resize((count + positionsPerBlock - 1) / positionsPerBlock);
+		for (number i = 0; i < data.size(); i++)
+		{
+			data[i].first = i;
+			data[i].second.resize(positionsPerBlock * sizeof(number));
+			for (number j = 0; j < positionsPerBlock; j++)
+			{
+				((number *)data[i].second.data())[j] = getRandomULong(leaves);
+			}
+		}
+		for (auto &&[block, leaf] : positions)
+		{
+			((number *)data[block / positionsPerBlock].second.data())[block % positionsPerBlock] = leaf;
+		}
+
+		// the content is replaced, PLB is stale
+		plb.clear();
+		plbIndex.clear();
+
+		// erase the underlying ORAM, so that no stale copies of blocks remain in its tree or stash
+		oram->storage->fillWithZeroes();
+		vector<number> stashed;
+		oram->stash->forEach([&stashed](const number block, const uchar *data, const number size) { stashed.push_back(block); }, false);
+		for (auto &&block : stashed)
+		{
+			oram->stash->remove(block);
+		}
+
+		oram->load(data);
+	}
+
+	void ORAMPositionMapAdapter::flush()
+	{
+		for (auto &&[id, entry] : plb)
+		{
+			if (entry.second)
+			{
+				countAccess();
+				oram->put(id, entry.first, stats);
+				entry.second = false;
+			}
+		}
+	}
+
+	pair<bytes, bool> &ORAMPositionMapAdapter::fetch(const number id, const bool reuse) const
+	{
+		const auto found = plbIndex.find(id);
+		if (found != plbIndex.end() && (plbCapacity > 0 || reuse))
+		{
+			// PLB hit, mark as most recently used
+			plb.splice(plb.begin(), plb, found->second);
+
+			return plb.front().second;
+		}
+
+		bytes positions;
+		countAccess();
+		oram->get(id, positions, stats);
+		// the block may have never been written
+		positions.resize(positionsPerBlock * sizeof(number), 0x00);
+
+		if (found != plbIndex.end())
+		{
+			// PLB is disabled (write-through), so the remembered block is never dirty
+			found->second->second = {positions, false};
+			plb.splice(plb.begin(), plb, found->second);
+			return plb.front().second;
+		}
+
+		plb.push_front({id, {positions, false}});
+		plbIndex[id] = plb.begin();
+
+		// evict least recently used; with PLB disabled, remember only the last block
+		while (plb.size() > max(plbCapacity, 1uLL))
+		{
+			auto &[victim, entry] = plb.back();
+			if (entry.second)
+			{
+				// regular ORAM access, the block gets a fresh random path
+				countAccess();
+				oram->put(victim, entry.first, stats);
+			}
+			plbIndex.erase(victim);
+			plb.pop_back();
+		}
+
+		return plb.front().second;
+	}
+
+	void ORAMPositionMapAdapter::recordStats(AccessStats *stats)
+	{
+		this->stats = stats;
+	}
+
+	void ORAMPositionMapAdapter::setTracer(const shared_ptr<Tracer> tracer)
+	{
+		oram->setTracer(tracer);
+	}
+
+	number ORAMPositionMapAdapter::memoryUsage(const bool recursive) const
+	{
+		// a list node holds the entry and two pointers
+		number memory = plb.size() * (sizeof(pair<number, pair<bytes, bool>>) + 2 * sizeof(void *));
+		for (auto &&entry : plb)
+		{
+			memory += entry.second.first.capacity();
+		}
+		memory += hashMapMemory(plbIndex);
+
+		if (recursive)
+		{
+			memory += oram->memoryUsage().total();
+		}
+
+		return memory;
+	}
+
+	void ORAMPositionMapAdapter::countAccess() const
+	{
+		if (stats != nullptr)
+		{
+			stats->recursiveAccesses++;
+		}
+	}
+
+	void ORAMPositionMapAdapter::checkCapacity(const number block) const
+	{
+#if INPUT_CHECKS
+		if (block / positionsPerBlock >= oram->blocks)
+		{
+			throw Exception(boost::format("block %1% out of bound (capacity %2%)") % block % (oram->blocks * positionsPerBlock));
+		}
+#endif
 	}
 }
@@ -13,8 +13,36 @@ namespace PathORAM
 	using namespace std;
 	using boost::format;
 
+	/**
+	 * @brief Fisher-Yates shuffle
+	 */
+	template <typename T>
+	void permute(vector<T> &elements)
+	{
+		const uint n = elements.size();
+		if (n >= 2)
+		{
+			for (uint i = 0; i < n - 1; i++)
+			{
+				uint j = i + getRandomUInt(n - i);
+				swap(elements[i], elements[j]);
+			}
+		}
+	}
+
 	AbsStashAdapter::~AbsStashAdapter() {}
 
+	void AbsStashAdapter::forEach(const StashVisitor &visitor, const bool shuffle) const
+	{
+		vector<block> entries;
+		getAll(entries);
+
+		for (auto &&entry : entries)
+		{
+			visitor(entry.first, entry.second.data(), entry.second.size());
+		}
+	}
+
 	InMemoryStashAdapter::~InMemoryStashAdapter() {}
 
 	InMemoryStashAdapter::InMemoryStashAdapter(const number capacity) :
@@ -28,15 +56,76 @@ namespace PathORAM
 	{
 		response.insert(response.begin(), stash.begin(), stash.end());
 
-		const uint n = response.size();
-		if (n >= 2)
+		permute(response);
+	}
+
+	void AbsStashAdapter::add(const number block, const uchar *data, const number size)
+	{
+		add(block, bytes(data, data + size));
+	}
+
+	void AbsStashAdapter::update(const number block, bytes &&data)
+	{
+		update(block, static_cast<const bytes &>(data));
+	}
+
+	number AbsStashAdapter::get(const number block, uchar *response) const
+	{
+		bytes data;
+		get(block, data);
+		copy(data.begin(), data.end(), response);
+		return data.size();
+	}
+
+	number AbsStashAdapter::currentSize()
+	{
+		number size = 0;
+		forEach([&size](const number block, const uchar *data, const number dataSize) { size++; }, false);
+		return size;
+	}
+
+	number AbsStashAdapter::memoryUsage() const
+	{
+		return 0;
+	}
+
+	bool AbsStashAdapter::indexesLeaves() const
+	{
+		return false;
+	}
+
+	void AbsStashAdapter::setLeaf(const number block, const number leaf)
+	{
+	}
+
+	void AbsStashAdapter::forEachInRange(const number fromLeaf, const number toLeaf, const number limit, const StashVisitor &visitor) const
+	{
+		throw Exception("this stash adapter does not index leaves");
+	}
+
+	void InMemoryStashAdapter::forEach(const StashVisitor &visitor, const bool shuffle) const
+	{
+		if (!shuffle)
 		{
-			// Fisher-Yates shuffle
-			for (uint i = 0; i < n - 1; i++)
+			for (auto &&entry : stash)
 			{
-				uint j = i + getRandomUInt(n - i);
-				swap(response[i], response[j]);
+				visitor(entry.first, entry.second.data(), entry.second.size());
 			}
+			return;
+		}
+
+		// shuffle the pointers, not the data
+		vector<const pair<const number, bytes> *> entries;
+		entries.reserve(stash.size());
+		for (auto &&entry : stash)
+		{
+			entries.push_back(&entry);
+		}
+		permute(entries);
+
+		for (auto &&entry : entries)
+		{
+			visitor(entry->first, entry->second.data(), entry->second.size());
 		}
 	}
 
@@ -63,6 +152,25 @@ namespace PathORAM
 		}
 	}
 
+	void InMemoryStashAdapter::update(const number block, bytes &&data)
+	{
+		checkOverflow(block);
+
+		stash[block] = move(data);
+	}
+
+	number InMemoryStashAdapter::get(const number block, uchar *response) const
+	{
+		const auto found = stash.find(block);
+		if (found == stash.end())
+		{
+			return 0;
+		}
+
+		copy(found->second.begin(), found->second.end(), response);
+		return found->second.size();
+	}
+
 	void InMemoryStashAdapter::remove(const number block)
 	{
 		stash.erase(block);
@@ -88,6 +196,38 @@ namespace PathORAM
 		return stash.size();
 	}
 
+	number InMemoryStashAdapter::memoryUsage() const
+	{
+		number memory = hashMapMemory(stash);
+		for (auto &&[id, data] : stash)
+		{
+			memory += data.capacity();
+		}
+		return memory;
+	}
+
+	// stash snapshot format, all numbers are native-endian
+	// header: magic (8 bytes), version, block size, number of records, checksum of the records (FNV-1a)
+	// records: {ID, data (block size bytes)}
+	const char SNAPSHOT_MAGIC[8]		 = {'O', 'R', 'A', 'M', 'S', 'T', 'S', 'H'};
+	const number SNAPSHOT_VERSION		 = 1;
+	const number SNAPSHOT_HEADER_SIZE	 = sizeof(SNAPSHOT_MAGIC) + 4 * sizeof(number);
+	const number SNAPSHOT_BUFFER_SIZE	 = 1 << 20;
+	const number SNAPSHOT_CHECKSUM_START = 0xcbf29ce484222325uLL;
+
+	/**
+	 * @brief FNV-1a (64-bit) over the data, continuing from the given state
+	 */
+	number snapshotChecksum(number state, const uchar *data, const number size)
+	{
+		for (number i = 0; i < size; i++)
+		{
+			state ^= data[i];
+			state *= 0x100000001b3uLL;
+		}
+		return state;
+	}
+
 	void InMemoryStashAdapter::storeToFile(const string filename) const
 	{
 		const auto flags = fstream::out | fstream::binary | fstream::trunc;
@@ -99,24 +239,51 @@ namespace PathORAM
 			throw Exception(boost::format("cannot open %1%: %2%") % filename % strerror(errno));
 		}
 
-		if (stash.size() > 0)
+		const number blockSize = stash.size() > 0 ? stash.begin()->second.size() : 0;
+		const number count	   = stash.size();
+		auto checksum		   = SNAPSHOT_CHECKSUM_START;
+
+		auto writeHeader = [&]() {
+			const number fields[] = {SNAPSHOT_VERSION, blockSize, count, checksum};
+			file.write(SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC));
+			file.write((const char *)fields, sizeof(fields));
+		};
+
+		// the checksum is not known yet, the header is rewritten at the end
+		writeHeader();
+
+		// records are streamed through a fixed-size buffer
+		bytes buffer;
+		buffer.reserve(SNAPSHOT_BUFFER_SIZE);
+		auto flush = [&]() {
+			checksum = snapshotChecksum(checksum, buffer.data(), buffer.size());
+			file.write((const char *)buffer.data(), buffer.size());
+			buffer.clear();
+		};
+
+		for (auto &&[id, data] : stash)
 		{
-			auto blockSize	= stash.begin()->second.size();
-			auto recordSize = sizeof(number) + blockSize;
-			unsigned char buffer[stash.size() * recordSize];
+			if (data.size() != blockSize)
+			{
+				throw Exception(boost::format("cannot store blocks of different sizes (%1% and %2%)") % blockSize % data.size());
+			}
 
-			auto i = 0;
-			for (auto &&record : stash)
+			if (buffer.size() + sizeof(number) + blockSize > SNAPSHOT_BUFFER_SIZE)
 			{
-				number numberBuffer[1] = {record.first};
-				copy((unsigned char *)numberBuffer, (unsigned char *)numberBuffer + sizeof(number), buffer + recordSize * i);
-				copy(record.second.begin(), record.second.begin() + record.second.size(), buffer + recordSize * i + sizeof(number));
-				i++;
+				flush();
 			}
+			buffer.insert(buffer.end(), (const uchar *)&id, (const uchar *)&id + sizeof(number));
+			buffer.insert(buffer.end(), data.begin(), data.end());
+		}
+		flush();
 
-			file.seekg(0, file.beg);
-			file.write((const char *)buffer, stash.size() * recordSize);
-			file.close();
+		file.seekp(0, file.beg);
+		writeHeader();
+		file.close();
+
+		if (!file)
+		{
+			throw Exception(boost::format("cannot write %1%: %2%") % filename % strerror(errno));
 		}
 	}
 
@@ -125,33 +292,419 @@ namespace PathORAM
 		const auto flags = fstream::in | fstream::binary | fstream::ate;
 		fstream file;
 
+		vector<char> streamBuffer(SNAPSHOT_BUFFER_SIZE);
+		file.rdbuf()->pubsetbuf(streamBuffer.data(), streamBuffer.size());
+
 		file.open(filename, flags);
 		if (!file)
 		{
 			throw Exception(boost::format("cannot open %1%: %2%") % filename % strerror(errno));
 		}
-		const auto size = (int)file.tellg();
+		const number size = file.tellg();
 		file.seekg(0, file.beg);
 
-		if (size > 0)
+		char magic[sizeof(SNAPSHOT_MAGIC)] = {0};
+		number fields[4]				   = {0}; // version, block size, count, checksum
+		if (size >= SNAPSHOT_HEADER_SIZE)
+		{
+			file.read(magic, sizeof(magic));
+			file.read((char *)fields, sizeof(fields));
+		}
+
+		const auto versioned = equal(magic, magic + sizeof(magic), SNAPSHOT_MAGIC);
+		number count;
+		if (versioned)
+		{
+			const auto [version, storedBlockSize, storedCount, storedChecksum] = fields;
+			if (version != SNAPSHOT_VERSION)
+			{
+				throw Exception(boost::format("%1%: unsupported stash snapshot version %2%") % filename % version);
+			}
+			// before any size is computed from it (a corrupt count could overflow the expected size)
+			if (stash.size() + storedCount > capacity)
+			{
+				throw Exception(boost::format("%1%: %2% blocks do not fit in the stash (capacity %3%)") % filename % storedCount % capacity);
+			}
+			if (storedCount > 0 && storedBlockSize != (number)blockSize)
+			{
+				throw Exception(boost::format("%1%: block size %2% does not match the stored one %3%") % filename % blockSize % storedBlockSize);
+			}
+			if (size != SNAPSHOT_HEADER_SIZE + storedCount * (sizeof(number) + storedBlockSize))
+			{
+				throw Exception(boost::format("%1%: stash snapshot is truncated") % filename);
+			}
+			count = storedCount;
+		}
+		else
+		{
+			// legacy format (no header): records only
+			file.seekg(0, file.beg);
+			const number recordSize = sizeof(number) + blockSize;
+			if (size % recordSize != 0)
+			{
+				throw Exception(boost::format("%1%: size %2% is not a multiple of the record size %3%") % filename % size % recordSize);
+			}
+			count = size / recordSize;
+			if (stash.size() + count > capacity)
+			{
+				throw Exception(boost::format("%1%: %2% blocks do not fit in the stash (capacity %3%)") % filename % count % capacity);
+			}
+		}
+
+		// records are streamed through a fixed-size buffer into a staging map,
+		// which reaches the stash only after the checksum is verified
+		const number recordSize = sizeof(number) + blockSize;
+		const auto perChunk		= max(SNAPSHOT_BUFFER_SIZE / recordSize, (number)1);
+		bytes buffer(min(count, perChunk) * recordSize);
+		auto checksum = SNAPSHOT_CHECKSUM_START;
+
+		unordered_map<number, bytes> staged;
+		staged.reserve(count);
+		for (number read = 0; read < count; read += perChunk)
+		{
+			const auto chunk = min(count - read, perChunk) * recordSize;
+			file.read((char *)buffer.data(), chunk);
+			if (!file)
+			{
+				throw Exception(boost::format("cannot read %1%: %2%") % filename % strerror(errno));
+			}
+			checksum = snapshotChecksum(checksum, buffer.data(), chunk);
+
+			for (auto record = buffer.data(); record < buffer.data() + chunk; record += recordSize)
+			{
+				number block;
+				copy(record, record + sizeof(number), (uchar *)&block);
+				staged.emplace(block, bytes(record + sizeof(number), record + recordSize));
+			}
+		}
+		if (versioned && checksum != fields[3])
+		{
+			throw Exception(boost::format("%1%: stash snapshot checksum mismatch") % filename);
+		}
+
+		if (stash.empty())
+		{
+			stash.swap(staged);
+		}
+		else
+		{
+			// moves the nodes, blocks already in the stash are kept (as with insert)
+			stash.merge(staged);
+		}
+	}
+
+	SlabStashAdapter::~SlabStashAdapter() {}
+
+	SlabStashAdapter::SlabStashAdapter(const number capacity, const number blockSize) :
+		capacity(capacity),
+		blockSize(blockSize),
+		payloads(capacity * blockSize),
+		ids(capacity),
+		lengths(capacity),
+		positions(capacity),
+		index(capacity)
+	{
+		used.reserve(capacity);
+		freeSlots.reserve(capacity);
+		for (number slot = capacity; slot > 0; slot--)
+		{
+			freeSlots.push_back(slot - 1);
+		}
+	}
+
+	void SlabStashAdapter::getAll(vector<block> &response) const
+	{
+		response.reserve(response.size() + used.size());
+		for (auto &&slot : used)
+		{
+			const auto payload = payloads.begin() + slot * blockSize;
+			response.push_back({ids[slot], bytes(payload, payload + lengths[slot])});
+		}
+
+		permute(response);
+	}
+
+	void SlabStashAdapter::forEach(const StashVisitor &visitor, const bool shuffle) const
+	{
+		auto visit = [this, &visitor](const number slot) {
+			visitor(ids[slot], payloads.data() + slot * blockSize, lengths[slot]);
+		};
+
+		if (!shuffle)
+		{
+			for (auto &&slot : used)
+			{
+				visit(slot);
+			}
+			return;
+		}
+
+		auto slots = used;
+		permute(slots);
+		for (auto &&slot : slots)
+		{
+			visit(slot);
+		}
+	}
+
+	void SlabStashAdapter::add(const number block, const bytes &data)
+	{
+		add(block, data.data(), data.size());
+	}
+
+	void SlabStashAdapter::add(const number block, const uchar *data, const number size)
+	{
+		if (exists(block))
+		{
+			return;
+		}
+
+		checkOverflow(block);
+		checkBlockSize(size);
+
+		const auto slot = freeSlots.back();
+		freeSlots.pop_back();
+
+		ids[slot]		= block;
+		positions[slot] = used.size();
+		used.push_back(slot);
+		index.set(block, slot);
+
+		write(slot, data, size);
+	}
+
+	void SlabStashAdapter::update(const number block, const bytes &data)
+	{
+		number slot;
+		if (index.get(block, slot))
+		{
+			checkBlockSize(data.size());
+
+			write(slot, data.data(), data.size());
+		}
+		else
+		{
+			add(block, data);
+		}
+	}
+
+	void SlabStashAdapter::get(const number block, bytes &response) const
+	{
+		number slot;
+		if (index.get(block, slot))
+		{
+			const auto payload = payloads.begin() + slot * blockSize;
+			response.insert(response.begin(), payload, payload + lengths[slot]);
+		}
+	}
+
+	number SlabStashAdapter::get(const number block, uchar *response) const
+	{
+		number slot;
+		if (!index.get(block, slot))
+		{
+			return 0;
+		}
+
+		const auto payload = payloads.begin() + slot * blockSize;
+		copy(payload, payload + lengths[slot], response);
+		return lengths[slot];
+	}
+
+	void SlabStashAdapter::remove(const number block)
+	{
+		number slot;
+		if (index.get(block, slot))
+		{
+			index.remove(block);
+
+			// swap with the last occupied slot
+			const auto last		 = used.back();
+			used[positions[slot]] = last;
+			positions[last]		 = positions[slot];
+			used.pop_back();
+
+			freeSlots.push_back(slot);
+		}
+	}
+
+	void SlabStashAdapter::write(const number slot, const uchar *data, const number size)
+	{
+		copy(data, data + size, payloads.begin() + slot * blockSize);
+		lengths[slot] = size;
+	}
+
+	void SlabStashAdapter::checkOverflow(const number block) const
+	{
+		// not only with INPUT_CHECKS: there would be no free slot
+		if (used.size() == capacity && !exists(block))
+		{
+			throw Exception(boost::format("trying to insert over capacity (capacity %1%)") % capacity);
+		}
+	}
+
+	void SlabStashAdapter::checkBlockSize(const number dataSize) const
+	{
+		// not only with INPUT_CHECKS: the data would be written past its slot
+		if (dataSize > blockSize)
+		{
+			throw Exception(boost::format("data of size %1% is too long for a block of %2% bytes") % dataSize % blockSize);
+		}
+	}
+
+	bool SlabStashAdapter::exists(const number block) const
+	{
+		number slot;
+		return index.get(block, slot);
+	}
+
+	number SlabStashAdapter::currentSize()
+	{
+		return used.size();
+	}
+
+	number SlabStashAdapter::memoryUsage() const
+	{
+		return payloads.capacity() +
+			   (ids.capacity() + lengths.capacity() + used.capacity() + positions.capacity() + freeSlots.capacity()) * sizeof(number) +
+			   index.memoryUsage();
+	}
+
+	LeafStashAdapter::~LeafStashAdapter() {}
+
+	LeafStashAdapter::LeafStashAdapter(const number capacity, const number blockSize, const number logCapacity) :
+		SlabStashAdapter(capacity, blockSize),
+		leaves(1uLL << (logCapacity - 1)),
+		slotLeaves(capacity, ULONG_MAX),
+		next(capacity, ULONG_MAX),
+		previous(capacity, ULONG_MAX)
+	{
+		// about one group per object, but not more groups than leaves
+		number logGroups = 0;
+		while ((1uLL << logGroups) < capacity && logGroups < logCapacity - 1)
+		{
+			logGroups++;
+		}
+		groups = 1uLL << logGroups;
+		shift  = logCapacity - 1 - logGroups;
+
+		heads.resize(groups, ULONG_MAX);
+		counts.resize(2 * groups, 0);
+	}
+
+	void LeafStashAdapter::remove(const number block)
+	{
+		number slot;
+		if (index.get(block, slot) && slotLeaves[slot] != ULONG_MAX)
 		{
-			unsigned char buffer[size];
-			file.read((char *)buffer, size);
-			file.close();
+			unlink(slot);
+			slotLeaves[slot] = ULONG_MAX;
+		}
+
+		SlabStashAdapter::remove(block);
+	}
+
+	bool LeafStashAdapter::indexesLeaves() const
+	{
+		return true;
+	}
+
+	number LeafStashAdapter::memoryUsage() const
+	{
+		return SlabStashAdapter::memoryUsage() +
+			   (slotLeaves.capacity() + next.capacity() + previous.capacity() + heads.capacity() + counts.capacity()) * sizeof(number);
+	}
 
-			auto recordSize = sizeof(number) + blockSize;
-			for (int i = 0; i < size; i += recordSize)
+	void LeafStashAdapter::setLeaf(const number block, const number leaf)
+	{
+#if INPUT_CHECKS
+		if (leaf >= leaves)
+		{
+			throw Exception(boost::format("leaf %1% is out of bounds (leaves %2%)") % leaf % leaves);
+		}
+#endif
+
+		number slot;
+		if (index.get(block, slot))
+		{
+			if (slotLeaves[slot] != ULONG_MAX)
 			{
-				unsigned char numberBuffer[sizeof(number)];
-				copy(buffer + i, buffer + i + sizeof(number), numberBuffer);
-				number block = ((number *)numberBuffer)[0];
+				unlink(slot);
+			}
+			slotLeaves[slot] = leaf;
+			link(slot);
+		}
+	}
 
-				bytes data;
-				data.resize(blockSize);
-				copy(buffer + i + sizeof(number), buffer + i + sizeof(number) + blockSize, data.begin());
+	void LeafStashAdapter::forEachInRange(const number fromLeaf, const number toLeaf, const number limit, const StashVisitor &visitor) const
+	{
+		number visited = 0;
+		visit(1, 0, groups - 1, fromLeaf, toLeaf, limit, visited, visitor);
+	}
 
-				stash.insert({block, data});
+	void LeafStashAdapter::visit(const number node, const number nodeFrom, const number nodeTo, const number fromLeaf, const number toLeaf, const number limit, number &visited, const StashVisitor &visitor) const
+	{
+		if (visited == limit || counts[node] == 0 || nodeTo < (fromLeaf >> shift) || nodeFrom > (toLeaf >> shift))
+		{
+			return;
+		}
+
+		if (node >= groups)
+		{
+			for (auto slot = heads[nodeFrom]; slot != ULONG_MAX && visited < limit; slot = next[slot])
+			{
+				if (slotLeaves[slot] >= fromLeaf && slotLeaves[slot] <= toLeaf)
+				{
+					visitor(ids[slot], payloads.data() + slot * blockSize, lengths[slot]);
+					visited++;
+				}
 			}
+			return;
+		}
+
+		const auto middle = nodeFrom + (nodeTo - nodeFrom + 1) / 2;
+		visit(2 * node, nodeFrom, middle - 1, fromLeaf, toLeaf, limit, visited, visitor);
+		visit(2 * node + 1, middle, nodeTo, fromLeaf, toLeaf, limit, visited, visitor);
+	}
+
+	void LeafStashAdapter::link(const number slot)
+	{
+		const auto group = slotLeaves[slot] >> shift;
+
+		previous[slot] = ULONG_MAX;
+		next[slot]	   = heads[group];
+		if (heads[group] != ULONG_MAX)
+		{
+			previous[heads[group]] = slot;
+		}
+		heads[group] = slot;
+
+		for (auto node = groups + group; node > 0; node /= 2)
+		{
+			counts[node]++;
+		}
+	}
+
+	void LeafStashAdapter::unlink(const number slot)
+	{
+		const auto group = slotLeaves[slot] >> shift;
+
+		if (previous[slot] != ULONG_MAX)
+		{
+			next[previous[slot]] = next[slot];
+		}
+		else
+		{
+			heads[group] = next[slot];
+		}
+		if (next[slot] != ULONG_MAX)
+		{
+			previous[next[slot]] = previous[slot];
+		}
+
+		for (auto node = groups + group; node > 0; node /= 2)
+		{
+			counts[node]--;
 		}
 	}
 }
@@ -0,0 +1,255 @@
+#include "stash-simulator.hpp"
+
+#include "utility.hpp"
+
+#include <boost/format.hpp>
+#include <thread>
+
+namespace PathORAM
+{
+	using namespace std;
+	using boost::format;
+
+#pragma region StashDistribution
+
+	double StashDistribution::tail(const number size) const
+	{
+		number above = 0;
+		for (auto s = size + 1; s < histogram.size(); s++)
+		{
+			above += histogram[s];
+		}
+		return samples == 0 ? 0 : (double)above / samples;
+	}
+
+	double StashDistribution::overflow(const number capacity) const
+	{
+		number above = 0;
+		for (auto s = capacity + 1; s < maxima.size(); s++)
+		{
+			above += maxima[s];
+		}
+		return trials == 0 ? 0 : (double)above / trials;
+	}
+
+	number StashDistribution::capacityFor(const double probability) const
+	{
+		number capacity = 0;
+		while (tail(capacity) > probability)
+		{
+			capacity++;
+		}
+		return capacity;
+	}
+
+	void StashDistribution::merge(const StashDistribution &other)
+	{
+		for (auto [mine, theirs] : {make_pair(&histogram, &other.histogram), make_pair(&maxima, &other.maxima)})
+		{
+			if (mine->size() < theirs->size())
+			{
+				mine->resize(theirs->size(), 0);
+			}
+			for (number s = 0; s < theirs->size(); s++)
+			{
+				(*mine)[s] += (*theirs)[s];
+			}
+		}
+		samples += other.samples;
+		trials += other.trials;
+		dummyAccesses += other.dummyAccesses;
+	}
+
+#pragma endregion StashDistribution
+
+#pragma region StashSimulator
+
+	StashSimulator::StashSimulator(const number logCapacity, const number Z, const double load, const EvictionPolicy policy, const number watermark, const number maxEvictions) :
+		height(logCapacity),
+		Z(Z),
+		leaves(1uLL << (logCapacity - 1)),
+		blocks((number)(load * (1uLL << logCapacity) * Z)),
+		policy(policy),
+		watermark(watermark),
+		maxEvictions(maxEvictions)
+	{
+#if INPUT_CHECKS
+		if (logCapacity == 0 || Z == 0)
+		{
+			throw Exception(boost::format("height (%1%) and Z (%2%) must be positive") % logCapacity % Z);
+		}
+
+		if (load <= 0 || load > 1 || blocks == 0)
+		{
+			throw Exception(boost::format("load factor %1% is out of (0, 1]") % load);
+		}
+
+		if (policy == EVICTION_BACKGROUND && watermark == 0)
+		{
+			throw Exception("background eviction needs a positive watermark");
+		}
+#endif
+	}
+
+	StashDistribution StashSimulator::run(const number accesses, const number trials, const number threads, const number warmUp) const
+	{
+		// seeded up front, so that the result does not depend on the number of threads
+		vector<number> seeds(trials);
+		for (auto &&seed : seeds)
+		{
+			seed = getRandomULong(ULONG_MAX);
+		}
+
+		const auto workers = max(1uLL, min(threads, trials));
+		vector<StashDistribution> results(workers);
+		vector<thread> runners;
+		for (number worker = 0; worker < workers; worker++)
+		{
+			runners.push_back(thread([&, worker]() {
+				for (auto trial = worker; trial < trials; trial += workers)
+				{
+					simulate(seeds[trial], warmUp == 0 ? blocks : warmUp, accesses, results[worker]);
+				}
+			}));
+		}
+
+		StashDistribution distribution;
+		for (number worker = 0; worker < workers; worker++)
+		{
+			runners[worker].join();
+			distribution.merge(results[worker]);
+		}
+		return distribution;
+	}
+
+	StashSimulator::Trial StashSimulator::start(const number seed) const
+	{
+		Trial trial;
+		trial.random.seed(seed);
+		trial.positions.resize(blocks);
+		trial.tree.resize((1uLL << height) * Z, ULONG_MAX);
+
+		uniform_int_distribution<number> leaf(0, leaves - 1);
+		for (number block = 0; block < blocks; block++)
+		{
+			trial.positions[block] = leaf(trial.random);
+
+			auto placed = false;
+			for (number level = height; level-- > 0 && !placed;)
+			{
+				const auto bucket = bucketForLevelLeaf(level, trial.positions[block]);
+				for (number slot = bucket * Z; slot < (bucket + 1) * Z && !placed; slot++)
+				{
+					if (trial.tree[slot] == ULONG_MAX)
+					{
+						trial.tree[slot] = block;
+						placed			 = true;
+					}
+				}
+			}
+			if (!placed)
+			{
+				trial.stash.push_back(block);
+			}
+		}
+
+		return trial;
+	}
+
+	void StashSimulator::simulate(const number seed, const number warmUp, const number accesses, StashDistribution &distribution) const
+	{
+		auto trial = start(seed);
+
+		uniform_int_distribution<number> leaf(0, leaves - 1);
+		uniform_int_distribution<number> request(0, blocks - 1);
+		number largest = 0;
+		for (number i = 0; i < warmUp + accesses; i++)
+		{
+			const auto block = request(trial.random);
+			access(trial, block, trial.positions[block]);
+
+			if (policy == EVICTION_BACKGROUND)
+			{
+				for (number j = 0; j < maxEvictions && trial.stash.size() >= watermark; j++)
+				{
+					access(trial, ULONG_MAX, leaf(trial.random));
+					if (i >= warmUp)
+					{
+						distribution.dummyAccesses++;
+					}
+				}
+			}
+
+			if (i >= warmUp)
+			{
+				const auto size = trial.stash.size();
+				if (distribution.histogram.size() <= size)
+				{
+					distribution.histogram.resize(size + 1, 0);
+				}
+				distribution.histogram[size]++;
+				distribution.samples++;
+				largest = max(largest, (number)size);
+			}
+		}
+
+		if (distribution.maxima.size() <= largest)
+		{
+			distribution.maxima.resize(largest + 1, 0);
+		}
+		distribution.maxima[largest]++;
+		distribution.trials++;
+	}
+
+	void StashSimulator::access(Trial &trial, const number block, const number leaf) const
+	{
+		// read path
+		for (number level = 0; level < height; level++)
+		{
+			const auto bucket = bucketForLevelLeaf(level, leaf);
+			for (number slot = bucket * Z; slot < (bucket + 1) * Z; slot++)
+			{
+				if (trial.tree[slot] != ULONG_MAX)
+				{
+					trial.stash.push_back(trial.tree[slot]);
+					trial.tree[slot] = ULONG_MAX;
+				}
+			}
+		}
+
+		// remap block
+		if (block != ULONG_MAX)
+		{
+			trial.positions[block] = uniform_int_distribution<number>(0, leaves - 1)(trial.random);
+		}
+
+		// write path, from leaf to root (greedy)
+		for (number level = height; level-- > 0;)
+		{
+			const auto bucket = bucketForLevelLeaf(level, leaf);
+			auto slot		  = bucket * Z;
+			for (number i = 0; i < trial.stash.size() && slot < (bucket + 1) * Z;)
+			{
+				if (bucketForLevelLeaf(level, trial.positions[trial.stash[i]]) == bucket)
+				{
+					trial.tree[slot++] = trial.stash[i];
+
+					// remove from stash (order does not matter)
+					trial.stash[i] = trial.stash.back();
+					trial.stash.pop_back();
+				}
+				else
+				{
+					i++;
+				}
+			}
+		}
+	}
+
+	number StashSimulator::bucketForLevelLeaf(const number level, const number leaf) const
+	{
+		return (leaf + leaves) >> (height - 1 - level);
+	}
+
+#pragma endregion StashSimulator
+}
@@ -13,6 +13,7 @@
 #include <boost/format.hpp>
 #include <cstring>
 #include <openssl/aes.h>
+#include <thread>
 #include <utility.hpp>
 #include <vector>
 
@@ -34,138 +35,278 @@ namespace PathORAM
 	using namespace std;
 	using boost::format;
 
-#pragma region AbsStorageAdapter
+	/**
+	 * @brief the current time if timing or tracing is enabled (the clock is not read otherwise)
+	 */
+	inline chrono::steady_clock::time_point startTimer(const StorageTimes *times, const Tracer *tracer = nullptr)
+	{
+		return times != nullptr || tracer != nullptr ? chrono::steady_clock::now() : chrono::steady_clock::time_point();
+	}
 
-	AbsStorageAdapter::~AbsStorageAdapter()
+	/**
+	 * @brief adds the time since start to the counter if timing is enabled, and records a span named name if tracing is enabled
+	 */
+	inline void stopTimer(StorageTimes *times, number StorageTimes::*counter, const chrono::steady_clock::time_point start, Tracer *tracer = nullptr, const char *name = nullptr, const number buckets = 0)
 	{
+		if (times == nullptr && tracer == nullptr)
+		{
+			return;
+		}
+
+		const auto end = chrono::steady_clock::now();
+		if (times != nullptr)
+		{
+			times->*counter += chrono::duration_cast<chrono::nanoseconds>(end - start).count();
+		}
+		if (tracer != nullptr)
+		{
+			tracer->record(name, "storage", start, end, buckets);
+		}
 	}
 
-	void AbsStorageAdapter::get(const vector<number> &locations, vector<block> &response) const
+	// per-thread buffers of raw buckets for get and set with record buffers, kept between calls;
+	// per thread, as one adapter may serve several threads (e.g. ConcurrentORAM)
+	static thread_local vector<bytes> rawBuckets, spareBuckets;
+	static thread_local vector<pair<number, bytes>> rawWrites, spareWrites;
+	static thread_local bytes plaintext; // one bucket, decrypted or to encrypt
+
+	/**
+	 * @brief resizes a vector of buffers, moving the elements that are cut off to spare and taking new ones from there,
+	 * so that the buffers are not freed and allocated again as the batch size varies
+	 */
+	template <typename T>
+	void resizeReusing(vector<T> &buffers, vector<T> &spare, const number size)
 	{
-		for (auto &&location : locations)
+		while (buffers.size() > size)
 		{
-			checkCapacity(location);
+			spare.push_back(move(buffers.back()));
+			buffers.pop_back();
 		}
+		while (buffers.size() < size && !spare.empty())
+		{
+			buffers.push_back(move(spare.back()));
+			spare.pop_back();
+		}
+		buffers.resize(size);
+	}
 
-		// optimize for single operation
+#pragma region AbsStorageAdapter
+
+	AbsStorageAdapter::~AbsStorageAdapter()
+	{
+	}
+
+	void AbsStorageAdapter::get(const vector<number> &locations, vector<block> &response) const
+	{
 		vector<bytes> raws;
-		raws.reserve(locations.size());
+		auto start = startTimer(times);
+		getRaw(locations, raws);
+		stopTimer(times, &StorageTimes::read, start);
 
-		if (locations.size() == 1)
+		start = startTimer(times, tracer.get());
+		response.reserve(response.size() + locations.size() * Z);
+		bytes decrypted;
+		for (auto &&raw : raws)
 		{
-			raws.resize(1);
-			getAndRecord(locations[0], raws[0]);
+			decryptBucket(raw, decrypted);
+
+			const auto length = decrypted.size() / Z;
+			for (auto i = 0uLL; i < Z; i++)
+			{
+				const auto record = decrypted.begin() + i * length;
+				response.push_back({((number *)&(*record))[0], bytes(record + AES_BLOCK_SIZE, record + length)});
+			}
 		}
-		else
+
+		stopTimer(times, &StorageTimes::decrypt, start, tracer.get(), "decrypt", raws.size());
+	}
+
+	void AbsStorageAdapter::get(const vector<number> &locations, vector<arenaBlock> &response, BlockArena &arena) const
+	{
+		resizeReusing(rawBuckets, spareBuckets, locations.size());
+		auto start = startTimer(times);
+		getRaw(locations, rawBuckets);
+		stopTimer(times, &StorageTimes::read, start);
+
+		start = startTimer(times, tracer.get());
+		response.reserve(response.size() + locations.size() * Z);
+		for (auto &&raw : rawBuckets)
 		{
-			if (batchLimit == 0 || locations.size() <= batchLimit)
+			decryptBucket(raw, plaintext);
+
+			const auto length = plaintext.size() / Z;
+			for (auto i = 0uLL; i < Z; i++)
 			{
-				getAndRecord(locations, raws);
+				const auto record = plaintext.data() + i * length;
+				auto payload	  = arena.allocate();
+				payload.assign(record + AES_BLOCK_SIZE, length - AES_BLOCK_SIZE);
+				response.push_back({((number *)record)[0], move(payload)});
 			}
-			else
+		}
+
+		stopTimer(times, &StorageTimes::decrypt, start, tracer.get(), "decrypt", rawBuckets.size());
+	}
+
+	void AbsStorageAdapter::get(const vector<number> &locations, uchar *records) const
+	{
+		resizeReusing(rawBuckets, spareBuckets, locations.size());
+		auto start = startTimer(times);
+		getRaw(locations, rawBuckets);
+		stopTimer(times, &StorageTimes::read, start);
+
+		start				  = startTimer(times, tracer.get());
+		const auto bucketSize = blockSize - AES_BLOCK_SIZE;
+		for (number i = 0; i < rawBuckets.size(); i++)
+		{
+			// always checked, the records buffer is sized by the block size
+			if (rawBuckets[i].size() != blockSize)
 			{
-				vector<number> batch;
-				number pointer = 0;
-				while (pointer < locations.size())
-				{
-					batch.reserve(min(batchLimit, locations.size() - pointer));
-					copy(
-						locations.begin() + pointer,
-						(number)distance(locations.begin() + pointer, locations.end()) > batchLimit ?
-							  locations.begin() + pointer + batchLimit :
-							  locations.end(),
-						back_inserter(batch));
-					getAndRecord(batch, raws);
-					batch.clear();
-					pointer += batchLimit;
-				}
+				throw Exception(boost::format("raw bucket of size %1% at location %2%, expected %3%") % rawBuckets[i].size() % locations[i] % blockSize);
 			}
+			decryptBucket(rawBuckets[i], records + i * bucketSize);
 		}
 
-		response.reserve(locations.size() * Z);
-		for (auto &&raw : raws)
+		stopTimer(times, &StorageTimes::decrypt, start, tracer.get(), "decrypt", rawBuckets.size());
+	}
+
+	void AbsStorageAdapter::set(const vector<number> &locations, const uchar *records)
+	{
+		auto start = startTimer(times, tracer.get());
+		resizeReusing(rawWrites, spareWrites, locations.size());
+
+		const auto bucketSize = blockSize - AES_BLOCK_SIZE;
+		for (number i = 0; i < locations.size(); i++)
 		{
-			// decompose to ID and cipher
+			checkCapacity(locations[i]);
 
-			bytes decrypted;
-			encrypt(
-				key.begin(),
-				key.end(),
-				raw.begin(),
-				raw.begin() + AES_BLOCK_SIZE,
-				raw.begin() + AES_BLOCK_SIZE,
-				raw.end(),
-				decrypted,
-				DECRYPT);
+			rawWrites[i].first = locations[i];
+			encryptBucket(records + i * bucketSize, bucketSize, rawWrites[i].second);
+		}
 
-			const auto length = decrypted.size() / Z;
+		stopTimer(times, &StorageTimes::encrypt, start, tracer.get(), "encrypt", rawWrites.size());
 
-			for (auto i = 0uLL; i < Z; i++)
-			{
-				// decompose to ID and data (extract ID from bytes)
-				uchar buffer[AES_BLOCK_SIZE];
-				copy(decrypted.begin() + i * length, decrypted.begin() + i * length + AES_BLOCK_SIZE, buffer);
+		start = startTimer(times);
+		setRaw(rawWrites);
+		stopTimer(times, &StorageTimes::write, start);
+	}
 
-				response.push_back(
-					{((number *)buffer)[0],
-					 bytes(decrypted.begin() + i * length + AES_BLOCK_SIZE, decrypted.begin() + (i + 1) * length)});
-			}
-		}
+	number AbsStorageAdapter::recordSize() const
+	{
+		return AES_BLOCK_SIZE + userBlockSize;
+	}
+
+	number AbsStorageAdapter::bucketCapacity() const
+	{
+		return Z;
 	}
 
 	void AbsStorageAdapter::set(const request_anyrange requests)
 	{
-		vector<block> writes;
+		auto start = startTimer(times, tracer.get());
+		vector<pair<number, bytes>> writes;
 
 		for (auto &&[location, blocks] : requests)
 		{
 			checkCapacity(location);
+			checkBucketSize(blocks.size());
 
-#if INPUT_CHECKS
-			if (blocks.size() != Z)
+			bytes toEncrypt;
+			toEncrypt.reserve(userBlockSize * Z + AES_BLOCK_SIZE * Z);
+			for (auto &&block : blocks)
 			{
-				throw Exception(boost::format("each set request must contain exactly Z=%1% blocks (%2% given)") % Z % blocks.size());
+				appendBlock(toEncrypt, block.first, block.second.data(), block.second.size());
 			}
-#endif
 
-			bytes toEncrypt;
-			toEncrypt.reserve(AES_BLOCK_SIZE + userBlockSize * Z);
+			writes.push_back({location, bytes()});
+			encryptBucket(toEncrypt.data(), toEncrypt.size(), writes.back().second);
+		}
+
+		stopTimer(times, &StorageTimes::encrypt, start, tracer.get(), "encrypt", writes.size());
 
+		start = startTimer(times);
+		setRaw(writes);
+		stopTimer(times, &StorageTimes::write, start);
+	}
+
+	void AbsStorageAdapter::set(const arena_range requests)
+	{
+		auto start = startTimer(times, tracer.get());
+		resizeReusing(rawWrites, spareWrites, requests.size());
+
+		number i = 0;
+		for (auto &&[location, blocks] : requests)
+		{
+			checkCapacity(location);
+			checkBucketSize(blocks.size());
+
+			plaintext.clear();
 			for (auto &&block : blocks)
 			{
-				checkBlockSize(block.second.size());
+				appendBlock(plaintext, block.first, block.second.data(), block.second.size());
+			}
 
-				// pad if necessary
-				if (block.second.size() < userBlockSize)
-				{
-					block.second.resize(userBlockSize, 0x00);
-				}
+			rawWrites[i].first = location;
+			encryptBucket(plaintext.data(), plaintext.size(), rawWrites[i].second);
+			i++;
+		}
 
-				// represent ID as a vector of bytes of length AES_BLOCK_SIZE
-				const number buffer[1] = {block.first};
-				bytes id((uchar *)buffer, (uchar *)buffer + sizeof(number));
-				id.resize(AES_BLOCK_SIZE, 0x00);
+		stopTimer(times, &StorageTimes::encrypt, start, tracer.get(), "encrypt", rawWrites.size());
 
-				// merge ID and data
-				toEncrypt.insert(toEncrypt.end(), id.begin(), id.end());
-				toEncrypt.insert(toEncrypt.end(), block.second.begin(), block.second.end());
-			}
+		start = startTimer(times);
+		setRaw(rawWrites);
+		stopTimer(times, &StorageTimes::write, start);
+	}
+
+	void AbsStorageAdapter::getRaw(const vector<number> &locations, vector<bytes> &raws) const
+	{
+		for (auto &&location : locations)
+		{
+			checkCapacity(location);
+		}
 
-			auto iv = getRandomBlock(AES_BLOCK_SIZE);
-			bytes encrypted;
-			encrypt(
-				key.begin(),
-				key.end(),
-				iv.begin(),
-				iv.end(),
-				toEncrypt.begin(),
-				toEncrypt.end(),
-				iv, // append result to IV
-				ENCRYPT);
+		raws.resize(locations.size());
 
-			writes.push_back({location, iv});
+		// optimize for single operation
+		if (locations.size() == 1)
+		{
+			raws[0].clear();
+			getAndRecord(locations[0], raws[0]);
+		}
+		else
+		{
+			if (batchLimit == 0 || locations.size() <= batchLimit)
+			{
+				getAndRecord(locations, raws);
+			}
+			else
+			{
+				vector<number> batch;
+				vector<bytes> responses;
+				number pointer = 0;
+				while (pointer < locations.size())
+				{
+					batch.reserve(min(batchLimit, locations.size() - pointer));
+					copy(
+						locations.begin() + pointer,
+						(number)distance(locations.begin() + pointer, locations.end()) > batchLimit ?
+							  locations.begin() + pointer + batchLimit :
+							  locations.end(),
+						back_inserter(batch));
+					responses.resize(batch.size());
+					getAndRecord(batch, responses);
+					for (number i = 0; i < batch.size(); i++)
+					{
+						swap(raws[pointer + i], responses[i]);
+					}
+					batch.clear();
+					pointer += batchLimit;
+				}
+			}
 		}
+	}
 
+	void AbsStorageAdapter::setRaw(const vector<pair<number, bytes>> &writes)
+	{
 		// optimize for single operation
 		if (writes.size() == 1)
 		{
@@ -198,6 +339,57 @@ namespace PathORAM
 		}
 	}
 
+	void AbsStorageAdapter::decryptBucket(const bytes &raw, bytes &decrypted) const
+	{
+		// decompose to IV and cipher
+		decrypted.clear();
+		encrypt(
+			key.begin(),
+			key.end(),
+			raw.begin(),
+			raw.begin() + AES_BLOCK_SIZE,
+			raw.begin() + AES_BLOCK_SIZE,
+			raw.end(),
+			decrypted,
+			DECRYPT);
+	}
+
+	void AbsStorageAdapter::decryptBucket(const bytes &raw, uchar *decrypted) const
+	{
+		encrypt(key.data(), raw.data(), raw.data() + AES_BLOCK_SIZE, raw.size() - AES_BLOCK_SIZE, decrypted, DECRYPT);
+	}
+
+	void AbsStorageAdapter::appendBlock(bytes &toEncrypt, const number id, const uchar *data, const number size) const
+	{
+		checkBlockSize(size);
+
+		// represent ID as a vector of bytes of length AES_BLOCK_SIZE
+		toEncrypt.insert(toEncrypt.end(), (const uchar *)&id, (const uchar *)&id + sizeof(number));
+		toEncrypt.resize(toEncrypt.size() + AES_BLOCK_SIZE - sizeof(number), 0x00);
+
+		// merge ID and data (pad if necessary)
+		toEncrypt.insert(toEncrypt.end(), data, data + size);
+		toEncrypt.resize(toEncrypt.size() + userBlockSize - size, 0x00);
+	}
+
+	void AbsStorageAdapter::encryptBucket(const uchar *toEncrypt, const number size, bytes &raw) const
+	{
+		// fresh IV, then the ciphertext
+		raw.resize(AES_BLOCK_SIZE + size);
+		getRandomBlock(raw.data(), AES_BLOCK_SIZE);
+		encrypt(key.data(), raw.data(), toEncrypt, size, raw.data() + AES_BLOCK_SIZE, ENCRYPT);
+	}
+
+	void AbsStorageAdapter::checkBucketSize(const number blocks) const
+	{
+#if INPUT_CHECKS
+		if (blocks != Z)
+		{
+			throw Exception(boost::format("each set request must contain exactly Z=%1% blocks (%2% given)") % Z % blocks);
+		}
+#endif
+	}
+
 	void AbsStorageAdapter::get(const number location, bucket &response) const
 	{
 		const auto locations = vector<number>{location};
@@ -213,10 +405,10 @@ namespace PathORAM
 
 	void AbsStorageAdapter::getInternal(const vector<number> &locations, vector<bytes> &response) const
 	{
-		response.resize(response.size() + locations.size());
 		for (unsigned int i = 0; i < locations.size(); i++)
 		{
-			getAndRecord(locations[i], response[response.size() - locations.size() + i]);
+			response[i].clear();
+			getAndRecord(locations[i], response[i]);
 		}
 	}
 
@@ -293,55 +485,115 @@ namespace PathORAM
 
 	boost::signals2::connection AbsStorageAdapter::subscribe(const OnStorageRequest::slot_type &handler)
 	{
+		subscribed.store(true, memory_order_relaxed);
 		return onStorageRequest.connect(handler);
 	}
 
+	void AbsStorageAdapter::recordTimes(StorageTimes *times)
+	{
+		this->times = times;
+	}
+
+	void AbsStorageAdapter::setTracer(const shared_ptr<Tracer> tracer)
+	{
+		this->tracer = tracer;
+	}
+
+	void AbsStorageAdapter::traceCall(const char *name, const chrono::steady_clock::time_point start, const number elapsed, const number buckets) const
+	{
+		if (tracer != nullptr)
+		{
+			tracer->record(name, "storage", start, start + chrono::nanoseconds(elapsed), buckets);
+		}
+	}
+
 	void AbsStorageAdapter::setAndRecord(const number location, const bytes &raw)
 	{
 		RECORD_AND_EXECUTE(
-			onStorageRequest.empty(),
+			false,
 			setInternal(location, raw),
-			onStorageRequest(false, 1, raw.size(), elapsed));
+			{
+				storageMetrics.recordWrite(1, raw.size(), elapsed);
+				traceCall("storage write", start, elapsed, 1);
+				if (subscribed.load(memory_order_relaxed) && !onStorageRequest.empty())
+				{
+					onStorageRequest(false, 1, raw.size(), elapsed);
+				}
+			});
 	}
 
 	void AbsStorageAdapter::getAndRecord(const number location, bytes &response) const
 	{
 		RECORD_AND_EXECUTE(
-			onStorageRequest.empty(),
+			false,
 			getInternal(location, response),
-			onStorageRequest(true, 1, response.size(), elapsed));
+			{
+				storageMetrics.recordRead(1, response.size(), elapsed);
+				traceCall("storage read", start, elapsed, 1);
+				if (subscribed.load(memory_order_relaxed) && !onStorageRequest.empty())
+				{
+					onStorageRequest(true, 1, response.size(), elapsed);
+				}
+			});
 	}
 
 	void AbsStorageAdapter::setAndRecord(const vector<pair<number, bytes>> &requests)
 	{
+		// without batch support, setInternal records each request
 		RECORD_AND_EXECUTE(
-			onStorageRequest.empty() || !supportsBatchSet(),
+			!supportsBatchSet(),
 			setInternal(requests),
 			{
-				auto size = 0;
+				number size = 0;
 				for (auto &&request : requests)
 				{
 					size += request.second.size();
 				}
-				onStorageRequest(false, requests.size(), size, elapsed);
+				storageMetrics.recordWrite(requests.size(), size, elapsed);
+				traceCall("storage write", start, elapsed, requests.size());
+				if (subscribed.load(memory_order_relaxed) && !onStorageRequest.empty())
+				{
+					onStorageRequest(false, requests.size(), size, elapsed);
+				}
 			});
 	}
 
 	void AbsStorageAdapter::getAndRecord(const vector<number> &locations, vector<bytes> &response) const
 	{
+		// without batch support, getInternal records each request
 		RECORD_AND_EXECUTE(
-			onStorageRequest.empty() || !supportsBatchGet(),
+			!supportsBatchGet(),
 			getInternal(locations, response),
 			{
-				auto size = 0;
+				number size = 0;
 				for (auto raw = response.end() - locations.size(); raw != response.end(); raw++)
 				{
 					size += (*raw).size();
 				}
-				onStorageRequest(true, locations.size(), size, elapsed);
+				storageMetrics.recordRead(locations.size(), size, elapsed);
+				traceCall("storage read", start, elapsed, locations.size());
+				if (subscribed.load(memory_order_relaxed) && !onStorageRequest.empty())
+				{
+					onStorageRequest(true, locations.size(), size, elapsed);
+				}
 			});
 	}
 
+	StorageMetricsSnapshot AbsStorageAdapter::metrics(const bool histograms) const
+	{
+		return storageMetrics.snapshot(histograms);
+	}
+
+	void AbsStorageAdapter::resetMetrics()
+	{
+		storageMetrics.reset();
+	}
+
+	number AbsStorageAdapter::memoryUsage() const
+	{
+		return sizeof(StorageMetrics) + key.capacity();
+	}
+
 #pragma endregion AbsStorageAdapter
 
 #pragma region InMemoryStorageAdapter
@@ -377,6 +629,11 @@ namespace PathORAM
 		copy(raw.begin(), raw.end(), blocks[location]);
 	}
 
+	number InMemoryStorageAdapter::memoryUsage() const
+	{
+		return AbsStorageAdapter::memoryUsage() + capacity * (blockSize + sizeof(uchar *));
+	}
+
 #pragma endregion InMemoryStorageAdapter
 
 #pragma region FileSystemStorageAdapter
@@ -436,6 +693,86 @@ namespace PathORAM
 
 #pragma endregion FileSystemStorageAdapter
 
+#pragma region SimulatedLatencyStorageAdapter
+
+	SimulatedLatencyStorageAdapter::~SimulatedLatencyStorageAdapter()
+	{
+	}
+
+	SimulatedLatencyStorageAdapter::SimulatedLatencyStorageAdapter(const shared_ptr<AbsStorageAdapter> storage, const SimulatedLatency latency) :
+		AbsStorageAdapter(storage->capacity, storage->userBlockSize, storage->key, storage->Z, storage->batchLimit),
+		storage(storage),
+		latency(latency)
+	{
+	}
+
+	number SimulatedLatencyStorageAdapter::memoryUsage() const
+	{
+		return AbsStorageAdapter::memoryUsage() + storage->memoryUsage();
+	}
+
+	void SimulatedLatencyStorageAdapter::setInternal(const number location, const bytes &raw)
+	{
+		const auto start = chrono::steady_clock::now();
+		storage->setInternal(location, raw);
+		delay(start, latency.request, raw.size());
+	}
+
+	void SimulatedLatencyStorageAdapter::getInternal(const number location, bytes &response) const
+	{
+		const auto start = chrono::steady_clock::now();
+		storage->getInternal(location, response);
+		delay(start, latency.request, blockSize);
+	}
+
+	void SimulatedLatencyStorageAdapter::setInternal(const vector<pair<number, bytes>> &requests)
+	{
+		if (!latency.batching)
+		{
+			// a sequence of single calls
+			AbsStorageAdapter::setInternal(requests);
+			return;
+		}
+
+		const auto start = chrono::steady_clock::now();
+		storage->setInternal(requests);
+		delay(start, latency.batch, requests.size() * blockSize);
+	}
+
+	void SimulatedLatencyStorageAdapter::getInternal(const vector<number> &locations, vector<bytes> &response) const
+	{
+		if (!latency.batching)
+		{
+			// a sequence of single calls
+			AbsStorageAdapter::getInternal(locations, response);
+			return;
+		}
+
+		const auto start = chrono::steady_clock::now();
+		storage->getInternal(locations, response);
+		delay(start, latency.batch, locations.size() * blockSize);
+	}
+
+	void SimulatedLatencyStorageAdapter::delay(const chrono::steady_clock::time_point start, const chrono::nanoseconds roundTrip, const number size) const
+	{
+		auto duration = roundTrip + chrono::nanoseconds((number)(latency.perByte * size));
+		if (latency.jitter.count() > 0)
+		{
+			duration += chrono::nanoseconds(getRandomULong(latency.jitter.count() + 1));
+		}
+
+		const auto deadline = start + duration;
+		if (deadline - chrono::steady_clock::now() > SPIN)
+		{
+			this_thread::sleep_until(deadline - SPIN);
+		}
+		while (chrono::steady_clock::now() < deadline)
+		{
+		}
+	}
+
+#pragma endregion SimulatedLatencyStorageAdapter
+
 #if USE_REDIS
 #pragma region RedisStorageAdapter
 
@@ -485,8 +822,10 @@ namespace PathORAM
 		vector<optional<string>> returned;
 		redis->mget(input.begin(), input.end(), back_inserter(returned));
 
-		response.reserve(response.size() + returned.size());
-		transform(returned.begin(), returned.end(), back_inserter(response), [](optional<string> val) { return bytes(val.value().begin(), val.value().end()); });
+		for (number i = 0; i < returned.size(); i++)
+		{
+			response[i].assign(returned[i].value().begin(), returned[i].value().end());
+		}
 	}
 
 #pragma endregion RedisStorageAdapter
@@ -619,7 +958,10 @@ namespace PathORAM
 			delete[] strs[i];
 		}
 
-		copy(udata.result.begin(), udata.result.end(), back_inserter(response));
+		for (uint i = 0; i < locations.size(); i++)
+		{
+			response[i] = move(udata.result[i]);
+		}
 	}
 
 	void AerospikeStorageAdapter::deleteAll()
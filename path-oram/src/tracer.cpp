@@ -0,0 +1,169 @@
+#include "tracer.hpp"
+
+#include <boost/format.hpp>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+
+namespace PathORAM
+{
+	using namespace std;
+
+	Tracer::Tracer(const number capacity) :
+		capacity(capacity),
+		slots(new Slot[capacity]),
+		origin(chrono::steady_clock::now())
+	{
+#if INPUT_CHECKS
+		if (capacity == 0 || (capacity & (capacity - 1)) != 0)
+		{
+			throw Exception(boost::format("tracer capacity must be a power of two (provided %1%)") % capacity);
+		}
+#endif
+	}
+
+	void Tracer::record(const char *name, const char *category, const chrono::steady_clock::time_point start, const chrono::steady_clock::time_point end, const number buckets)
+	{
+		const auto index = head.fetch_add(1, memory_order_relaxed);
+		auto &slot		 = slots[index & (capacity - 1)];
+
+		// a reader that sees an odd or a different sequence skips the slot
+		slot.sequence.store(2 * index + 1, memory_order_relaxed);
+		atomic_thread_fence(memory_order_release);
+
+		slot.event.name		= name;
+		slot.event.category = category;
+		slot.event.start	= start > origin ? chrono::duration_cast<chrono::nanoseconds>(start - origin).count() : 0;
+		slot.event.duration = end > start ? chrono::duration_cast<chrono::nanoseconds>(end - start).count() : 0;
+		slot.event.thread	= threadId();
+		slot.event.batch	= batch;
+		slot.event.buckets	= buckets;
+
+		slot.sequence.store(2 * index + 2, memory_order_release);
+	}
+
+	number Tracer::beginBatch()
+	{
+		if (batchDepth++ == 0)
+		{
+			batch = batches.fetch_add(1, memory_order_relaxed) + 1;
+		}
+		return batch;
+	}
+
+	void Tracer::endBatch()
+	{
+		if (batchDepth > 0 && --batchDepth == 0)
+		{
+			batch = 0;
+		}
+	}
+
+	TraceBatch::TraceBatch(Tracer *tracer, const char *name, const char *category) :
+		tracer(tracer),
+		name(name),
+		category(category),
+		start(tracer != nullptr ? chrono::steady_clock::now() : chrono::steady_clock::time_point())
+	{
+		if (tracer != nullptr)
+		{
+			tracer->beginBatch();
+		}
+	}
+
+	TraceBatch::~TraceBatch()
+	{
+		if (tracer != nullptr)
+		{
+			tracer->record(name, category, start, chrono::steady_clock::now());
+			tracer->endBatch();
+		}
+	}
+
+	vector<TraceEvent> Tracer::events() const
+	{
+		const auto end	 = head.load(memory_order_acquire);
+		const auto begin = end > capacity ? end - capacity : 0;
+
+		vector<TraceEvent> result;
+		result.reserve(end - begin);
+		for (auto index = begin; index < end; index++)
+		{
+			const auto &slot	 = slots[index & (capacity - 1)];
+			const auto sequence = slot.sequence.load(memory_order_acquire);
+			if (sequence != 2 * index + 2)
+			{
+				continue;
+			}
+
+			const auto event = slot.event;
+			atomic_thread_fence(memory_order_acquire);
+			if (slot.sequence.load(memory_order_relaxed) == sequence)
+			{
+				result.push_back(event);
+			}
+		}
+
+		return result;
+	}
+
+	number Tracer::recorded() const
+	{
+		return head.load(memory_order_relaxed);
+	}
+
+	number Tracer::overwritten() const
+	{
+		const auto total = head.load(memory_order_relaxed);
+		return total > capacity ? total - capacity : 0;
+	}
+
+	void Tracer::dump(ostream &output) const
+	{
+		// timestamps are in microseconds, with nanosecond precision
+		const auto flags	 = output.flags();
+		const auto precision = output.precision();
+		output << fixed << setprecision(3);
+		output << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+
+		auto first = true;
+		for (auto &&event : events())
+		{
+			output << (first ? "" : ",") << endl;
+			first = false;
+
+			output << "{\"name\":\"" << event.name << "\",\"cat\":\"" << event.category << "\",\"ph\":\"X\""
+				   << ",\"ts\":" << event.start / 1000.0 << ",\"dur\":" << event.duration / 1000.0
+				   << ",\"pid\":1,\"tid\":" << event.thread << ",\"args\":{\"batch\":" << event.batch;
+			if (event.buckets > 0)
+			{
+				output << ",\"buckets\":" << event.buckets;
+			}
+			output << "}}";
+		}
+
+		output << endl
+			   << "]}" << endl;
+
+		output.flags(flags);
+		output.precision(precision);
+	}
+
+	void Tracer::dump(const string &filename) const
+	{
+		fstream file;
+		file.open(filename, fstream::out | fstream::trunc);
+		if (!file.is_open())
+		{
+			throw Exception(boost::format("cannot open %1%: %2%") % filename % strerror(errno));
+		}
+
+		dump(file);
+	}
+
+	number Tracer::threadId()
+	{
+		thread_local const number id = threads.fetch_add(1, memory_order_relaxed) + 1;
+		return id;
+	}
+}
@@ -2,6 +2,7 @@
 
 #include <boost/algorithm/string/trim.hpp>
 #include <boost/format.hpp>
+#include <cmath>
 #include <fstream>
 #include <iomanip>
 #include <openssl/aes.h>
@@ -12,6 +13,10 @@
 #include <sstream>
 #include <vector>
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
 #define HANDLE_ERROR(statement)      \
 	if (!(statement))                \
 	{                                \
@@ -24,16 +29,21 @@ namespace PathORAM
 
 	bytes getRandomBlock(const number blockSize)
 	{
-		uchar material[blockSize];
+		bytes material(blockSize);
+		getRandomBlock(material.data(), blockSize);
+		return material;
+	}
+
+	void getRandomBlock(uchar *buffer, const number size)
+	{
 #if defined(TESTING) || defined(DEBUG)
-		for (number i = 0; i < blockSize; i++)
+		for (number i = 0; i < size; i++)
 		{
-			material[i] = (uchar)rand();
+			buffer[i] = (uchar)rand();
 		}
 #else
-		RAND_bytes(material, blockSize);
+		RAND_bytes(buffer, size);
 #endif
-		return bytes(material, material + blockSize);
 	}
 
 	number getRandomULong(const number max)
@@ -105,33 +115,44 @@ namespace PathORAM
 		}
 #endif
 
+		// the IV may point into the output, which is about to grow
+		uchar ivMaterial[AES_BLOCK_SIZE];
+		copy(ivFist, ivLast, ivMaterial);
+
+		const auto offset = output.size();
+		output.resize(offset + size);
+		encrypt(&*keyFirst, ivMaterial, &*inputFirst, size, output.data() + offset, mode);
+	}
+
+	void encrypt(const uchar *key, const uchar *iv, const uchar *input, const number size, uchar *output, const EncryptionMode mode)
+	{
+#if INPUT_CHECKS
+		if (size == 0 || size % AES_BLOCK_SIZE != 0)
+		{
+			throw Exception(boost::format("input must be a multiple of %1% (provided %2% bytes)") % AES_BLOCK_SIZE % size);
+		}
+#endif
+
 		if (__blockCipherMode == NONE)
 		{
-			output.insert(output.end(), inputFirst, inputLast);
+			copy(input, input + size, output);
 			return;
 		}
 
 		AES_KEY aesKey;
-		uchar keyMaterial[KEYSIZE];
-		copy(keyFirst, keyLast, keyMaterial);
 		// CTR always does encryption only
 		if (mode == ENCRYPT || __blockCipherMode == CTR)
 		{
-			AES_set_encrypt_key(keyMaterial, KEYSIZE * 8, &aesKey);
+			AES_set_encrypt_key(key, KEYSIZE * 8, &aesKey);
 		}
 		else
 		{
-			AES_set_decrypt_key(keyMaterial, KEYSIZE * 8, &aesKey);
+			AES_set_decrypt_key(key, KEYSIZE * 8, &aesKey);
 		}
 
+		// the IV is updated by the cipher
 		uchar ivMaterial[AES_BLOCK_SIZE];
-		copy(ivFist, ivLast, ivMaterial);
-
-		uchar inputMaterial[size];
-		copy(inputFirst, inputLast, inputMaterial);
-
-		uchar outputMaterial[size];
-		memset(outputMaterial, 0x00, size);
+		copy(iv, iv + AES_BLOCK_SIZE, ivMaterial);
 
 		uint ctr_num = 0;
 		uchar ctr_buffer[AES_BLOCK_SIZE];
@@ -143,8 +164,8 @@ namespace PathORAM
 		{
 			case CBC:
 				(mode == ENCRYPT ? CRYPTO_cbc128_encrypt : CRYPTO_cbc128_decrypt)(
-					(const uchar *)inputMaterial,
-					outputMaterial,
+					input,
+					output,
 					size,
 					&aesKey,
 					ivMaterial,
@@ -153,8 +174,8 @@ namespace PathORAM
 
 			case CTR:
 				CRYPTO_ctr128_encrypt(
-					(const uchar *)inputMaterial,
-					outputMaterial,
+					input,
+					output,
 					size,
 					&aesKey,
 					ivMaterial,
@@ -166,8 +187,6 @@ namespace PathORAM
 			default:
 				throw Exception(boost::format("Block cipher mode not implemented: %1%") % __blockCipherMode);
 		}
-
-		output.insert(output.end(), outputMaterial, outputMaterial + size);
 	}
 
 	bytes fromText(const string text, const number BLOCK_SIZE)
@@ -255,4 +274,319 @@ namespace PathORAM
 
 		return material[0] % max;
 	}
+
+	// control bytes of FixedHashMap: full slots hold the lower 7 bits of the hash (non-negative)
+	const signed char CONTROL_EMPTY	  = -128;
+	const signed char CONTROL_DELETED = -2;
+
+	FixedHashMap::FixedHashMap(const number maxSize) :
+		maxSize(maxSize),
+		slots(max(GROUP, (number)1 << (number)ceil(log2((maxSize * 8 + 6) / 7 + 1))))
+	{
+		control.resize(slots, CONTROL_EMPTY);
+		spareControl.resize(slots, CONTROL_EMPTY);
+		keys.resize(slots);
+		spareKeys.resize(slots);
+		values.resize(slots);
+		spareValues.resize(slots);
+	}
+
+	number FixedHashMap::hash(const number key)
+	{
+		// splitmix64 finalizer
+		auto z = key + 0x9E3779B97F4A7C15uLL;
+		z	   = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9uLL;
+		z	   = (z ^ (z >> 27)) * 0x94D049BB133111EBuLL;
+		return z ^ (z >> 31);
+	}
+
+	uint FixedHashMap::match(const number group, const signed char value) const
+	{
+#if defined(__SSE2__)
+		const auto controls = _mm_loadu_si128((const __m128i *)(control.data() + group * GROUP));
+		return _mm_movemask_epi8(_mm_cmpeq_epi8(controls, _mm_set1_epi8(value)));
+#else
+		uint mask = 0;
+		for (number i = 0; i < GROUP; i++)
+		{
+			mask |= (uint)(control[group * GROUP + i] == value) << i;
+		}
+		return mask;
+#endif
+	}
+
+	uint FixedHashMap::matchFree(const number group) const
+	{
+#if defined(__SSE2__)
+		// empty and deleted are the only negative control bytes
+		const auto controls = _mm_loadu_si128((const __m128i *)(control.data() + group * GROUP));
+		return _mm_movemask_epi8(controls);
+#else
+		uint mask = 0;
+		for (number i = 0; i < GROUP; i++)
+		{
+			mask |= (uint)(control[group * GROUP + i] < 0) << i;
+		}
+		return mask;
+#endif
+	}
+
+	number FixedHashMap::slot(const number key) const
+	{
+		const auto hashed = hash(key);
+		const auto h2	  = (signed char)(hashed & 0x7F);
+		const auto groups = slots / GROUP;
+
+		// triangular probing over groups visits every group
+		auto group = (hashed >> 7) & (groups - 1);
+		for (number probe = 0; probe < groups; probe++)
+		{
+			for (auto mask = match(group, h2); mask != 0; mask &= mask - 1)
+			{
+				const auto candidate = group * GROUP + __builtin_ctz(mask);
+				if (keys[candidate] == key)
+				{
+					return candidate;
+				}
+			}
+
+			if (match(group, CONTROL_EMPTY) != 0)
+			{
+				break;
+			}
+
+			group = (group + probe + 1) & (groups - 1);
+		}
+
+		return slots;
+	}
+
+	bool FixedHashMap::get(const number key, number &value) const
+	{
+		const auto found = slot(key);
+		if (found == slots)
+		{
+			return false;
+		}
+
+		value = values[found];
+		return true;
+	}
+
+	void FixedHashMap::set(const number key, const number value)
+	{
+		const auto found = slot(key);
+		if (found != slots)
+		{
+			values[found] = value;
+			return;
+		}
+
+		if (count == maxSize)
+		{
+			throw Exception(boost::format("trying to insert over capacity (capacity %1%)") % maxSize);
+		}
+
+		// keep at least 1/8 of the slots empty, so that probing terminates early
+		if ((count + deleted + 1) * 8 > slots * 7)
+		{
+			rehash();
+		}
+
+		const auto hashed = hash(key);
+		const auto groups = slots / GROUP;
+
+		auto group = (hashed >> 7) & (groups - 1);
+		for (number probe = 0; probe < groups; probe++)
+		{
+			const auto mask = matchFree(group);
+			if (mask != 0)
+			{
+				const auto free = group * GROUP + __builtin_ctz(mask);
+				if (control[free] == CONTROL_DELETED)
+				{
+					deleted--;
+				}
+				control[free] = (signed char)(hashed & 0x7F);
+				keys[free]	  = key;
+				values[free]  = value;
+				count++;
+				return;
+			}
+
+			group = (group + probe + 1) & (groups - 1);
+		}
+	}
+
+	bool FixedHashMap::remove(const number key)
+	{
+		const auto found = slot(key);
+		if (found == slots)
+		{
+			return false;
+		}
+
+		// if the group has an empty slot, no probe sequence continues past this group
+		if (match(found / GROUP, CONTROL_EMPTY) != 0)
+		{
+			control[found] = CONTROL_EMPTY;
+		}
+		else
+		{
+			control[found] = CONTROL_DELETED;
+			deleted++;
+		}
+		count--;
+
+		return true;
+	}
+
+	void FixedHashMap::rehash()
+	{
+		swap(control, spareControl);
+		swap(keys, spareKeys);
+		swap(values, spareValues);
+
+		fill(control.begin(), control.end(), CONTROL_EMPTY);
+		count	= 0;
+		deleted = 0;
+
+		for (number i = 0; i < slots; i++)
+		{
+			if (spareControl[i] >= 0)
+			{
+				set(spareKeys[i], spareValues[i]);
+			}
+		}
+	}
+
+	void FixedHashMap::clear()
+	{
+		fill(control.begin(), control.end(), CONTROL_EMPTY);
+		count	= 0;
+		deleted = 0;
+	}
+
+	number FixedHashMap::size() const
+	{
+		return count;
+	}
+
+	number FixedHashMap::memoryUsage() const
+	{
+		return (control.capacity() + spareControl.capacity()) * sizeof(signed char) +
+			   (keys.capacity() + spareKeys.capacity() + values.capacity() + spareValues.capacity()) * sizeof(number);
+	}
+
+	BlockHandle::BlockHandle(BlockArena *arena, uchar *chunk) :
+		arena(arena),
+		chunk(chunk)
+	{
+	}
+
+	BlockHandle::BlockHandle(BlockHandle &&other) noexcept :
+		arena(other.arena),
+		chunk(other.chunk)
+	{
+		other.arena = nullptr;
+		other.chunk = nullptr;
+	}
+
+	BlockHandle &BlockHandle::operator=(BlockHandle &&other) noexcept
+	{
+		if (this != &other)
+		{
+			reset();
+			arena		= other.arena;
+			chunk		= other.chunk;
+			other.arena = nullptr;
+			other.chunk = nullptr;
+		}
+		return *this;
+	}
+
+	BlockHandle::~BlockHandle()
+	{
+		reset();
+	}
+
+	uchar *BlockHandle::data() const
+	{
+		return chunk;
+	}
+
+	number BlockHandle::size() const
+	{
+		return arena != nullptr ? arena->chunkSize() : 0;
+	}
+
+	void BlockHandle::assign(const uchar *data, const number size)
+	{
+#if INPUT_CHECKS
+		if (size > this->size())
+		{
+			throw Exception(boost::format("data of size %1% is too long for a block of %2% bytes") % size % this->size());
+		}
+#endif
+		copy(data, data + size, chunk);
+		fill(chunk + size, chunk + this->size(), 0x00);
+	}
+
+	void BlockHandle::reset()
+	{
+		if (arena != nullptr)
+		{
+			arena->release(chunk);
+			arena = nullptr;
+			chunk = nullptr;
+		}
+	}
+
+	BlockArena::BlockArena(const number blockSize, const number slabSize) :
+		blockSize(blockSize),
+		slabSize(max(slabSize, 1uLL))
+	{
+	}
+
+	BlockHandle BlockArena::allocate()
+	{
+		if (freeChunks.empty())
+		{
+			slabs.push_back(make_unique<uchar[]>(slabSize * blockSize));
+			freeChunks.reserve(slabs.size() * slabSize);
+			for (number i = slabSize; i > 0; i--)
+			{
+				freeChunks.push_back(slabs.back().get() + (i - 1) * blockSize);
+			}
+		}
+
+		const auto chunk = freeChunks.back();
+		freeChunks.pop_back();
+		return BlockHandle(this, chunk);
+	}
+
+	void BlockArena::release(uchar *chunk)
+	{
+		freeChunks.push_back(chunk);
+	}
+
+	number BlockArena::chunkSize() const
+	{
+		return blockSize;
+	}
+
+	number BlockArena::capacity() const
+	{
+		return slabs.size() * slabSize;
+	}
+
+	number BlockArena::available() const
+	{
+		return freeChunks.size();
+	}
+
+	number BlockArena::memoryUsage() const
+	{
+		return capacity() * blockSize + slabs.capacity() * sizeof(unique_ptr<uchar[]>) + freeChunks.capacity() * sizeof(uchar *);
+	}
 }
@@ -0,0 +1,147 @@
+#include "concurrent-oram.hpp"
+#include "definitions.h"
+#include "utility.hpp"
+
+#include "gtest/gtest.h"
+
+using namespace std;
+
+namespace PathORAM
+{
+	class ConcurrentORAMTest : public ::testing::Test
+	{
+		public:
+		inline static const number LOG_CAPACITY = 5;
+		inline static const number Z			= 3;
+		inline static const number CAPACITY	= (1 << LOG_CAPACITY);
+		inline static const number BLOCK_SIZE	= 32;
+		inline static const number BATCH_SIZE	= 8;
+		inline static const number THREADS		= 4;
+
+		protected:
+		unique_ptr<ConcurrentORAM> oram;
+
+		ConcurrentORAMTest()
+		{
+			auto inner = make_shared<ORAM>(
+				LOG_CAPACITY,
+				BLOCK_SIZE,
+				Z,
+				make_shared<InMemoryStorageAdapter>(CAPACITY + Z, BLOCK_SIZE, bytes(), Z),
+				make_shared<InMemoryPositionMapAdapter>(CAPACITY * Z + Z),
+				make_shared<InMemoryStashAdapter>(3 * LOG_CAPACITY * Z + BATCH_SIZE),
+				true,
+				BATCH_SIZE);
+
+			oram = make_unique<ConcurrentORAM>(inner, BATCH_SIZE);
+		}
+	};
+
+	TEST_F(ConcurrentORAMTest, GetPutSame)
+	{
+		auto data = fromText("hello", BLOCK_SIZE);
+		EXPECT_EQ(data, oram->put(5, data).get());
+		EXPECT_EQ(data, oram->get(5).get());
+
+		// never written
+		EXPECT_EQ(0, oram->get(6).get().size());
+	}
+
+	TEST_F(ConcurrentORAMTest, PutEmpty)
+	{
+		ASSERT_ANY_THROW(oram->put(5, bytes()));
+	}
+
+	TEST_F(ConcurrentORAMTest, ManyThreads)
+	{
+		const auto perThread = CAPACITY / THREADS;
+
+		vector<thread> threads;
+		for (number t = 0; t < THREADS; t++)
+		{
+			threads.push_back(thread([this, t, perThread]() {
+				vector<future<bytes>> puts;
+				for (number id = t * perThread; id < (t + 1) * perThread; id++)
+				{
+					puts.push_back(oram->put(id, fromText(to_string(id), BLOCK_SIZE)));
+				}
+				for (auto &&put : puts)
+				{
+					put.wait();
+				}
+
+				for (number id = t * perThread; id < (t + 1) * perThread; id++)
+				{
+					EXPECT_EQ(to_string(id), toText(oram->get(id).get(), BLOCK_SIZE));
+				}
+			}));
+		}
+
+		for (auto &&thread : threads)
+		{
+			thread.join();
+		}
+
+		// some requests shared a batch
+		EXPECT_GT(CAPACITY * 2, oram->dispatchedBatches());
+	}
+
+	TEST_F(ConcurrentORAMTest, FullBatchBeforeDeadline)
+	{
+		auto inner = make_shared<ORAM>(
+			LOG_CAPACITY,
+			BLOCK_SIZE,
+			Z,
+			make_shared<InMemoryStorageAdapter>(CAPACITY + Z, BLOCK_SIZE, bytes(), Z),
+			make_shared<InMemoryPositionMapAdapter>(CAPACITY * Z + Z),
+			make_shared<InMemoryStashAdapter>(3 * LOG_CAPACITY * Z + BATCH_SIZE),
+			true,
+			BATCH_SIZE);
+
+		// the deadline is never reached, the batch is dispatched because it is full
+		auto slow = make_unique<ConcurrentORAM>(inner, BATCH_SIZE, chrono::hours(1));
+
+		vector<future<bytes>> results;
+		for (number id = 0; id < BATCH_SIZE; id++)
+		{
+			results.push_back(slow->put(id, fromText(to_string(id), BLOCK_SIZE)));
+		}
+		for (number id = 0; id < BATCH_SIZE; id++)
+		{
+			EXPECT_EQ(to_string(id), toText(results[id].get(), BLOCK_SIZE));
+		}
+		EXPECT_EQ(1, slow->dispatchedBatches());
+	}
+
+	TEST_F(ConcurrentORAMTest, DrainOnDestruction)
+	{
+		future<bytes> result;
+		{
+			auto inner = make_shared<ORAM>(LOG_CAPACITY, BLOCK_SIZE, Z);
+			auto slow  = make_unique<ConcurrentORAM>(inner, BATCH_SIZE, chrono::hours(1));
+			result	   = slow->get(1);
+		}
+		EXPECT_EQ(0, result.get().size());
+	}
+
+	TEST_F(ConcurrentORAMTest, ErrorPropagates)
+	{
+		// the ORAM batch size is too small for the front end
+		auto inner	= make_shared<ORAM>(LOG_CAPACITY, BLOCK_SIZE, Z);
+		auto broken = make_unique<ConcurrentORAM>(inner, 2, chrono::hours(1));
+
+		auto first	= broken->get(1);
+		auto second = broken->get(2);
+
+		ASSERT_ANY_THROW(first.get());
+		ASSERT_ANY_THROW(second.get());
+	}
+}
+
+int main(int argc, char **argv)
+{
+	srand(TEST_SEED);
+
+	::testing::InitGoogleTest(&argc, argv);
+	return RUN_ALL_TESTS();
+}
@@ -0,0 +1,171 @@
+#include "definitions.h"
+#include "fixed-oram.hpp"
+#include "oram.hpp"
+#include "utility.hpp"
+
+#include "gtest/gtest.h"
+#include <unordered_map>
+
+using namespace std;
+
+namespace PathORAM
+{
+	class FixedORAMTest : public ::testing::Test
+	{
+		public:
+		inline static const number LOG_CAPACITY = 5;
+		inline static const number Z			= 3;
+		inline static const number BLOCK_SIZE	= 32;
+
+		inline static const number CAPACITY = (1 << LOG_CAPACITY);
+
+		using TestingORAM = FixedORAM<Z, BLOCK_SIZE>;
+
+		protected:
+		unique_ptr<TestingORAM> oram = make_unique<TestingORAM>(LOG_CAPACITY);
+
+		static TestingORAM::payload fromString(const string &text)
+		{
+			TestingORAM::payload result;
+			const auto data = fromText(text, BLOCK_SIZE);
+			copy(data.begin(), data.end(), result.begin());
+			return result;
+		}
+	};
+
+	TEST_F(FixedORAMTest, GetPutSame)
+	{
+		const auto data = fromString("hello");
+		oram->put(CAPACITY - 1, data);
+
+		TestingORAM::payload returned;
+		oram->get(CAPACITY - 1, returned);
+		EXPECT_EQ(data, returned);
+	}
+
+	TEST_F(FixedORAMTest, GetNotWritten)
+	{
+		TestingORAM::payload returned;
+		returned.fill(0xff);
+		oram->get(0, returned);
+
+		TestingORAM::payload zeroes;
+		zeroes.fill(0x00);
+		EXPECT_EQ(zeroes, returned);
+	}
+
+	TEST_F(FixedORAMTest, RandomOperations)
+	{
+		unordered_map<number, TestingORAM::payload> expected;
+		for (number i = 0; i < CAPACITY * 20; i++)
+		{
+			const auto id = getRandomULong(CAPACITY);
+			if (getRandomUInt(2) == 0)
+			{
+				expected[id] = fromString(to_string(i));
+				oram->put(id, expected[id]);
+			}
+			else if (expected.count(id) > 0)
+			{
+				TestingORAM::payload returned;
+				oram->get(id, returned);
+				EXPECT_EQ(expected[id], returned);
+			}
+		}
+
+		EXPECT_GT(3 * LOG_CAPACITY * Z, oram->stashSize());
+	}
+
+	TEST_F(FixedORAMTest, SameStorageAsORAM)
+	{
+		// FixedORAM writes the same storage format as ORAM
+		auto storage = make_shared<InMemoryStorageAdapter>(CAPACITY, BLOCK_SIZE, bytes(), Z);
+		auto map	 = make_shared<InMemoryPositionMapAdapter>(CAPACITY * Z + Z);
+
+		auto fixed = make_unique<TestingORAM>(LOG_CAPACITY, storage, map, 3 * LOG_CAPACITY * Z);
+		for (number id = 0; id < CAPACITY; id++)
+		{
+			fixed->put(id, fromString(to_string(id)));
+		}
+		// all blocks must have been evicted to storage
+		ASSERT_EQ(0, fixed->stashSize());
+
+		auto dynamic = make_unique<ORAM>(LOG_CAPACITY, BLOCK_SIZE, Z, storage, map, make_shared<InMemoryStashAdapter>(3 * LOG_CAPACITY * Z), false);
+		for (number id = 0; id < CAPACITY; id++)
+		{
+			bytes returned;
+			dynamic->get(id, returned);
+			EXPECT_EQ(to_string(id), toText(returned, BLOCK_SIZE));
+		}
+	}
+
+	TEST_F(FixedORAMTest, WrongStorageBlockSize)
+	{
+		auto storage = make_shared<InMemoryStorageAdapter>(CAPACITY, BLOCK_SIZE * 2, bytes(), Z);
+		auto map	 = make_shared<InMemoryPositionMapAdapter>(CAPACITY * Z + Z);
+
+		ASSERT_ANY_THROW(make_unique<TestingORAM>(LOG_CAPACITY, storage, map, 3 * LOG_CAPACITY * Z));
+	}
+
+	TEST_F(FixedORAMTest, WrongStorageZ)
+	{
+		auto storage = make_shared<InMemoryStorageAdapter>(CAPACITY, BLOCK_SIZE, bytes(), Z + 1);
+		auto map	 = make_shared<InMemoryPositionMapAdapter>(CAPACITY * Z + Z);
+
+		ASSERT_ANY_THROW(make_unique<TestingORAM>(LOG_CAPACITY, storage, map, 3 * LOG_CAPACITY * Z));
+	}
+
+	TEST_F(FixedORAMTest, StashOverflow)
+	{
+		auto storage = make_shared<InMemoryStorageAdapter>(CAPACITY, BLOCK_SIZE, bytes(), Z);
+		auto map	 = make_shared<InMemoryPositionMapAdapter>(CAPACITY * Z + Z);
+
+		// a stash of one block cannot hold a path
+		auto fixed = make_unique<TestingORAM>(LOG_CAPACITY, storage, map, 1);
+		ASSERT_ANY_THROW({
+			for (number id = 0; id < CAPACITY * Z; id++)
+			{
+				fixed->put(id, fromString(to_string(id)));
+			}
+		});
+
+		// the check does not depend on INPUT_CHECKS, the stash never grows past its capacity
+		const number capacity = 4;
+		auto small			  = make_unique<FixedORAM<3, 32>>(LOG_CAPACITY, storage, map, capacity);
+		EXPECT_THROW(
+			{
+				for (number id = 0; id < CAPACITY * Z; id++)
+				{
+					small->put(id, fromString(to_string(id)));
+					ASSERT_GE(capacity, small->stashSize());
+				}
+			},
+			Exception);
+		EXPECT_GE(capacity, small->stashSize());
+	}
+
+	TEST_F(FixedORAMTest, LargeBlocks)
+	{
+		using LargeORAM = FixedORAM<4, 4096>;
+		auto large		= make_unique<LargeORAM>(LOG_CAPACITY);
+
+		LargeORAM::payload data;
+		for (number i = 0; i < data.size(); i++)
+		{
+			data[i] = (uchar)i;
+		}
+		large->put(1, data);
+
+		LargeORAM::payload returned;
+		large->get(1, returned);
+		EXPECT_EQ(data, returned);
+	}
+}
+
+int main(int argc, char **argv)
+{
+	srand(TEST_SEED);
+
+	::testing::InitGoogleTest(&argc, argv);
+	return RUN_ALL_TESTS();
+}
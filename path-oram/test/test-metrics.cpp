@@ -0,0 +1,115 @@
+#include "definitions.h"
+#include "metrics.hpp"
+
+#include "gtest/gtest.h"
+#include <thread>
+
+using namespace std;
+
+namespace PathORAM
+{
+	class MetricsTest : public ::testing::Test
+	{
+	};
+
+	TEST_F(MetricsTest, BucketBounds)
+	{
+		for (number value : {0uLL, 1uLL, 7uLL, 8uLL, 9uLL, 15uLL, 16uLL, 100uLL, 1000uLL, 123456789uLL, ULLONG_MAX})
+		{
+			const auto bucket = Histogram::bucket(value);
+			ASSERT_LT(bucket, Histogram::BUCKETS);
+			EXPECT_LE(Histogram::lowerBound(bucket), value);
+			if (bucket + 1 < Histogram::BUCKETS)
+			{
+				EXPECT_GT(Histogram::lowerBound(bucket + 1), value);
+			}
+		}
+
+		// small values are exact
+		for (number value = 0; value < Histogram::SUB_BUCKETS * 2; value++)
+		{
+			EXPECT_EQ(value, Histogram::lowerBound(Histogram::bucket(value)));
+		}
+	}
+
+	TEST_F(MetricsTest, BucketsMonotone)
+	{
+		for (number bucket = 1; bucket < Histogram::BUCKETS; bucket++)
+		{
+			EXPECT_LT(Histogram::lowerBound(bucket - 1), Histogram::lowerBound(bucket));
+			EXPECT_EQ(bucket, Histogram::bucket(Histogram::lowerBound(bucket)));
+		}
+	}
+
+	TEST_F(MetricsTest, Percentiles)
+	{
+		Histogram histogram;
+		for (number value = 1; value <= 1000; value++)
+		{
+			histogram.record(value);
+		}
+
+		const auto snapshot = histogram.snapshot();
+		EXPECT_EQ(1000, snapshot.count);
+		EXPECT_EQ(500500, snapshot.sum);
+		EXPECT_EQ(1000, snapshot.max);
+		EXPECT_DOUBLE_EQ(500.5, snapshot.mean());
+
+		// within the bucket error
+		for (auto &&[quantile, expected] : vector<pair<double, number>>{{0.5, 500}, {0.99, 990}, {0.999, 999}})
+		{
+			const auto estimate = snapshot.percentile(quantile);
+			EXPECT_LE(estimate, expected);
+			EXPECT_GE(estimate, expected - expected / Histogram::SUB_BUCKETS);
+		}
+
+		histogram.reset();
+		EXPECT_EQ(0, histogram.snapshot().count);
+		EXPECT_EQ(0, histogram.snapshot().percentile(0.5));
+	}
+
+	TEST_F(MetricsTest, ConcurrentRecording)
+	{
+		StorageMetrics metrics;
+		const auto threads = 4uLL, calls = 10000uLL;
+
+		vector<thread> workers;
+		for (number t = 0; t < threads; t++)
+		{
+			workers.push_back(thread([&metrics, t]() {
+				for (number i = 0; i < calls; i++)
+				{
+					metrics.recordRead(2, 100, i);
+					metrics.recordWrite(1, 50, t);
+				}
+			}));
+		}
+		for (auto &&worker : workers)
+		{
+			worker.join();
+		}
+
+		const auto snapshot = metrics.snapshot();
+		EXPECT_EQ(threads * calls, snapshot.reads);
+		EXPECT_EQ(threads * calls, snapshot.writes);
+		EXPECT_EQ(threads * calls * 2, snapshot.readBuckets);
+		EXPECT_EQ(threads * calls, snapshot.writtenBuckets);
+		EXPECT_EQ(threads * calls * 100, snapshot.readBytes);
+		EXPECT_EQ(threads * calls * 50, snapshot.writtenBytes);
+		EXPECT_EQ(threads * calls, snapshot.readLatency.count);
+		EXPECT_EQ(calls - 1, snapshot.readLatency.max);
+		EXPECT_EQ(threads - 1, snapshot.writeLatency.max);
+		EXPECT_EQ(2, snapshot.readBatch.percentile(0.5));
+
+		metrics.reset();
+		EXPECT_EQ(0, metrics.snapshot().reads);
+	}
+}
+
+int main(int argc, char **argv)
+{
+	srand(TEST_SEED);
+
+	::testing::InitGoogleTest(&argc, argv);
+	return RUN_ALL_TESTS();
+}
@@ -176,6 +176,7 @@ namespace PathORAM
 			{7, 4, 64, StorageAdapterTypeFileSystem, false, false, 1},
 			{7, 4, 64, StorageAdapterTypeFileSystem, true, false, 1},
 			{7, 4, 64, StorageAdapterTypeFileSystem, false, true, 1},
+			{7, 4, 64, StorageAdapterTypeInMemory, true, true, 1},
 			{7, 4, 64, StorageAdapterTypeInMemory, false, true, 10},
 		};
 
@@ -0,0 +1,89 @@
+#include "definitions.h"
+#include "oram-builder.hpp"
+#include "utility.hpp"
+
+#include "gtest/gtest.h"
+
+using namespace std;
+
+namespace PathORAM
+{
+	class ORAMBuilderTest : public ::testing::Test
+	{
+		public:
+		inline static const number CAPACITY	  = 1 << 8;
+		inline static const number BLOCK_SIZE = 64;
+		inline static const number Z		  = 4;
+	};
+
+	TEST_F(ORAMBuilderTest, NoRecursionIfFits)
+	{
+		const auto levels = planRecursiveORAM(CAPACITY, BLOCK_SIZE, Z, 1 << 20);
+
+		ASSERT_EQ(1, levels.size());
+		EXPECT_EQ(BLOCK_SIZE, levels[0].blockSize);
+		EXPECT_EQ(Z, levels[0].Z);
+		EXPECT_LE(CAPACITY * 4, (1uLL << levels[0].logCapacity) * Z * 3);
+	}
+
+	TEST_F(ORAMBuilderTest, RecursionShrinksMemory)
+	{
+		const auto flat = planRecursiveORAM(CAPACITY * 16, BLOCK_SIZE, Z, 1 << 30);
+		ASSERT_EQ(1, flat.size());
+
+		const auto budget = plannedMemoryUsage(flat) / 2;
+		const auto levels = planRecursiveORAM(CAPACITY * 16, BLOCK_SIZE, Z, budget);
+
+		ASSERT_LT(1, levels.size());
+		EXPECT_GE(budget, plannedMemoryUsage(levels));
+		for (auto i = 1uLL; i < levels.size(); i++)
+		{
+			// each level must hold the positions of the previous one
+			const auto positions = levels[i].blockSize / sizeof(number);
+			EXPECT_LE((1uLL << levels[i - 1].logCapacity) * levels[i - 1].Z, (1uLL << levels[i].logCapacity) * levels[i].Z * positions);
+		}
+	}
+
+	TEST_F(ORAMBuilderTest, BudgetTooSmall)
+	{
+		ASSERT_ANY_THROW(planRecursiveORAM(CAPACITY, BLOCK_SIZE, Z, 16));
+	}
+
+	TEST_F(ORAMBuilderTest, BuildAndUse)
+	{
+		const auto flat	  = planRecursiveORAM(CAPACITY * 16, BLOCK_SIZE, Z, 1 << 30);
+		const auto levels = planRecursiveORAM(CAPACITY * 16, BLOCK_SIZE, Z, plannedMemoryUsage(flat) / 2, 2);
+		ASSERT_LT(1, levels.size());
+
+		vector<number> requested;
+		auto oram = buildRecursiveORAM(
+			levels,
+			[&requested](const number level, const number capacity, const number blockSize, const number Z) -> shared_ptr<AbsStorageAdapter> {
+				requested.push_back(level);
+				return make_shared<InMemoryStorageAdapter>(capacity, blockSize, bytes(), Z);
+			});
+
+		// one storage per level
+		EXPECT_EQ(levels.size(), requested.size());
+
+		for (number id = 0; id < CAPACITY; id++)
+		{
+			oram->put(id, fromText(to_string(id), BLOCK_SIZE));
+		}
+
+		for (number id = 0; id < CAPACITY; id++)
+		{
+			bytes returned;
+			oram->get(id, returned);
+			EXPECT_EQ(to_string(id), toText(returned, BLOCK_SIZE));
+		}
+	}
+}
+
+int main(int argc, char **argv)
+{
+	srand(TEST_SEED);
+
+	::testing::InitGoogleTest(&argc, argv);
+	return RUN_ALL_TESTS();
+}
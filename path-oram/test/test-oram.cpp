@@ -4,6 +4,8 @@
 
 #include "gmock/gmock.h"
 #include "gtest/gtest.h"
+#include <map>
+#include <openssl/aes.h>
 
 using namespace std;
 
@@ -156,7 +158,7 @@ namespace PathORAM
 		stash->getAll(stashDump);
 		EXPECT_EQ(0, stashDump.size());
 
-		unordered_set<number> path;
+		vector<number> path;
 		oram->readPath(10uLL, path, true);
 
 		stashDump.clear();
@@ -175,6 +177,30 @@ namespace PathORAM
 		}
 	}
 
+	TEST_F(ORAMTest, ReadPathServesWanted)
+	{
+		for (number i = 0; i < CAPACITY; i++)
+		{
+			bucket bucket;
+			for (auto j = 0uLL; j < Z; j++)
+			{
+				bucket.push_back({i * Z + j, fromText(to_string(i * Z + j), BLOCK_SIZE)});
+			}
+			storage->set(i, bucket);
+		}
+
+		// the block is on the path of leaf 10 (bucket 13), it is copied from the path and also put in the stash
+		uchar response[BLOCK_SIZE];
+		vector<number> path;
+		EXPECT_TRUE(oram->readPath(10uLL, path, true, 13 * Z + 1, response));
+		EXPECT_EQ(to_string(13 * Z + 1), toText(bytes(response, response + BLOCK_SIZE), BLOCK_SIZE));
+		EXPECT_EQ(LOG_CAPACITY * Z, stash->currentSize());
+
+		// the block is not on the path
+		path.clear();
+		EXPECT_FALSE(oram->readPath(10uLL, path, false, 2 * Z, response));
+	}
+
 	TEST_F(ORAMTest, GetNoException)
 	{
 		bytes got;
@@ -250,6 +276,272 @@ namespace PathORAM
 		}
 	}
 
+	TEST_F(ORAMTest, SparseIDs)
+	{
+		auto oram = make_unique<ORAM>(LOG_CAPACITY, BLOCK_SIZE, Z, storage, make_shared<SparsePositionMapAdapter>(CAPACITY * Z), stash);
+
+		const auto id = [](number i) { return hashToNumber(fromText(to_string(i), BLOCK_SIZE), ULLONG_MAX - 1); };
+
+		for (number i = 0; i < CAPACITY; i++)
+		{
+			oram->put(id(i), fromText(to_string(i), BLOCK_SIZE));
+		}
+
+		for (number i = 0; i < CAPACITY; i++)
+		{
+			bytes returned;
+			oram->get(id(i), returned);
+			EXPECT_EQ(to_string(i), toText(returned, BLOCK_SIZE));
+		}
+	}
+
+	TEST_F(ORAMTest, SlabStash)
+	{
+		auto oram = make_unique<ORAM>(LOG_CAPACITY, BLOCK_SIZE, Z, storage, make_shared<InMemoryPositionMapAdapter>(CAPACITY * Z + Z), make_shared<SlabStashAdapter>(3 * LOG_CAPACITY * Z, BLOCK_SIZE));
+
+		for (number i = 0; i < CAPACITY; i++)
+		{
+			oram->put(i, fromText(to_string(i), BLOCK_SIZE));
+		}
+
+		for (number i = 0; i < CAPACITY; i++)
+		{
+			bytes returned;
+			oram->get(i, returned);
+			EXPECT_EQ(to_string(i), toText(returned, BLOCK_SIZE));
+		}
+	}
+
+	TEST_F(ORAMTest, LeafStash)
+	{
+		auto stash = make_shared<LeafStashAdapter>(3 * LOG_CAPACITY * Z, BLOCK_SIZE, LOG_CAPACITY);
+		auto oram  = make_unique<ORAM>(LOG_CAPACITY, BLOCK_SIZE, Z, storage, make_shared<InMemoryPositionMapAdapter>(CAPACITY * Z + Z), stash, true, BATCH_SIZE);
+
+		unordered_map<number, string> expected;
+		for (number i = 0; i < CAPACITY * 10; i++)
+		{
+			const auto id = getRandomULong(CAPACITY);
+			if (getRandomUInt(2) == 0)
+			{
+				expected[id] = to_string(i);
+				oram->put(id, fromText(expected[id], BLOCK_SIZE));
+			}
+			else
+			{
+				bytes returned;
+				oram->get(id, returned);
+				EXPECT_EQ(expected.count(id) > 0 ? expected[id] : "", toText(returned, BLOCK_SIZE));
+			}
+		}
+
+		// eviction keeps the stash from filling up
+		EXPECT_GT(3 * LOG_CAPACITY * Z, stash->currentSize());
+	}
+
+	TEST_F(ORAMTest, StashOccupancy)
+	{
+		const auto RUNS = CAPACITY * 4;
+		for (number i = 0; i < RUNS; i++)
+		{
+			oram->put(i % CAPACITY, fromText(to_string(i), BLOCK_SIZE));
+		}
+
+		const auto occupancy = oram->stashOccupancy();
+		EXPECT_EQ(RUNS, occupancy.accesses);
+		EXPECT_EQ(0, occupancy.dummyAccesses);
+		EXPECT_EQ(dynamic_pointer_cast<InMemoryStashAdapter>(stash)->currentSize(), occupancy.current);
+		EXPECT_LE(occupancy.current, occupancy.max);
+		ASSERT_EQ(occupancy.max + 1, occupancy.histogram.size());
+
+		number samples = 0;
+		for (auto &&count : occupancy.histogram)
+		{
+			samples += count;
+		}
+		EXPECT_EQ(RUNS, samples);
+	}
+
+	TEST_F(ORAMTest, BackgroundEviction)
+	{
+		const auto WATERMARK = 2uLL;
+		oram->setBackgroundEviction(WATERMARK, 1000);
+
+		for (number i = 0; i < CAPACITY * 4; i++)
+		{
+			oram->put(i % CAPACITY, fromText(to_string(i), BLOCK_SIZE));
+			EXPECT_GT(WATERMARK, stash->currentSize());
+		}
+
+		for (number i = 0; i < CAPACITY; i++)
+		{
+			bytes returned;
+			oram->get(i, returned);
+			EXPECT_EQ(to_string(CAPACITY * 3 + i), toText(returned, BLOCK_SIZE));
+		}
+
+		const auto occupancy = oram->stashOccupancy();
+		EXPECT_LT(0, occupancy.dummyAccesses);
+		EXPECT_GT(WATERMARK, occupancy.max);
+	}
+
+	TEST_F(ORAMTest, PhaseTimers)
+	{
+		oram->put(1, fromText("1", BLOCK_SIZE));
+
+		map<ORAMPhase, number> events;
+		auto connection = oram->subscribe([&events](const ORAMPhase phase, const number elapsed) -> void { events[phase]++; });
+
+		bytes returned;
+		oram->get(1, returned);
+
+		for (auto &&phase : {PHASE_POSITION_MAP, PHASE_PATH_READ, PHASE_DECRYPT, PHASE_STASH, PHASE_EVICT, PHASE_ENCRYPT, PHASE_WRITE_BACK})
+		{
+			EXPECT_LT(0, events[phase]);
+		}
+
+		// no subscribers, no events
+		connection.disconnect();
+		events.clear();
+		oram->get(1, returned);
+		EXPECT_EQ(0, events.size());
+	}
+
+	TEST_F(ORAMTest, AccessStats)
+	{
+		AccessStats stats;
+		oram->put(1, fromText("1", BLOCK_SIZE), &stats);
+
+		// one path read and written
+		EXPECT_EQ(LOG_CAPACITY, stats.bucketsRead);
+		EXPECT_EQ(LOG_CAPACITY, stats.bucketsWritten);
+		EXPECT_LT(0, stats.bytesRead);
+		EXPECT_EQ(stats.bytesRead, stats.bytesWritten);
+		EXPECT_LE(2, stats.storageCalls);
+		EXPECT_EQ(0, stats.cacheHits);
+		EXPECT_EQ(0, stats.recursiveAccesses);
+		EXPECT_EQ(oram->stashOccupancy().current, stats.stashSize);
+
+		// the paths of a batch are downloaded at once, then the accesses hit the cache
+		vector<block> batch;
+		for (number id = 0; id < BATCH_SIZE; id++)
+		{
+			batch.push_back({id, bytes()});
+		}
+		vector<bytes> response;
+		AccessStats batchStats;
+		oram->multiple(batch, response, &batchStats);
+
+		EXPECT_GE(BATCH_SIZE * LOG_CAPACITY, batchStats.bucketsRead);
+		EXPECT_EQ(batchStats.bucketsRead, batchStats.bucketsWritten);
+		EXPECT_EQ(BATCH_SIZE * LOG_CAPACITY, batchStats.cacheHits);
+
+		// no stats requested, nothing changes
+		bytes returned;
+		oram->get(1, returned);
+		EXPECT_EQ(BATCH_SIZE * LOG_CAPACITY, batchStats.cacheHits);
+	}
+
+	TEST_F(ORAMTest, AccessStatsRecursive)
+	{
+		// the position map is itself an ORAM (with an in-memory map)
+		const auto mapLogCapacity = LOG_CAPACITY - 1;
+		auto mapStorage			  = make_shared<InMemoryStorageAdapter>((1 << mapLogCapacity) + Z, BLOCK_SIZE, bytes(), Z);
+		auto mapORAM			  = make_shared<ORAM>(
+			 mapLogCapacity,
+			 BLOCK_SIZE,
+			 Z,
+			 mapStorage,
+			 make_shared<InMemoryPositionMapAdapter>(((1 << mapLogCapacity) * Z) + Z),
+			 make_shared<InMemoryStashAdapter>(3 * mapLogCapacity * Z));
+		auto oram = make_unique<ORAM>(LOG_CAPACITY, BLOCK_SIZE, Z, storage, make_shared<ORAMPositionMapAdapter>(mapORAM), stash);
+
+		AccessStats stats;
+		bytes returned;
+		oram->get(1, returned, &stats);
+
+		// get then set of the position, each one access to the map ORAM
+		EXPECT_EQ(2, stats.recursiveAccesses);
+		EXPECT_EQ(LOG_CAPACITY + 2 * mapLogCapacity, stats.bucketsRead);
+		EXPECT_EQ(LOG_CAPACITY + 2 * mapLogCapacity, stats.bucketsWritten);
+		EXPECT_EQ(oram->stashOccupancy().current, stats.stashSize);
+	}
+
+	TEST_F(ORAMTest, AccessStatsThrow)
+	{
+		const auto mapLogCapacity = LOG_CAPACITY - 1;
+		auto mapORAM			  = make_shared<ORAM>(
+			 mapLogCapacity,
+			 BLOCK_SIZE,
+			 Z,
+			 make_shared<InMemoryStorageAdapter>((1 << mapLogCapacity) + Z, BLOCK_SIZE, bytes(), Z),
+			 make_shared<InMemoryPositionMapAdapter>(((1 << mapLogCapacity) * Z) + Z),
+			 make_shared<InMemoryStashAdapter>(3 * mapLogCapacity * Z));
+		auto map  = make_shared<ORAMPositionMapAdapter>(mapORAM);
+		auto oram = make_unique<ORAM>(LOG_CAPACITY, BLOCK_SIZE, Z, storage, map, stash);
+
+		// the ID is out of range for the position map ORAM, so the call throws from the nested access
+		{
+			AccessStats stats;
+			bytes returned;
+			EXPECT_THROW(oram->get(1uLL << 40, returned, &stats), Exception);
+		}
+
+		// the stats object is gone, nothing may still point to it
+		EXPECT_EQ(nullptr, oram->stats);
+		EXPECT_EQ(nullptr, map->stats);
+		EXPECT_EQ(nullptr, mapORAM->stats);
+
+		AccessStats stats;
+		bytes returned;
+		oram->get(1, returned, &stats);
+		EXPECT_EQ(2, stats.recursiveAccesses);
+		EXPECT_EQ(nullptr, oram->stats);
+		EXPECT_EQ(nullptr, map->stats);
+	}
+
+	TEST_F(ORAMTest, MemoryUsage)
+	{
+		const auto empty = oram->memoryUsage();
+
+		// all buckets are held in memory
+		EXPECT_LE((CAPACITY + Z) * (Z * (BLOCK_SIZE + AES_BLOCK_SIZE) + AES_BLOCK_SIZE), empty.storage);
+		EXPECT_EQ((CAPACITY * Z + Z) * sizeof(number), empty.positionMap);
+		EXPECT_EQ(0, empty.recursive);
+		EXPECT_EQ(empty.storage + empty.positionMap + empty.stash + empty.cache, empty.total());
+
+		for (number id = 0; id < CAPACITY; id++)
+		{
+			oram->put(id, fromText(to_string(id), BLOCK_SIZE));
+		}
+
+		// the cache is emptied after a call, but the arena is kept
+		const auto used = oram->memoryUsage();
+		EXPECT_EQ(empty.storage, used.storage);
+		EXPECT_LT(0, used.cache);
+		EXPECT_LE(oram->stashOccupancy().current * BLOCK_SIZE, used.stash);
+	}
+
+	TEST_F(ORAMTest, MemoryUsageRecursive)
+	{
+		const auto mapLogCapacity = LOG_CAPACITY - 1;
+		auto mapORAM			  = make_shared<ORAM>(
+			 mapLogCapacity,
+			 BLOCK_SIZE,
+			 Z,
+			 make_shared<InMemoryStorageAdapter>((1 << mapLogCapacity) + Z, BLOCK_SIZE, bytes(), Z),
+			 make_shared<InMemoryPositionMapAdapter>(((1 << mapLogCapacity) * Z) + Z),
+			 make_shared<InMemoryStashAdapter>(3 * mapLogCapacity * Z));
+		auto oram = make_unique<ORAM>(LOG_CAPACITY, BLOCK_SIZE, Z, storage, make_shared<ORAMPositionMapAdapter>(mapORAM, 2), stash);
+
+		bytes returned;
+		oram->get(1, returned);
+
+		// the map ORAM is reported as recursive, the PLB as the position map
+		const auto usage = oram->memoryUsage();
+		EXPECT_EQ(mapORAM->memoryUsage().total(), usage.recursive);
+		EXPECT_LT(0, usage.positionMap);
+	}
+
 	TEST_F(ORAMTest, MultipleTooManyRequests)
 	{
 		vector<block> batch;
@@ -355,6 +647,141 @@ namespace PathORAM
 		}
 	}
 
+	TEST_F(ORAMTest, MultipleDuplicates)
+	{
+		oram->put(1, fromText("1", BLOCK_SIZE));
+		oram->put(2, fromText("2", BLOCK_SIZE));
+		const auto before = oram->stashOccupancy().accesses;
+
+		const vector<block> batch = {
+			{1, bytes()},
+			{1, fromText("one", BLOCK_SIZE)},
+			{2, bytes()},
+			{1, bytes()},
+			{1, fromText("uno", BLOCK_SIZE)},
+			{3, bytes()},
+			{3, bytes()},
+		};
+		ASSERT_GE(BATCH_SIZE, batch.size());
+
+		vector<bytes> response;
+		oram->multiple(batch, response);
+
+		ASSERT_EQ(batch.size(), response.size());
+		EXPECT_EQ("1", toText(response[0], BLOCK_SIZE));
+		EXPECT_EQ("one", toText(response[1], BLOCK_SIZE));
+		EXPECT_EQ("2", toText(response[2], BLOCK_SIZE));
+		EXPECT_EQ("one", toText(response[3], BLOCK_SIZE));
+		EXPECT_EQ("uno", toText(response[4], BLOCK_SIZE));
+		EXPECT_EQ(0, response[5].size());
+		EXPECT_EQ(0, response[6].size());
+
+		// one access (real or dummy) per request
+		EXPECT_EQ(before + batch.size(), oram->stashOccupancy().accesses);
+
+		bytes returned;
+		oram->get(1, returned);
+		EXPECT_EQ("uno", toText(returned, BLOCK_SIZE));
+		returned.clear();
+		oram->get(2, returned);
+		EXPECT_EQ("2", toText(returned, BLOCK_SIZE));
+	}
+
+	TEST_F(ORAMTest, MultipleDuplicatesBuffer)
+	{
+		oram->put(1, fromText("1", BLOCK_SIZE));
+
+		vector<block> batch = {
+			{1, fromText("one", BLOCK_SIZE)},
+			{1, bytes()},
+			{2, bytes()},
+			{1, fromText("uno", BLOCK_SIZE)},
+			{2, bytes()},
+			{1, bytes()},
+		};
+		const auto count = batch.size();
+		ASSERT_GE(BATCH_SIZE, count);
+
+		vector<uchar> buffer(count * BLOCK_SIZE, 0x25);
+		oram->multiple(move(batch), buffer.data());
+
+		const auto answer = [&buffer](const number i) { return toText(bytes(buffer.begin() + i * BLOCK_SIZE, buffer.begin() + (i + 1) * BLOCK_SIZE), BLOCK_SIZE); };
+		EXPECT_EQ("one", answer(0));
+		EXPECT_EQ("one", answer(1));
+		EXPECT_EQ(bytes(BLOCK_SIZE, 0x00), bytes(buffer.begin() + 2 * BLOCK_SIZE, buffer.begin() + 3 * BLOCK_SIZE));
+		EXPECT_EQ("uno", answer(3));
+		EXPECT_EQ(bytes(BLOCK_SIZE, 0x00), bytes(buffer.begin() + 4 * BLOCK_SIZE, buffer.begin() + 5 * BLOCK_SIZE));
+		EXPECT_EQ("uno", answer(5));
+
+		bytes returned;
+		oram->get(1, returned);
+		EXPECT_EQ("uno", toText(returned, BLOCK_SIZE));
+	}
+
+	TEST_F(ORAMTest, GetPutBuffer)
+	{
+		for (number id = 0; id < CAPACITY; id++)
+		{
+			oram->put(id, fromText(to_string(id), BLOCK_SIZE));
+		}
+
+		uchar buffer[BLOCK_SIZE];
+		for (number id = 0; id < CAPACITY; id++)
+		{
+			ASSERT_EQ(BLOCK_SIZE, oram->get(id, buffer));
+			EXPECT_EQ(to_string(id), toText(bytes(buffer, buffer + BLOCK_SIZE), BLOCK_SIZE));
+		}
+
+		// never written
+		buffer[0] = 0x25;
+		ASSERT_EQ(0, oram->get(CAPACITY + 1, buffer));
+		EXPECT_EQ(bytes(BLOCK_SIZE, 0x00), bytes(buffer, buffer + BLOCK_SIZE));
+
+		ASSERT_ANY_THROW(oram->put(0, bytes(BLOCK_SIZE + 1)));
+	}
+
+	TEST_F(ORAMTest, MultipleBuffer)
+	{
+		const auto count = CAPACITY * Z - 5;
+		vector<uchar> buffer(BATCH_SIZE * BLOCK_SIZE);
+
+		vector<block> batch;
+		for (number id = 0; id < count; id++)
+		{
+			batch.push_back({id, fromText(to_string(id), BLOCK_SIZE)});
+			if (batch.size() == BATCH_SIZE || id == count - 1)
+			{
+				const auto size = batch.size();
+				oram->multiple(move(batch), buffer.data());
+
+				// a PUT is answered with the supplied payload
+				for (number i = 0; i < size; i++)
+				{
+					EXPECT_EQ(to_string(id - size + 1 + i), toText(bytes(buffer.begin() + i * BLOCK_SIZE, buffer.begin() + (i + 1) * BLOCK_SIZE), BLOCK_SIZE));
+				}
+
+				batch.clear();
+			}
+		}
+
+		for (number from = 0; from < count; from += BATCH_SIZE)
+		{
+			for (number id = from; id < min(from + BATCH_SIZE, count); id++)
+			{
+				batch.push_back({id, bytes()});
+			}
+			oram->multiple(move(batch), buffer.data());
+
+			for (number id = from; id < min(from + BATCH_SIZE, count); id++)
+			{
+				const auto answer = buffer.begin() + (id - from) * BLOCK_SIZE;
+				EXPECT_EQ(to_string(id), toText(bytes(answer, answer + BLOCK_SIZE), BLOCK_SIZE));
+			}
+
+			batch.clear();
+		}
+	}
+
 	TEST_F(ORAMTest, BulkLoad)
 	{
 		vector<block> batch;
@@ -373,6 +800,51 @@ namespace PathORAM
 		}
 	}
 
+	TEST_F(ORAMTest, BulkLoadRecursiveRestore)
+	{
+		const auto mapLogCapacity = LOG_CAPACITY - 1;
+		auto mapStash			  = make_shared<InMemoryStashAdapter>(3 * mapLogCapacity * Z);
+		auto mapORAM			  = make_shared<ORAM>(
+			 mapLogCapacity,
+			 BLOCK_SIZE,
+			 Z,
+			 make_shared<InMemoryStorageAdapter>((1 << mapLogCapacity) + Z, BLOCK_SIZE, bytes(), Z),
+			 make_shared<InMemoryPositionMapAdapter>(((1 << mapLogCapacity) * Z) + Z),
+			 mapStash);
+		auto map  = make_shared<ORAMPositionMapAdapter>(mapORAM);
+		auto oram = make_unique<ORAM>(LOG_CAPACITY, BLOCK_SIZE, Z, storage, map, stash);
+
+		// the map ORAM has state of its own before the load (stale positions), some of it in its stash
+		for (number id = 0; id < (1 << mapLogCapacity) * Z && mapStash->currentSize() == 0; id++)
+		{
+			mapORAM->put(id, bytes(BLOCK_SIZE, 0xFF));
+		}
+		ASSERT_LT(0, mapStash->currentSize());
+
+		vector<block> batch;
+		for (number id = 0; id < CAPACITY; id++)
+		{
+			batch.push_back({id, fromText(to_string(id), BLOCK_SIZE)});
+		}
+		oram->load(batch);
+
+		// the map ORAM was reset and rebuilt, none of its blocks is left in its stash
+		EXPECT_EQ(0, mapStash->currentSize());
+
+		// restore: a new ORAM over the same components, without initialization
+		oram = make_unique<ORAM>(LOG_CAPACITY, BLOCK_SIZE, Z, storage, map, stash, false);
+		for (number id = 0; id < CAPACITY; id++)
+		{
+			bytes returned;
+			oram->get(id, returned);
+			EXPECT_EQ(to_string(id), toText(returned, BLOCK_SIZE));
+		}
+
+		// a map that was never initialized does not know the number of leaves
+		auto fresh = make_unique<ORAM>(LOG_CAPACITY, BLOCK_SIZE, Z, storage, make_shared<ORAMPositionMapAdapter>(mapORAM), stash, false);
+		ASSERT_ANY_THROW(fresh->load(batch));
+	}
+
 	TEST_F(ORAMTest, BulkLoadTooMany)
 	{
 		vector<block> batch;
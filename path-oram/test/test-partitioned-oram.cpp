@@ -0,0 +1,190 @@
+#include "definitions.h"
+#include "partitioned-oram.hpp"
+#include "utility.hpp"
+
+#include "gtest/gtest.h"
+
+using namespace std;
+
+namespace PathORAM
+{
+	class PartitionedORAMTest : public ::testing::TestWithParam<tuple<number, number>>
+	{
+		public:
+		inline static const number CAPACITY	  = 1 << 8;
+		inline static const number BLOCK_SIZE = 32;
+		inline static const number Z		  = 3;
+
+		protected:
+		unique_ptr<PartitionedORAM> oram;
+
+		PartitionedORAMTest()
+		{
+			auto [partitions, batchSize] = GetParam();
+			oram						 = make_unique<PartitionedORAM>(CAPACITY, BLOCK_SIZE, Z, partitions, batchSize);
+		}
+	};
+
+	string printTestName(testing::TestParamInfo<tuple<number, number>> input)
+	{
+		auto [partitions, batchSize] = input.param;
+		return boost::str(boost::format("p%1%b%2%") % partitions % batchSize);
+	}
+
+	TEST_P(PartitionedORAMTest, GetPutSame)
+	{
+		auto data = fromText("hello", BLOCK_SIZE);
+		oram->put(5, data);
+
+		bytes returned;
+		oram->get(5, returned);
+		EXPECT_EQ(data, returned);
+
+		// never written
+		returned.clear();
+		oram->get(6, returned);
+		EXPECT_EQ(0, returned.size());
+	}
+
+	TEST_P(PartitionedORAMTest, PutGetMany)
+	{
+		for (number round = 0; round < 2; round++)
+		{
+			for (number id = 0; id < CAPACITY; id++)
+			{
+				oram->put(id, fromText(to_string(id * (round + 1)), BLOCK_SIZE));
+			}
+		}
+
+		for (number id = 0; id < CAPACITY; id++)
+		{
+			bytes returned;
+			oram->get(id, returned);
+			EXPECT_EQ(to_string(id * 2), toText(returned, BLOCK_SIZE));
+		}
+	}
+
+	TEST_P(PartitionedORAMTest, Multiple)
+	{
+		const auto size = 16uLL;
+
+		vector<block> batch;
+		for (number id = 0; id < CAPACITY; id++)
+		{
+			batch.push_back({id, fromText(to_string(id), BLOCK_SIZE)});
+			if (batch.size() == size)
+			{
+				vector<bytes> response;
+				oram->multiple(batch, response);
+				batch.clear();
+			}
+		}
+
+		// mixed, with duplicates
+		batch = {
+			{1, bytes()},
+			{1, fromText("one", BLOCK_SIZE)},
+			{1, bytes()},
+			{2, bytes()},
+			{CAPACITY + 1, bytes()},
+			{2, fromText("two", BLOCK_SIZE)},
+		};
+		vector<bytes> response;
+		oram->multiple(batch, response);
+
+		ASSERT_EQ(batch.size(), response.size());
+		EXPECT_EQ("1", toText(response[0], BLOCK_SIZE));
+		EXPECT_EQ("one", toText(response[1], BLOCK_SIZE));
+		EXPECT_EQ("one", toText(response[2], BLOCK_SIZE));
+		EXPECT_EQ("2", toText(response[3], BLOCK_SIZE));
+		EXPECT_EQ(0, response[4].size());
+		EXPECT_EQ("two", toText(response[5], BLOCK_SIZE));
+
+		bytes returned;
+		oram->get(2, returned);
+		EXPECT_EQ("two", toText(returned, BLOCK_SIZE));
+	}
+
+	TEST_P(PartitionedORAMTest, Reshuffle)
+	{
+		const auto partitions = get<0>(GetParam());
+		if (partitions == 1)
+		{
+			GTEST_SKIP();
+		}
+
+		oram->put(1, fromText("1", BLOCK_SIZE));
+
+		// every access moves the block to a random partition
+		vector<number> visited(partitions, 0);
+		for (number i = 0; i < 20 * partitions; i++)
+		{
+			bytes returned;
+			oram->get(1, returned);
+			visited[oram->locations[1].first]++;
+		}
+
+		for (auto &&count : visited)
+		{
+			EXPECT_LT(0, count);
+		}
+	}
+
+	TEST_P(PartitionedORAMTest, EvictionCache)
+	{
+		const auto partitions = get<0>(GetParam());
+
+		// the block is not written in the call that reads it, it waits in the cache of its new partition
+		oram->put(1, fromText("1", BLOCK_SIZE));
+		for (number i = 0; i < 20 * partitions; i++)
+		{
+			bytes returned;
+			oram->get(1, returned);
+			EXPECT_EQ("1", toText(returned, BLOCK_SIZE));
+
+			const auto [partition, slot] = oram->locations[1];
+			if (oram->evictionCaches[partition].count(1) == 0)
+			{
+				// evicted, the partition holds it
+				bytes stored;
+				oram->partitions[partition]->get(slot, stored);
+				EXPECT_EQ("1", toText(stored, BLOCK_SIZE));
+			}
+		}
+
+		// the evictions drain the caches
+		for (number i = 0; i < 20 * partitions; i++)
+		{
+			bytes returned;
+			oram->get(CAPACITY + 1, returned);
+		}
+		for (auto &&cache : oram->evictionCaches)
+		{
+			EXPECT_EQ(0, cache.size());
+		}
+
+		bytes returned;
+		oram->get(1, returned);
+		EXPECT_EQ("1", toText(returned, BLOCK_SIZE));
+	}
+
+	TEST_P(PartitionedORAMTest, Full)
+	{
+		const auto partitions = get<0>(GetParam());
+		for (number id = 0; id < oram->partitionCapacity * partitions; id++)
+		{
+			oram->put(id, fromText(to_string(id), BLOCK_SIZE));
+		}
+		ASSERT_ANY_THROW(oram->put(CAPACITY * 10, fromText("overflow", BLOCK_SIZE)));
+	}
+
+	INSTANTIATE_TEST_SUITE_P(PartitionedSuite, PartitionedORAMTest, testing::Combine(testing::Values(1, 4), testing::Values(1, 4)), printTestName);
+}
+
+int main(int argc, char **argv)
+{
+	srand(TEST_SEED);
+
+	::testing::InitGoogleTest(&argc, argv);
+	return RUN_ALL_TESTS();
+}
@@ -7,6 +7,7 @@
 #include <boost/format.hpp>
 #include <math.h>
 #include <openssl/aes.h>
+#include <set>
 
 using namespace std;
 
@@ -15,7 +16,9 @@ namespace PathORAM
 	enum TestingPositionMapAdapterType
 	{
 		PositionMapAdapterTypeInMemory,
-		PositionMapAdapterTypeORAM
+		PositionMapAdapterTypeORAM,
+		PositionMapAdapterTypeORAMPLB,
+		PositionMapAdapterTypeSparse
 	};
 
 	class PositionMapAdapterTest : public testing::TestWithParam<TestingPositionMapAdapterType>
@@ -26,6 +29,8 @@ namespace PathORAM
 		inline static const number Z		  = 3;
 		inline static const number BLOCK_SIZE = 2 * AES_BLOCK_SIZE;
 
+		inline static const number PLB_CAPACITY = 2;
+
 		protected:
 		unique_ptr<AbsPositionMapAdapter> adapter;
 
@@ -41,6 +46,7 @@ namespace PathORAM
 					this->adapter = make_unique<InMemoryPositionMapAdapter>(CAPACITY);
 					break;
 				case PositionMapAdapterTypeORAM:
+				case PositionMapAdapterTypeORAMPLB:
 					this->adapter = make_unique<ORAMPositionMapAdapter>(
 						make_unique<ORAM>(
 							logCapacity,
@@ -48,7 +54,11 @@ namespace PathORAM
 							Z,
 							make_unique<InMemoryStorageAdapter>(capacity * Z + Z, BLOCK_SIZE, bytes(), Z),
 							make_unique<InMemoryPositionMapAdapter>(capacity * Z + Z),
-							make_unique<InMemoryStashAdapter>(3 * logCapacity * Z)));
+							make_unique<InMemoryStashAdapter>(3 * logCapacity * Z)),
+						type == PositionMapAdapterTypeORAM ? 0 : PLB_CAPACITY);
+					break;
+				case PositionMapAdapterTypeSparse:
+					this->adapter = make_unique<SparsePositionMapAdapter>(CAPACITY, CAPACITY);
 					break;
 				default:
 					throw Exception(boost::format("TestingPositionMapAdapterType %2% is not implemented") % type);
@@ -110,10 +120,40 @@ namespace PathORAM
 
 	TEST_P(PositionMapAdapterTest, BlockOutOfBounds)
 	{
+		if (GetParam() == PositionMapAdapterTypeSparse)
+		{
+			// IDs are not bounded, only their number is (see SparseOverflow)
+			SUCCEED();
+			return;
+		}
+
 		ASSERT_ANY_THROW(adapter->get(CAPACITY * 100));
 		ASSERT_ANY_THROW(adapter->set(CAPACITY * 100, 56uLL));
 	}
 
+	TEST_P(PositionMapAdapterTest, MemoryUsage)
+	{
+		adapter->set(CAPACITY - 1, 56);
+		adapter->get(CAPACITY - 1);
+
+		switch (GetParam())
+		{
+			case PositionMapAdapterTypeInMemory:
+				EXPECT_EQ(CAPACITY * sizeof(number), adapter->memoryUsage());
+				break;
+			case PositionMapAdapterTypeORAM:
+			case PositionMapAdapterTypeORAMPLB:
+				// the underlying ORAM dominates
+				EXPECT_LT(adapter->memoryUsage(false), adapter->memoryUsage());
+				EXPECT_LT(0, adapter->memoryUsage(false));
+				break;
+			default:
+				EXPECT_LT(0, adapter->memoryUsage());
+				EXPECT_EQ(adapter->memoryUsage(false), adapter->memoryUsage());
+				break;
+		}
+	}
+
 	TEST_P(PositionMapAdapterTest, ReadWhatWasWritten)
 	{
 		auto leaf = 56uLL;
@@ -136,6 +176,195 @@ namespace PathORAM
 		ASSERT_EQ(_new, returned);
 	}
 
+	TEST_P(PositionMapAdapterTest, ManyBlocks)
+	{
+		for (number block = 0; block < CAPACITY; block++)
+		{
+			adapter->set(block, block * 3);
+		}
+
+		for (number block = 0; block < CAPACITY; block++)
+		{
+			EXPECT_EQ(block * 3, adapter->get(block));
+		}
+	}
+
+	TEST_P(PositionMapAdapterTest, Initialize)
+	{
+		const auto leaves = 8uLL;
+
+		adapter->initialize(CAPACITY, leaves);
+
+		set<number> seen;
+		for (number block = 0; block < CAPACITY; block++)
+		{
+			const auto leaf = adapter->get(block);
+			EXPECT_GT(leaves, leaf);
+			seen.insert(leaf);
+		}
+		EXPECT_LT(1, seen.size());
+	}
+
+	TEST_P(PositionMapAdapterTest, BulkLoad)
+	{
+		const auto leaves = 8uLL;
+
+		adapter->initialize(CAPACITY, leaves);
+		adapter->load({{0, 5uLL}, {CAPACITY - 1, 7uLL}});
+
+		EXPECT_EQ(5uLL, adapter->get(0));
+		EXPECT_EQ(7uLL, adapter->get(CAPACITY - 1));
+		for (number block = 1; block < CAPACITY - 1; block++)
+		{
+			EXPECT_GT(leaves, adapter->get(block));
+		}
+
+		// regular operations after bulk load
+		adapter->set(1, 3uLL);
+		EXPECT_EQ(3uLL, adapter->get(1));
+	}
+
+	TEST_P(PositionMapAdapterTest, PLBNeighbors)
+	{
+		if (GetParam() != PositionMapAdapterTypeORAMPLB)
+		{
+			SUCCEED();
+			return;
+		}
+
+		auto plbAdapter = dynamic_cast<ORAMPositionMapAdapter *>(adapter.get());
+		auto requests	= 0;
+		plbAdapter->oram->storage->subscribe([&requests](const bool read, const number batch, const number size, const number overhead) -> void { requests++; });
+
+		// neighbors share a block of the underlying ORAM
+		adapter->set(0, 56uLL);
+		const auto afterMiss = requests;
+		EXPECT_LT(0, afterMiss);
+
+		for (number block = 0; block < plbAdapter->positionsPerBlock; block++)
+		{
+			adapter->set(block, block);
+			EXPECT_EQ(block, adapter->get(block));
+		}
+		EXPECT_EQ(afterMiss, requests);
+
+		// evict the dirty block by touching PLB_CAPACITY other blocks, then read it back
+		for (number i = 1; i <= PLB_CAPACITY; i++)
+		{
+			adapter->get(i * plbAdapter->positionsPerBlock);
+		}
+		EXPECT_EQ(1uLL, adapter->get(1));
+	}
+
+	TEST_P(PositionMapAdapterTest, PLBFewerAccesses)
+	{
+		if (GetParam() != PositionMapAdapterTypeORAMPLB)
+		{
+			SUCCEED();
+			return;
+		}
+
+		auto plbAdapter = dynamic_cast<ORAMPositionMapAdapter *>(adapter.get());
+
+		// the same requests with PLB disabled
+		auto logCapacity = max((number)ceil(log(CAPACITY * Z) / log(2)), 3uLL);
+		auto capacity	 = (1 << logCapacity) * Z;
+		ORAMPositionMapAdapter plain(
+			make_shared<ORAM>(
+				logCapacity,
+				BLOCK_SIZE,
+				Z,
+				make_shared<InMemoryStorageAdapter>(capacity * Z + Z, BLOCK_SIZE, bytes(), Z),
+				make_shared<InMemoryPositionMapAdapter>(capacity * Z + Z),
+				make_shared<InMemoryStashAdapter>(3 * logCapacity * Z)),
+			0);
+
+		vector<AccessStats> stats(2);
+		vector<AbsPositionMapAdapter *> adapters = {&plain, plbAdapter};
+		for (number i = 0; i < adapters.size(); i++)
+		{
+			adapters[i]->recordStats(&stats[i]);
+			for (number round = 0; round < 2; round++)
+			{
+				for (number block = 0; block < 2 * plbAdapter->positionsPerBlock; block++)
+				{
+					adapters[i]->get(block);
+					adapters[i]->set(block, block + round);
+				}
+			}
+			adapters[i]->recordStats(nullptr);
+		}
+
+		// without PLB, one access per get and one per set (written through), with PLB, one per miss
+		EXPECT_EQ(8 * plbAdapter->positionsPerBlock, stats[0].recursiveAccesses);
+		EXPECT_EQ(2uLL, stats[1].recursiveAccesses);
+
+		for (number block = 0; block < 2 * plbAdapter->positionsPerBlock; block++)
+		{
+			EXPECT_EQ(block + 1, adapter->get(block));
+		}
+	}
+
+	TEST_P(PositionMapAdapterTest, SparseIDs)
+	{
+		if (GetParam() != PositionMapAdapterTypeSparse)
+		{
+			SUCCEED();
+			return;
+		}
+
+		adapter->initialize(1uLL << 40, 8uLL);
+		for (number i = 0; i < CAPACITY; i++)
+		{
+			adapter->set(hashToNumber(bytes{(uchar)i}, ULLONG_MAX), i);
+		}
+		for (number i = 0; i < CAPACITY; i++)
+		{
+			EXPECT_EQ(i, adapter->get(hashToNumber(bytes{(uchar)i}, ULLONG_MAX)));
+		}
+		EXPECT_EQ(CAPACITY, dynamic_cast<SparsePositionMapAdapter *>(adapter.get())->size());
+	}
+
+	TEST_P(PositionMapAdapterTest, SparseOverflow)
+	{
+		if (GetParam() != PositionMapAdapterTypeSparse)
+		{
+			SUCCEED();
+			return;
+		}
+
+		for (number i = 0; i < CAPACITY; i++)
+		{
+			adapter->set(i << 40, i);
+		}
+		ASSERT_ANY_THROW(adapter->set(CAPACITY << 40, 0));
+		ASSERT_NO_THROW(adapter->set(0, 5)); // override is fine
+
+		// unmapped block gets a random leaf, same on subsequent gets
+		auto sparse = make_unique<SparsePositionMapAdapter>(CAPACITY);
+		sparse->initialize(0, 1uLL << 20);
+		const auto leaf = sparse->get(123456789);
+		EXPECT_EQ(leaf, sparse->get(123456789));
+	}
+
+	TEST_P(PositionMapAdapterTest, SparseUnknownLeaves)
+	{
+		if (GetParam() != PositionMapAdapterTypeSparse)
+		{
+			SUCCEED();
+			return;
+		}
+
+		// not initialized, there is no leaf to give to an unmapped block
+		auto sparse = make_unique<SparsePositionMapAdapter>(CAPACITY);
+		ASSERT_ANY_THROW(sparse->get(123456789));
+		sparse->set(5, 3uLL);
+		EXPECT_EQ(3uLL, sparse->get(5));
+
+		// the number of leaves given to the constructor (e.g. for a restored ORAM)
+		EXPECT_GT(CAPACITY, adapter->get(123456789));
+	}
+
 	string printTestName(testing::TestParamInfo<TestingPositionMapAdapterType> input)
 	{
 		switch (input.param)
@@ -144,12 +373,16 @@ namespace PathORAM
 				return "InMemory";
 			case PositionMapAdapterTypeORAM:
 				return "ORAM";
+			case PositionMapAdapterTypeORAMPLB:
+				return "ORAMPLB";
+			case PositionMapAdapterTypeSparse:
+				return "Sparse";
 			default:
 				throw Exception(boost::format("TestingPositionMapAdapterType %2% is not implemented") % input.param);
 		}
 	}
 
-	INSTANTIATE_TEST_SUITE_P(PositionMapSuite, PositionMapAdapterTest, testing::Values(PositionMapAdapterTypeInMemory, PositionMapAdapterTypeORAM), printTestName);
+	INSTANTIATE_TEST_SUITE_P(PositionMapSuite, PositionMapAdapterTest, testing::Values(PositionMapAdapterTypeInMemory, PositionMapAdapterTypeORAM, PositionMapAdapterTypeORAMPLB, PositionMapAdapterTypeSparse), printTestName);
 }
 
 int main(int argc, char** argv)
@@ -3,26 +3,57 @@
 #include "utility.hpp"
 
 #include "gtest/gtest.h"
+#include <algorithm>
+#include <boost/format.hpp>
+#include <filesystem>
+#include <fstream>
 
 using namespace std;
 
 namespace PathORAM
 {
-	class StashAdapterTest : public ::testing::Test
+	enum TestingStashAdapterType
+	{
+		StashAdapterTypeInMemory,
+		StashAdapterTypeSlab,
+		StashAdapterTypeLeaf
+	};
+
+	class StashAdapterTest : public testing::TestWithParam<TestingStashAdapterType>
 	{
 		public:
-		inline static const number CAPACITY = 10;
+		inline static const number CAPACITY	  = 10;
+		inline static const number BLOCK_SIZE = 64;
+		inline static const number HEIGHT	  = 6;
 
 		protected:
-		unique_ptr<InMemoryStashAdapter> adapter = make_unique<InMemoryStashAdapter>(CAPACITY);
+		unique_ptr<AbsStashAdapter> adapter;
+
+		StashAdapterTest()
+		{
+			switch (GetParam())
+			{
+				case StashAdapterTypeInMemory:
+					this->adapter = make_unique<InMemoryStashAdapter>(CAPACITY);
+					break;
+				case StashAdapterTypeSlab:
+					this->adapter = make_unique<SlabStashAdapter>(CAPACITY, BLOCK_SIZE);
+					break;
+				case StashAdapterTypeLeaf:
+					this->adapter = make_unique<LeafStashAdapter>(CAPACITY, BLOCK_SIZE, HEIGHT);
+					break;
+				default:
+					throw Exception(boost::format("TestingStashAdapterType %1% is not implemented") % GetParam());
+			}
+		}
 	};
 
-	TEST_F(StashAdapterTest, Initialization)
+	TEST_P(StashAdapterTest, Initialization)
 	{
 		SUCCEED();
 	}
 
-	TEST_F(StashAdapterTest, ReadGetEraseNoCrash)
+	TEST_P(StashAdapterTest, ReadGetEraseNoCrash)
 	{
 		EXPECT_NO_THROW({
 			adapter->add(5uLL, bytes());
@@ -32,7 +63,7 @@ namespace PathORAM
 		});
 	}
 
-	TEST_F(StashAdapterTest, LoadStore)
+	TEST_P(StashAdapterTest, LoadStore)
 	{
 		const auto blockSize = 64;
 		const auto filename	 = "stash.bin";
@@ -52,7 +83,7 @@ namespace PathORAM
 		remove(filename);
 	}
 
-	TEST_F(StashAdapterTest, LoadStoreFileError)
+	TEST_P(StashAdapterTest, LoadStoreFileError)
 	{
 		auto stash = new InMemoryStashAdapter(CAPACITY);
 		ASSERT_ANY_THROW(stash->storeToFile("/error/path/should/not/exist"));
@@ -60,7 +91,126 @@ namespace PathORAM
 		delete stash;
 	}
 
-	TEST_F(StashAdapterTest, GetAllShuffle)
+	TEST_P(StashAdapterTest, LoadStoreLarge)
+	{
+		if (GetParam() != StashAdapterTypeInMemory)
+		{
+			SUCCEED();
+			return;
+		}
+
+		const auto blockSize = 1 << 14;
+		const auto capacity	 = 1 << 10;
+		const auto filename	 = "stash.bin";
+
+		auto stash = make_unique<InMemoryStashAdapter>(capacity);
+		for (number i = 0; i < capacity; i++)
+		{
+			stash->add(i, fromText(to_string(i), blockSize));
+		}
+		stash->storeToFile(filename);
+		stash.reset();
+
+		stash = make_unique<InMemoryStashAdapter>(capacity);
+		stash->loadFromFile(filename, blockSize);
+		ASSERT_EQ(capacity, stash->currentSize());
+		for (number i = 0; i < capacity; i++)
+		{
+			bytes read;
+			stash->get(i, read);
+			EXPECT_EQ(to_string(i), toText(read, blockSize));
+		}
+
+		// too small
+		stash = make_unique<InMemoryStashAdapter>(capacity - 1);
+		ASSERT_ANY_THROW(stash->loadFromFile(filename, blockSize));
+
+		remove(filename);
+	}
+
+	TEST_P(StashAdapterTest, LoadStoreCorrupted)
+	{
+		if (GetParam() != StashAdapterTypeInMemory)
+		{
+			SUCCEED();
+			return;
+		}
+
+		const auto blockSize = 64;
+		const auto filename	 = "stash.bin";
+
+		auto stash = make_unique<InMemoryStashAdapter>(CAPACITY);
+		stash->add(5, fromText("hello", blockSize));
+		stash->storeToFile(filename);
+
+		// wrong block size
+		stash = make_unique<InMemoryStashAdapter>(CAPACITY);
+		ASSERT_ANY_THROW(stash->loadFromFile(filename, blockSize * 2));
+
+		// flip a bit of the payload
+		fstream file(filename, fstream::in | fstream::out | fstream::binary);
+		file.seekp(-1, file.end);
+		file.put(0x01);
+		file.close();
+
+		// nothing reaches the stash, its own blocks are kept
+		stash = make_unique<InMemoryStashAdapter>(CAPACITY);
+		stash->add(9, fromText("kept", blockSize));
+		ASSERT_ANY_THROW(stash->loadFromFile(filename, blockSize));
+		EXPECT_EQ(1, stash->currentSize());
+
+		// a huge count whose expected file size overflows to the real one, rejected by capacity before any allocation
+		const number headerSize = filesystem::file_size(filename) - sizeof(number) - blockSize;
+		const number hugeCount	= (1uLL << 61) + 1;
+		file.open(filename, fstream::in | fstream::out | fstream::binary);
+		file.seekp(headerSize - 2 * sizeof(number), file.beg);
+		file.write((const char *)&hugeCount, sizeof(number));
+		file.close();
+
+		stash = make_unique<InMemoryStashAdapter>(CAPACITY);
+		ASSERT_ANY_THROW(stash->loadFromFile(filename, blockSize));
+		EXPECT_EQ(0, stash->currentSize());
+
+		// truncate
+		filesystem::resize_file(filename, filesystem::file_size(filename) - 1);
+		stash = make_unique<InMemoryStashAdapter>(CAPACITY);
+		ASSERT_ANY_THROW(stash->loadFromFile(filename, blockSize));
+
+		remove(filename);
+	}
+
+	TEST_P(StashAdapterTest, LoadLegacyFormat)
+	{
+		if (GetParam() != StashAdapterTypeInMemory)
+		{
+			SUCCEED();
+			return;
+		}
+
+		const auto blockSize = 64;
+		const auto filename	 = "stash.bin";
+		const auto expected	 = fromText("hello", blockSize);
+
+		// records only, no header
+		fstream file(filename, fstream::out | fstream::binary | fstream::trunc);
+		for (number block : {5uLL, 6uLL})
+		{
+			file.write((const char *)&block, sizeof(number));
+			file.write((const char *)expected.data(), blockSize);
+		}
+		file.close();
+
+		auto stash = make_unique<InMemoryStashAdapter>(CAPACITY);
+		stash->loadFromFile(filename, blockSize);
+		ASSERT_EQ(2, stash->currentSize());
+		bytes read;
+		stash->get(6, read);
+		EXPECT_EQ(expected, read);
+
+		remove(filename);
+	}
+
+	TEST_P(StashAdapterTest, GetAllShuffle)
 	{
 		for (number i = 0; i < CAPACITY; i++)
 		{
@@ -77,7 +227,48 @@ namespace PathORAM
 		EXPECT_NE(first, second);
 	}
 
-	TEST_F(StashAdapterTest, OverflowAdd)
+	TEST_P(StashAdapterTest, ForEach)
+	{
+		for (number i = 0; i < CAPACITY; i++)
+		{
+			adapter->add(i, fromText(to_string(i), BLOCK_SIZE));
+		}
+
+		for (auto &&shuffle : {false, true})
+		{
+			vector<number> visited;
+			adapter->forEach(
+				[&visited](const number block, const uchar *data, const number size) {
+					EXPECT_EQ(to_string(block), toText(bytes(data, data + size), BLOCK_SIZE));
+					visited.push_back(block);
+				},
+				shuffle);
+
+			sort(visited.begin(), visited.end());
+			ASSERT_EQ(CAPACITY, visited.size());
+			for (number i = 0; i < CAPACITY; i++)
+			{
+				EXPECT_EQ(i, visited[i]);
+			}
+		}
+	}
+
+	TEST_P(StashAdapterTest, ForEachShuffle)
+	{
+		for (number i = 0; i < CAPACITY; i++)
+		{
+			adapter->add(i, bytes());
+		}
+
+		vector<number> first, second;
+		adapter->forEach([&first](const number block, const uchar *data, const number size) { first.push_back(block); });
+		adapter->forEach([&second](const number block, const uchar *data, const number size) { second.push_back(block); });
+
+		EXPECT_EQ(first.size(), second.size());
+		EXPECT_NE(first, second);
+	}
+
+	TEST_P(StashAdapterTest, OverflowAdd)
 	{
 		for (number i = 0uLL; i < CAPACITY; i++)
 		{
@@ -89,7 +280,7 @@ namespace PathORAM
 		ASSERT_NO_THROW(adapter->add(CAPACITY + 1, bytes())); // duplicate key should not be inserted
 	}
 
-	TEST_F(StashAdapterTest, OverflowUpdate)
+	TEST_P(StashAdapterTest, OverflowUpdate)
 	{
 		for (number i = 0uLL; i < CAPACITY; i++)
 		{
@@ -101,7 +292,7 @@ namespace PathORAM
 		ASSERT_NO_THROW(adapter->update(CAPACITY + 1, bytes())); // duplicate key should not be inserted
 	}
 
-	TEST_F(StashAdapterTest, ReadWhatWasWritten)
+	TEST_P(StashAdapterTest, ReadWhatWasWritten)
 	{
 		auto block = CAPACITY - 1;
 		auto data  = bytes{0x25};
@@ -113,7 +304,39 @@ namespace PathORAM
 		ASSERT_EQ(data, returned);
 	}
 
-	TEST_F(StashAdapterTest, Override)
+	TEST_P(StashAdapterTest, ReadIntoBuffer)
+	{
+		auto block = CAPACITY - 1;
+		auto data  = bytes{0x25, 0x26, 0x27};
+
+		adapter->update(block, bytes(data));
+
+		uchar buffer[BLOCK_SIZE];
+		ASSERT_EQ(data.size(), adapter->get(block, buffer));
+		EXPECT_EQ(data, bytes(buffer, buffer + data.size()));
+
+		EXPECT_EQ(0, adapter->get(block - 1, buffer));
+	}
+
+	TEST_P(StashAdapterTest, MemoryUsage)
+	{
+		const auto empty = adapter->memoryUsage();
+
+		adapter->add(CAPACITY - 1, bytes(BLOCK_SIZE, 0x25));
+
+		if (GetParam() == StashAdapterTypeInMemory)
+		{
+			EXPECT_LE(empty + BLOCK_SIZE, adapter->memoryUsage());
+		}
+		else
+		{
+			// the slots are preallocated
+			EXPECT_LE(CAPACITY * BLOCK_SIZE, empty);
+			EXPECT_EQ(empty, adapter->memoryUsage());
+		}
+	}
+
+	TEST_P(StashAdapterTest, Override)
 	{
 		auto block = CAPACITY - 1;
 		auto old = bytes{0x25}, _new = bytes{0x56};
@@ -130,7 +353,7 @@ namespace PathORAM
 		ASSERT_EQ(_new, returned);
 	}
 
-	TEST_F(StashAdapterTest, NoOverride)
+	TEST_P(StashAdapterTest, NoOverride)
 	{
 		auto block = CAPACITY - 1;
 		auto old = bytes{0x25}, _new = bytes{0x56};
@@ -146,6 +369,136 @@ namespace PathORAM
 		ASSERT_EQ(1, got.size());
 		ASSERT_EQ(old, returned);
 	}
+
+	TEST_P(StashAdapterTest, ReuseSlots)
+	{
+		for (number round = 0; round < 5; round++)
+		{
+			for (number i = 0; i < CAPACITY; i++)
+			{
+				adapter->add(round * CAPACITY + i, fromText(to_string(round * CAPACITY + i), BLOCK_SIZE));
+			}
+
+			// remove every other block and put it back with a different ID
+			for (number i = 0; i < CAPACITY; i += 2)
+			{
+				adapter->remove(round * CAPACITY + i);
+			}
+			for (number i = 0; i < CAPACITY; i += 2)
+			{
+				adapter->add(ULONG_MAX - i, fromText(to_string(i), BLOCK_SIZE));
+			}
+
+			for (number i = 0; i < CAPACITY; i++)
+			{
+				const auto id = i % 2 == 0 ? ULONG_MAX - i : round * CAPACITY + i;
+				bytes returned;
+				adapter->get(id, returned);
+				EXPECT_EQ(to_string(i % 2 == 0 ? i : round * CAPACITY + i), toText(returned, BLOCK_SIZE));
+			}
+
+			vector<block> got;
+			adapter->getAll(got);
+			ASSERT_EQ(CAPACITY, got.size());
+
+			for (auto &&[id, data] : got)
+			{
+				adapter->remove(id);
+			}
+			got.clear();
+			adapter->getAll(got);
+			ASSERT_EQ(0, got.size());
+		}
+	}
+
+	TEST_P(StashAdapterTest, SlabBlockTooLarge)
+	{
+		if (GetParam() != StashAdapterTypeSlab)
+		{
+			SUCCEED();
+			return;
+		}
+
+		ASSERT_ANY_THROW(adapter->add(0, bytes(BLOCK_SIZE + 1)));
+		ASSERT_NO_THROW(adapter->add(0, bytes(BLOCK_SIZE)));
+		ASSERT_ANY_THROW(adapter->update(0, bytes(BLOCK_SIZE + 1)));
+	}
+
+	TEST_P(StashAdapterTest, ForEachInRange)
+	{
+		if (!adapter->indexesLeaves())
+		{
+			ASSERT_ANY_THROW(adapter->forEachInRange(0, 0, 1, [](const number block, const uchar *data, const number size) {}));
+			return;
+		}
+
+		const number leaves = 1 << (HEIGHT - 1);
+		for (number round = 0; round < 10; round++)
+		{
+			// block i is mapped to leaves[i]
+			vector<number> mapped(CAPACITY);
+			for (number i = 0; i < CAPACITY; i++)
+			{
+				adapter->add(i, fromText(to_string(i), BLOCK_SIZE));
+				adapter->setLeaf(i, getRandomULong(leaves));
+				// remap some blocks
+				mapped[i] = getRandomULong(leaves);
+				adapter->setLeaf(i, mapped[i]);
+			}
+
+			for (number from = 0; from < leaves; from++)
+			{
+				for (number to = from; to < leaves; to++)
+				{
+					number expected = 0;
+					for (number i = 0; i < CAPACITY; i++)
+					{
+						expected += mapped[i] >= from && mapped[i] <= to;
+					}
+
+					number visited = 0;
+					adapter->forEachInRange(from, to, CAPACITY, [&](const number block, const uchar *data, const number size) {
+						EXPECT_LE(from, mapped[block]);
+						EXPECT_GE(to, mapped[block]);
+						EXPECT_EQ(to_string(block), toText(bytes(data, data + size), BLOCK_SIZE));
+						visited++;
+					});
+					EXPECT_EQ(expected, visited);
+
+					visited = 0;
+					adapter->forEachInRange(from, to, 1, [&visited](const number block, const uchar *data, const number size) { visited++; });
+					EXPECT_EQ(min(expected, 1uLL), visited);
+				}
+			}
+
+			for (number i = 0; i < CAPACITY; i++)
+			{
+				adapter->remove(i);
+			}
+			number visited = 0;
+			adapter->forEachInRange(0, leaves - 1, CAPACITY, [&visited](const number block, const uchar *data, const number size) { visited++; });
+			EXPECT_EQ(0, visited);
+		}
+
+		ASSERT_ANY_THROW(adapter->setLeaf(0, leaves));
+	}
+
+	string printTestName(testing::TestParamInfo<TestingStashAdapterType> input)
+	{
+		switch (input.param)
+		{
+			case StashAdapterTypeInMemory:
+				return "InMemory";
+			case StashAdapterTypeSlab:
+				return "Slab";
+			case StashAdapterTypeLeaf:
+				return "Leaf";
+			default:
+				throw Exception(boost::format("TestingStashAdapterType %1% is not implemented") % input.param);
+		}
+	}
+
+	INSTANTIATE_TEST_SUITE_P(StashSuite, StashAdapterTest, testing::Values(StashAdapterTypeInMemory, StashAdapterTypeSlab, StashAdapterTypeLeaf), printTestName);
 }
 
 int main(int argc, char** argv)
@@ -0,0 +1,57 @@
+#include "stash-simulator.hpp"
+
+#include <iostream>
+#include <thread>
+
+using namespace std;
+using namespace PathORAM;
+
+// usage: test-stash-simulation [logCapacity Z load watermark accesses trials threads]
+// watermark 0 means plain path eviction, otherwise background eviction (up to 4 dummy accesses)
+int main(int argc, char **argv)
+{
+	cout << "Running Monte Carlo simulations of stash occupancy..." << endl;
+
+	const auto argument = [argc, argv](const int index, const double fallback) -> double { return argc > index ? stod(argv[index]) : fallback; };
+
+	const number LOG_CAPACITY = argument(1, 11);
+	const number Z			  = argument(2, 3);
+	const double LOAD		  = argument(3, 0.75);
+	const number WATERMARK	  = argument(4, 0);
+	const number ACCESSES	  = argument(5, 1 << 16);
+	const number TRIALS		  = argument(6, 64);
+	const number THREADS	  = argument(7, max(1u, thread::hardware_concurrency()));
+
+	cout << "LOG_CAPACITY: " << LOG_CAPACITY << endl;
+	cout << "Z: " << Z << endl;
+	cout << "LOAD: " << LOAD << endl;
+	cout << "WATERMARK: " << WATERMARK << endl;
+	cout << "ACCESSES: " << ACCESSES << endl;
+	cout << "TRIALS: " << TRIALS << endl;
+	cout << "THREADS: " << THREADS << endl;
+
+	const StashSimulator simulator(LOG_CAPACITY, Z, LOAD, WATERMARK > 0 ? EVICTION_BACKGROUND : EVICTION_PATH, WATERMARK);
+	const auto distribution = simulator.run(ACCESSES, TRIALS, THREADS);
+
+	cout << "Dummy accesses: " << distribution.dummyAccesses << endl;
+	cout << "Stash size distribution (size: accesses, P(stash > size), P(trial exceeds size)):" << endl;
+	for (number size = 0; size < distribution.histogram.size(); size++)
+	{
+		cout << "\t" << size << ": " << distribution.histogram[size] << ", " << distribution.tail(size) << ", " << distribution.overflow(size) << endl;
+	}
+
+	cout << "Smallest stash capacity per access overflow probability:" << endl;
+	for (auto probability : {1e-2, 1e-3, 1e-4, 1e-5, 1e-6})
+	{
+		if (probability * distribution.samples < 1)
+		{
+			cout << "\t" << probability << ": not enough samples" << endl;
+			continue;
+		}
+		cout << "\t" << probability << ": " << distribution.capacityFor(probability) << endl;
+	}
+
+	cout << "Successful!" << endl;
+
+	return 0;
+}
@@ -0,0 +1,138 @@
+#include "definitions.h"
+#include "stash-simulator.hpp"
+
+#include "gtest/gtest.h"
+#include <numeric>
+
+using namespace std;
+
+namespace PathORAM
+{
+	class StashSimulatorTest : public ::testing::Test
+	{
+		public:
+		inline static const number LOG_CAPACITY = 8;
+		inline static const number Z			= 3;
+		inline static const double LOAD			= 0.75;
+		inline static const number ACCESSES		= 1 << 10;
+		inline static const number TRIALS		= 8;
+	};
+
+	TEST_F(StashSimulatorTest, InputsCheck)
+	{
+		ASSERT_ANY_THROW(StashSimulator(LOG_CAPACITY, 0, LOAD));
+		ASSERT_ANY_THROW(StashSimulator(LOG_CAPACITY, Z, 0));
+		ASSERT_ANY_THROW(StashSimulator(LOG_CAPACITY, Z, 1.5));
+		ASSERT_ANY_THROW(StashSimulator(LOG_CAPACITY, Z, LOAD, EVICTION_BACKGROUND, 0));
+	}
+
+	TEST_F(StashSimulatorTest, BlocksConserved)
+	{
+		StashSimulator simulator(LOG_CAPACITY, Z, LOAD);
+		auto trial = simulator.start(5);
+
+		for (number i = 0; i < ACCESSES; i++)
+		{
+			const auto block = i % simulator.blocks;
+			simulator.access(trial, block, trial.positions[block]);
+
+			// every block is either in the stash, or in a bucket on the path of its leaf
+			number stored = trial.stash.size();
+			for (number slot = 0; slot < trial.tree.size(); slot++)
+			{
+				const auto id = trial.tree[slot];
+				if (id != ULONG_MAX)
+				{
+					stored++;
+					auto onPath = false;
+					for (number level = 0; level < LOG_CAPACITY; level++)
+					{
+						onPath |= simulator.bucketForLevelLeaf(level, trial.positions[id]) == slot / Z;
+					}
+					ASSERT_TRUE(onPath);
+				}
+			}
+			ASSERT_EQ(simulator.blocks, stored);
+		}
+	}
+
+	TEST_F(StashSimulatorTest, Distribution)
+	{
+		const auto distribution = StashSimulator(LOG_CAPACITY, Z, LOAD).run(ACCESSES, TRIALS, 2);
+
+		EXPECT_EQ(ACCESSES * TRIALS, distribution.samples);
+		EXPECT_EQ(TRIALS, distribution.trials);
+		EXPECT_EQ(distribution.samples, accumulate(distribution.histogram.begin(), distribution.histogram.end(), 0uLL));
+		EXPECT_EQ(distribution.trials, accumulate(distribution.maxima.begin(), distribution.maxima.end(), 0uLL));
+		EXPECT_EQ(0, distribution.dummyAccesses);
+
+		// the largest stash of all trials bounds every sample
+		const auto largest = distribution.maxima.size() - 1;
+		EXPECT_EQ(largest + 1, distribution.histogram.size());
+		EXPECT_EQ(0, distribution.tail(largest));
+		EXPECT_EQ(0, distribution.overflow(largest));
+		EXPECT_DOUBLE_EQ(1, distribution.overflow(0) + (distribution.maxima[0] / (double)TRIALS));
+		EXPECT_LE(distribution.capacityFor(0), largest);
+		EXPECT_LE(distribution.capacityFor(0.5), distribution.capacityFor(0.01));
+	}
+
+	TEST_F(StashSimulatorTest, SameResultAnyThreads)
+	{
+		StashSimulator simulator(LOG_CAPACITY, Z, LOAD);
+
+		srand(TEST_SEED);
+		const auto single = simulator.run(ACCESSES, TRIALS, 1);
+		srand(TEST_SEED);
+		const auto many = simulator.run(ACCESSES, TRIALS, 4);
+
+		EXPECT_EQ(single.histogram, many.histogram);
+		EXPECT_EQ(single.maxima, many.maxima);
+	}
+
+	TEST_F(StashSimulatorTest, BackgroundEviction)
+	{
+		// a small bucket and a high load make the stash grow
+		const auto WATERMARK = 4uLL;
+
+		const auto path		  = StashSimulator(LOG_CAPACITY, 2, 0.9).run(ACCESSES, TRIALS, 2);
+		const auto background = StashSimulator(LOG_CAPACITY, 2, 0.9, EVICTION_BACKGROUND, WATERMARK, 16).run(ACCESSES, TRIALS, 2);
+
+		EXPECT_LT(0, background.dummyAccesses);
+		EXPECT_LT(background.tail(WATERMARK), path.tail(WATERMARK));
+		EXPECT_LE(background.maxima.size(), path.maxima.size());
+	}
+
+	TEST_F(StashSimulatorTest, TailProbabilities)
+	{
+		StashDistribution distribution;
+		distribution.histogram = {5, 3, 2};
+		distribution.maxima	   = {0, 1, 1};
+		distribution.samples   = 10;
+		distribution.trials	   = 2;
+
+		EXPECT_DOUBLE_EQ(0.5, distribution.tail(0));
+		EXPECT_DOUBLE_EQ(0.2, distribution.tail(1));
+		EXPECT_DOUBLE_EQ(0, distribution.tail(2));
+		EXPECT_DOUBLE_EQ(0.5, distribution.overflow(1));
+
+		EXPECT_EQ(0, distribution.capacityFor(0.5));
+		EXPECT_EQ(1, distribution.capacityFor(0.3));
+		EXPECT_EQ(2, distribution.capacityFor(0));
+
+		auto merged = distribution;
+		merged.merge({{0, 0, 0, 10}, {0, 0, 0, 1}, 10, 1, 3});
+		EXPECT_EQ(vector<number>({5, 3, 2, 10}), merged.histogram);
+		EXPECT_EQ(20, merged.samples);
+		EXPECT_EQ(3, merged.trials);
+		EXPECT_EQ(3, merged.dummyAccesses);
+		EXPECT_DOUBLE_EQ(0.75, merged.tail(0));
+	}
+}
+
+int main(int argc, char **argv)
+{
+	srand(TEST_SEED);
+
+	::testing::InitGoogleTest(&argc, argv);
+	return RUN_ALL_TESTS();
+}
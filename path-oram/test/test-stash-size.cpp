@@ -43,18 +43,19 @@ int main()
 
 	oram->load(data);
 
-	number largest = 0;
 	for (number run = 0; run < RUNS; run++)
 	{
 		auto id = getRandomULong(ELEMENTS);
 		bytes returned;
 		oram->get(id, returned);
+	}
 
-		auto size = stash->currentSize();
-		if (size > largest) {
-			cout << size << endl;
-			largest = size;
-		}
+	const auto occupancy = oram->stashOccupancy();
+	cout << "Max stash size: " << occupancy.max << endl;
+	cout << "Stash size histogram (size: accesses):" << endl;
+	for (number size = 0; size < occupancy.histogram.size(); size++)
+	{
+		cout << "\t" << size << ": " << occupancy.histogram[size] << endl;
 	}
 
 	cout << "Successful!" << endl;
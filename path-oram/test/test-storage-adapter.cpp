@@ -5,6 +5,7 @@
 #include "gtest/gtest.h"
 #include <boost/format.hpp>
 #include <fstream>
+#include <functional>
 #include <openssl/aes.h>
 
 using namespace std;
@@ -20,7 +21,8 @@ namespace PathORAM
 		StorageAdapterTypeAerospike,
 #endif
 		StorageAdapterTypeInMemory,
-		StorageAdapterTypeFileSystem
+		StorageAdapterTypeFileSystem,
+		StorageAdapterTypeSimulatedLatency
 	};
 
 	class StorageAdapterTest : public testing::TestWithParam<TestingStorageAdapterType>
@@ -56,6 +58,9 @@ namespace PathORAM
 					return make_unique<InMemoryStorageAdapter>(CAPACITY, BLOCK_SIZE, bytes(), Z, batchLimit);
 				case StorageAdapterTypeFileSystem:
 					return make_unique<FileSystemStorageAdapter>(CAPACITY, BLOCK_SIZE, bytes(), FILE_NAME, true, Z, batchLimit);
+				case StorageAdapterTypeSimulatedLatency:
+					// no delays, but batch calls are supported (unlike the wrapped storage)
+					return make_unique<SimulatedLatencyStorageAdapter>(make_shared<InMemoryStorageAdapter>(CAPACITY, BLOCK_SIZE, bytes(), Z, batchLimit), SimulatedLatency());
 #if USE_REDIS
 				case StorageAdapterTypeRedis:
 					return make_unique<RedisStorageAdapter>(CAPACITY, BLOCK_SIZE, bytes(), REDIS_HOST, true, Z, batchLimit);
@@ -118,7 +123,7 @@ namespace PathORAM
 			}
 		};
 
-		if (GetParam() != StorageAdapterTypeInMemory)
+		if (GetParam() != StorageAdapterTypeInMemory && GetParam() != StorageAdapterTypeSimulatedLatency)
 		{
 			auto bucket = generateBucket(5);
 			auto key	= getRandomBlock(KEYSIZE);
@@ -320,6 +325,86 @@ namespace PathORAM
 		}
 	}
 
+	TEST_P(StorageAdapterTest, BatchReadWriteArena)
+	{
+		const auto runs = 3;
+		BlockArena arena(BLOCK_SIZE);
+
+		vector<pair<number, arenaBucket>> writes;
+		vector<number> reads;
+		for (auto i = 0; i < runs; i++)
+		{
+			writes.push_back({CAPACITY - 4 + i, arenaBucket()});
+			for (auto &&[id, data] : generateBucket(i * Z))
+			{
+				auto payload = arena.allocate();
+				payload.assign(data.data(), data.size());
+				writes.back().second.push_back({id, move(payload)});
+			}
+			reads.push_back(CAPACITY - 4 + i);
+		}
+		adapter->set(boost::make_iterator_range(writes.cbegin(), writes.cend()));
+
+		// same as regular get
+		vector<block> expected;
+		adapter->get(reads, expected);
+
+		vector<arenaBlock> read;
+		adapter->get(reads, read, arena);
+
+		ASSERT_EQ(runs * Z, read.size());
+		for (auto i = 0uLL; i < read.size(); i++)
+		{
+			EXPECT_EQ(expected[i].first, read[i].first);
+			EXPECT_EQ(expected[i].second, bytes(read[i].second.data(), read[i].second.data() + read[i].second.size()));
+			EXPECT_EQ("hello" + to_string(read[i].first), toText(expected[i].second, BLOCK_SIZE));
+		}
+
+		// payloads are returned to the arena
+		const auto capacity = arena.capacity();
+		writes.clear();
+		read.clear();
+		EXPECT_EQ(capacity, arena.available());
+	}
+
+	TEST_P(StorageAdapterTest, BatchReadWriteRecords)
+	{
+		const auto runs		  = 3;
+		const auto recordSize = adapter->recordSize();
+		ASSERT_EQ(AES_BLOCK_SIZE + BLOCK_SIZE, recordSize);
+
+		// records: the ID padded to AES block, then the payload
+		vector<number> locations;
+		vector<uchar> records(runs * Z * recordSize, 0x00);
+		for (auto i = 0; i < runs; i++)
+		{
+			locations.push_back(CAPACITY - 4 + i);
+			for (auto j = 0uLL; j < Z; j++)
+			{
+				const auto id	  = i * Z + j;
+				const auto record = records.data() + (i * Z + j) * recordSize;
+				const auto data	  = fromText("hello" + to_string(id), BLOCK_SIZE);
+				copy((const uchar *)&id, (const uchar *)&id + sizeof(number), record);
+				copy(data.begin(), data.end(), record + AES_BLOCK_SIZE);
+			}
+		}
+		adapter->set(locations, records.data());
+
+		// same as regular get
+		vector<block> expected;
+		adapter->get(locations, expected);
+		ASSERT_EQ(runs * Z, expected.size());
+		for (auto i = 0uLL; i < expected.size(); i++)
+		{
+			EXPECT_EQ(i, expected[i].first);
+			EXPECT_EQ("hello" + to_string(i), toText(expected[i].second, BLOCK_SIZE));
+		}
+
+		vector<uchar> read(records.size());
+		adapter->get(locations, read.data());
+		EXPECT_EQ(records, read);
+	}
+
 	TEST_P(StorageAdapterTest, EventHandling)
 	{
 		tuple<bool, number, number, number> event;
@@ -373,6 +458,59 @@ namespace PathORAM
 		connection.disconnect();
 	}
 
+	TEST_P(StorageAdapterTest, Metrics)
+	{
+		adapter->resetMetrics();
+
+		auto bucket		   = generateBucket(5);
+		const auto rawSize = (BLOCK_SIZE + AES_BLOCK_SIZE) * Z + AES_BLOCK_SIZE;
+
+		adapter->set(CAPACITY - 1, bucket);
+
+		vector<pair<const number, vector<block>>> requests = {{CAPACITY - 1, bucket}, {CAPACITY - 2, bucket}};
+		adapter->set(boost::make_iterator_range(requests.begin(), requests.end()));
+
+		vector<block> got;
+		vector<number> locations = {CAPACITY - 1, CAPACITY - 2};
+		adapter->get(locations, got);
+
+		const auto metrics = adapter->metrics();
+
+		// a batch is one call if supported
+		EXPECT_EQ(adapter->supportsBatchSet() ? 2 : 3, metrics.writes);
+		EXPECT_EQ(3, metrics.writtenBuckets);
+		EXPECT_EQ(3 * rawSize, metrics.writtenBytes);
+		EXPECT_EQ(adapter->supportsBatchGet() ? 1 : 2, metrics.reads);
+		EXPECT_EQ(2, metrics.readBuckets);
+		EXPECT_EQ(2 * rawSize, metrics.readBytes);
+
+		EXPECT_EQ(metrics.writes, metrics.writeLatency.count);
+		EXPECT_EQ(metrics.reads, metrics.readLatency.count);
+		EXPECT_EQ(adapter->supportsBatchGet() ? 2 : 1, metrics.readBatch.max);
+
+		adapter->resetMetrics();
+		EXPECT_EQ(0, adapter->metrics().reads);
+		EXPECT_EQ(0, adapter->metrics().writeLatency.count);
+	}
+
+	TEST_P(StorageAdapterTest, MemoryUsage)
+	{
+		const auto rawSize = (BLOCK_SIZE + AES_BLOCK_SIZE) * Z + AES_BLOCK_SIZE;
+
+		// only the storages that keep the buckets in this process hold them in memory
+		switch (GetParam())
+		{
+			case StorageAdapterTypeInMemory:
+			case StorageAdapterTypeSimulatedLatency:
+				EXPECT_LE(CAPACITY * rawSize, adapter->memoryUsage());
+				break;
+			default:
+				EXPECT_LT(0, adapter->memoryUsage());
+				EXPECT_GT(CAPACITY * rawSize, adapter->memoryUsage() - sizeof(StorageMetrics));
+				break;
+		}
+	}
+
 	TEST_P(StorageAdapterTest, BatchLimit)
 	{
 		const auto BATCH_LIMIT = 3uLL;
@@ -433,6 +571,47 @@ namespace PathORAM
 		}
 	}
 
+	TEST_P(StorageAdapterTest, SimulatedLatency)
+	{
+		if (GetParam() != StorageAdapterTypeSimulatedLatency)
+		{
+			SUCCEED();
+			return;
+		}
+
+		const auto REQUEST = chrono::milliseconds(2);
+		const auto BATCH   = chrono::milliseconds(3);
+
+		auto storage = make_shared<InMemoryStorageAdapter>(CAPACITY, BLOCK_SIZE, bytes(), Z);
+		storage->set(CAPACITY - 1, generateBucket(5));
+
+		const auto elapsed = [](function<void()> call) -> chrono::nanoseconds {
+			const auto start = chrono::steady_clock::now();
+			call();
+			return chrono::steady_clock::now() - start;
+		};
+
+		for (auto batching : {true, false})
+		{
+			SimulatedLatency latency;
+			latency.request	 = REQUEST;
+			latency.batch	 = BATCH;
+			latency.batching = batching;
+			auto adapter	 = make_unique<SimulatedLatencyStorageAdapter>(storage, latency);
+
+			// the data written to the wrapped storage is readable
+			vector<block> got;
+			EXPECT_LE(REQUEST, elapsed([&]() { adapter->get(CAPACITY - 1, got); }));
+			EXPECT_EQ(generateBucket(5), got);
+
+			// a batch is one round trip if supported, otherwise one per location
+			vector<number> locations = {0, 1, 2, 3};
+			got.clear();
+			EXPECT_LE(batching ? BATCH : (long)locations.size() * REQUEST, elapsed([&]() { adapter->get(locations, got); }));
+			EXPECT_EQ(batching ? 2 : 5, adapter->metrics().reads);
+		}
+	}
+
 	string printTestName(testing::TestParamInfo<TestingStorageAdapterType> input)
 	{
 		switch (input.param)
@@ -441,6 +620,8 @@ namespace PathORAM
 				return "InMemory";
 			case StorageAdapterTypeFileSystem:
 				return "FileSystem";
+			case StorageAdapterTypeSimulatedLatency:
+				return "SimulatedLatency";
 #if USE_REDIS
 			case StorageAdapterTypeRedis:
 				return "Redis";
@@ -456,7 +637,7 @@ namespace PathORAM
 
 	vector<TestingStorageAdapterType> cases()
 	{
-		vector<TestingStorageAdapterType> result = {StorageAdapterTypeFileSystem, StorageAdapterTypeInMemory};
+		vector<TestingStorageAdapterType> result = {StorageAdapterTypeFileSystem, StorageAdapterTypeInMemory, StorageAdapterTypeSimulatedLatency};
 
 #if USE_REDIS
 		for (auto host : vector<string>{"127.0.0.1", "redis"})
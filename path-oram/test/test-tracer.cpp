@@ -0,0 +1,261 @@
+#include "definitions.h"
+#include "oram.hpp"
+#include "tracer.hpp"
+#include "utility.hpp"
+
+#include "gtest/gtest.h"
+#include <map>
+#include <set>
+#include <sstream>
+#include <thread>
+
+using namespace std;
+
+namespace PathORAM
+{
+	class TracerTest : public ::testing::Test
+	{
+		public:
+		inline static const number LOG_CAPACITY = 5;
+		inline static const number Z			= 3;
+		inline static const number BLOCK_SIZE	= 32;
+		inline static const number CAPACITY		= (1 << LOG_CAPACITY);
+	};
+
+	TEST_F(TracerTest, RecordAndRead)
+	{
+		Tracer tracer(8);
+
+		const auto start = chrono::steady_clock::now();
+		tracer.record("first", "oram", start, start + chrono::microseconds(5));
+		tracer.record("second", "storage", start + chrono::microseconds(5), start + chrono::microseconds(7), 3);
+
+		const auto events = tracer.events();
+		ASSERT_EQ(2, events.size());
+		EXPECT_STREQ("first", events[0].name);
+		EXPECT_STREQ("oram", events[0].category);
+		EXPECT_EQ(5000, events[0].duration);
+		EXPECT_STREQ("second", events[1].name);
+		EXPECT_EQ(3, events[1].buckets);
+		EXPECT_EQ(events[0].start + 5000, events[1].start);
+		EXPECT_EQ(Tracer::threadId(), events[0].thread);
+		EXPECT_EQ(0, events[0].batch);
+	}
+
+	TEST_F(TracerTest, Overwrite)
+	{
+		Tracer tracer(4);
+
+		const auto start = chrono::steady_clock::now();
+		for (number i = 0; i < 10; i++)
+		{
+			tracer.record("span", "oram", start + chrono::microseconds(i), start + chrono::microseconds(i + 1));
+		}
+
+		// the last 4 are kept, oldest first
+		const auto events = tracer.events();
+		ASSERT_EQ(4, events.size());
+		EXPECT_EQ(10, tracer.recorded());
+		EXPECT_EQ(6, tracer.overwritten());
+		for (number i = 1; i < events.size(); i++)
+		{
+			EXPECT_EQ(events[i - 1].start + 1000, events[i].start);
+		}
+	}
+
+	TEST_F(TracerTest, CapacityNotPowerOfTwo)
+	{
+		ASSERT_ANY_THROW(Tracer(6));
+	}
+
+	TEST_F(TracerTest, Batches)
+	{
+		Tracer tracer;
+
+		const auto outer = tracer.beginBatch();
+		EXPECT_LT(0, outer);
+
+		// nested calls join the outer batch
+		EXPECT_EQ(outer, tracer.beginBatch());
+		tracer.endBatch();
+
+		const auto now = chrono::steady_clock::now();
+		tracer.record("inside", "oram", now, now);
+		tracer.endBatch();
+		tracer.record("outside", "oram", now, now);
+
+		const auto next = tracer.beginBatch();
+		EXPECT_NE(outer, next);
+		tracer.endBatch();
+
+		const auto events = tracer.events();
+		ASSERT_EQ(2, events.size());
+		EXPECT_EQ(outer, events[0].batch);
+		EXPECT_EQ(0, events[1].batch);
+	}
+
+	TEST_F(TracerTest, BatchGuardThrow)
+	{
+		Tracer tracer;
+
+		number inside = 0;
+		try
+		{
+			const TraceBatch batch(&tracer, "call", "oram");
+			inside = tracer.beginBatch();
+			tracer.endBatch();
+			throw Exception("failure");
+		}
+		catch (const Exception &)
+		{
+		}
+
+		// the span is recorded in its batch, and the batch is over
+		const auto events = tracer.events();
+		ASSERT_EQ(1, events.size());
+		EXPECT_STREQ("call", events[0].name);
+		EXPECT_EQ(inside, events[0].batch);
+
+		const auto next = tracer.beginBatch();
+		EXPECT_NE(inside, next);
+		tracer.endBatch();
+	}
+
+	TEST_F(TracerTest, ConcurrentWriters)
+	{
+		const auto threads = 4uLL, spans = 1000uLL;
+		Tracer tracer(1 << 13);
+
+		vector<thread> workers;
+		for (number t = 0; t < threads; t++)
+		{
+			workers.push_back(thread([&tracer]() {
+				tracer.beginBatch();
+				for (number i = 0; i < spans; i++)
+				{
+					const auto now = chrono::steady_clock::now();
+					tracer.record("span", "oram", now, now);
+				}
+				tracer.endBatch();
+			}));
+		}
+		for (auto &&worker : workers)
+		{
+			worker.join();
+		}
+
+		const auto events = tracer.events();
+		ASSERT_EQ(threads * spans, events.size());
+
+		// each thread has its own ID and its own batch
+		set<number> ids, batches;
+		for (auto &&event : events)
+		{
+			ids.insert(event.thread);
+			batches.insert(event.batch);
+		}
+		EXPECT_EQ(threads, ids.size());
+		EXPECT_EQ(threads, batches.size());
+	}
+
+	TEST_F(TracerTest, ChromeTraceFormat)
+	{
+		Tracer tracer;
+
+		const auto start = chrono::steady_clock::now();
+		tracer.record("evict", "oram", start + chrono::nanoseconds(1500), start + chrono::nanoseconds(4000));
+		tracer.record("storage read", "storage", start, start, 5);
+
+		stringstream output;
+		tracer.dump(output);
+		const auto json = output.str();
+
+		EXPECT_EQ(0, json.find("{\"displayTimeUnit\":\"ns\",\"traceEvents\":["));
+		EXPECT_NE(string::npos, json.find("\"name\":\"evict\",\"cat\":\"oram\",\"ph\":\"X\""));
+		EXPECT_NE(string::npos, json.find("\"dur\":2.500"));
+		EXPECT_NE(string::npos, json.find("\"buckets\":5"));
+		EXPECT_EQ(json.rfind("]}"), json.size() - 3);
+	}
+
+	TEST_F(TracerTest, ORAMTimeline)
+	{
+		auto tracer = make_shared<Tracer>();
+
+		// the position map is itself an ORAM
+		const auto mapLogCapacity = LOG_CAPACITY - 1;
+		auto mapORAM			  = make_shared<ORAM>(
+			 mapLogCapacity,
+			 BLOCK_SIZE,
+			 Z,
+			 make_shared<InMemoryStorageAdapter>((1 << mapLogCapacity) + Z, BLOCK_SIZE, bytes(), Z),
+			 make_shared<InMemoryPositionMapAdapter>(((1 << mapLogCapacity) * Z) + Z),
+			 make_shared<InMemoryStashAdapter>(3 * mapLogCapacity * Z));
+		auto oram = make_unique<ORAM>(
+			LOG_CAPACITY,
+			BLOCK_SIZE,
+			Z,
+			make_shared<InMemoryStorageAdapter>(CAPACITY + Z, BLOCK_SIZE, bytes(), Z),
+			make_shared<ORAMPositionMapAdapter>(mapORAM),
+			make_shared<InMemoryStashAdapter>(3 * LOG_CAPACITY * Z));
+
+		oram->setTracer(tracer);
+		oram->put(1, fromText("1", BLOCK_SIZE));
+
+		auto events = tracer->events();
+		map<string, number> counts;
+		set<number> batches;
+		for (auto &&event : events)
+		{
+			counts[event.name]++;
+			batches.insert(event.batch);
+		}
+
+		// the put and three position map accesses (get of the position, then read and write back on set)
+		EXPECT_EQ(2, counts["put"]);
+		EXPECT_EQ(2, counts["get"]);
+		EXPECT_EQ(4, counts["evict"]);
+		EXPECT_EQ(4, counts["decrypt"]);
+		EXPECT_EQ(4, counts["encrypt"]);
+		EXPECT_LE(4, counts["storage read"]);
+		EXPECT_LE(4, counts["storage write"]);
+		EXPECT_LE(1, counts["position map"]);
+
+		// all in one batch, the call is recorded last
+		ASSERT_EQ(1, batches.size());
+		EXPECT_LT(0, *batches.begin());
+		EXPECT_STREQ("put", events.back().name);
+
+		// a throwing call still records its span and ends its batch, the next calls get their own
+		bytes returned;
+		EXPECT_THROW(oram->get(1uLL << 40, returned), Exception);
+		events = tracer->events();
+		EXPECT_STREQ("get", events.back().name);
+		const auto failed = events.back().batch;
+		const auto before = events.size();
+
+		oram->get(1, returned);
+		oram->get(2, returned);
+		events = tracer->events();
+		batches.clear();
+		for (auto i = before; i < events.size(); i++)
+		{
+			batches.insert(events[i].batch);
+		}
+		EXPECT_EQ(2, batches.size());
+		EXPECT_EQ(0, batches.count(0));
+		EXPECT_EQ(0, batches.count(failed));
+
+		// tracing stops
+		oram->setTracer(nullptr);
+		oram->put(1, fromText("1", BLOCK_SIZE));
+		EXPECT_EQ(events.size(), tracer->events().size());
+	}
+}
+
+int main(int argc, char **argv)
+{
+	srand(TEST_SEED);
+
+	::testing::InitGoogleTest(&argc, argv);
+	return RUN_ALL_TESTS();
+}
@@ -4,7 +4,9 @@
 #include "gtest/gtest.h"
 #include <cmath>
 #include <numeric>
+#include <set>
 #include <openssl/aes.h>
+#include <unordered_map>
 
 using namespace std;
 
@@ -144,6 +146,33 @@ namespace PathORAM
 		ASSERT_EQ(input, plaintext);
 	}
 
+	TEST_F(UtilityTest, EncryptDecryptBuffers)
+	{
+		for (auto mode : {CBC, CTR})
+		{
+			__blockCipherMode = mode;
+
+			auto key   = getRandomBlock(KEYSIZE);
+			auto iv	   = getRandomBlock(AES_BLOCK_SIZE);
+			auto input = fromText("Hello, world!", 64);
+
+			// same ciphertext as the iterator version, and the IV is not modified
+			bytes expected;
+			encrypt(key.begin(), key.end(), iv.begin(), iv.end(), input.begin(), input.end(), expected, ENCRYPT);
+
+			const auto ivCopy = iv;
+			uchar ciphertext[64];
+			encrypt(key.data(), iv.data(), input.data(), input.size(), ciphertext, ENCRYPT);
+			EXPECT_EQ(expected, bytes(ciphertext, ciphertext + 64));
+			EXPECT_EQ(ivCopy, iv);
+
+			uchar plaintext[64];
+			encrypt(key.data(), iv.data(), ciphertext, 64, plaintext, DECRYPT);
+			EXPECT_EQ(input, bytes(plaintext, plaintext + 64));
+		}
+		__blockCipherMode = CBC;
+	}
+
 	TEST_F(UtilityTest, EncryptDecryptManyCBC)
 	{
 		for (number i = 0; i < 100; i++)
@@ -341,6 +370,158 @@ namespace PathORAM
 		EXPECT_NEAR(RUNS / (double)MAX, mean, 0.01);
 		EXPECT_NEAR(0.0, stddev, 0.01 * RUNS);
 	}
+
+	TEST_F(UtilityTest, HashMapMemory)
+	{
+		unordered_map<number, bytes> table;
+		const auto empty = hashMapMemory(table);
+		EXPECT_EQ(table.bucket_count() * sizeof(void *), empty);
+
+		for (auto i = 0uLL; i < 100; i++)
+		{
+			table[i] = bytes(64);
+		}
+
+		// the payloads of the entries are not counted
+		EXPECT_EQ(100 * (sizeof(pair<const number, bytes>) + sizeof(void *)) + table.bucket_count() * sizeof(void *), hashMapMemory(table));
+		EXPECT_LT(empty, hashMapMemory(table));
+	}
+
+	TEST_F(UtilityTest, FixedHashMapBasic)
+	{
+		FixedHashMap map(10);
+
+		number value = 0;
+		EXPECT_FALSE(map.get(5, value));
+
+		map.set(5, 56);
+		ASSERT_TRUE(map.get(5, value));
+		EXPECT_EQ(56, value);
+
+		map.set(5, 25);
+		map.get(5, value);
+		EXPECT_EQ(25, value);
+		EXPECT_EQ(1, map.size());
+
+		EXPECT_TRUE(map.remove(5));
+		EXPECT_FALSE(map.remove(5));
+		EXPECT_FALSE(map.get(5, value));
+		EXPECT_EQ(0, map.size());
+	}
+
+	TEST_F(UtilityTest, FixedHashMapOverflow)
+	{
+		const auto capacity = 100uLL;
+		FixedHashMap map(capacity);
+
+		for (number i = 0; i < capacity; i++)
+		{
+			map.set(i * 1000003, i);
+		}
+		ASSERT_ANY_THROW(map.set(ULLONG_MAX, 0));
+		ASSERT_NO_THROW(map.set(0, 1));
+
+		map.clear();
+		EXPECT_EQ(0, map.size());
+		ASSERT_NO_THROW(map.set(ULLONG_MAX, 0));
+	}
+
+	TEST_F(UtilityTest, FixedHashMapChurn)
+	{
+		const auto capacity = 64uLL;
+		FixedHashMap map(capacity);
+		unordered_map<number, number> expected;
+
+		// many insertions and removals, tombstones force rehashes
+		for (number i = 0; i < 100000; i++)
+		{
+			const auto key = getRandomULong(capacity * 4);
+			if (expected.count(key) > 0 || expected.size() == capacity)
+			{
+				EXPECT_EQ(expected.erase(key) > 0, map.remove(key));
+			}
+			else
+			{
+				expected[key] = i;
+				map.set(key, i);
+			}
+		}
+
+		EXPECT_EQ(expected.size(), map.size());
+		for (number key = 0; key < capacity * 4; key++)
+		{
+			number value;
+			const auto found = map.get(key, value);
+			EXPECT_EQ(expected.count(key) > 0, found);
+			if (found)
+			{
+				EXPECT_EQ(expected[key], value);
+			}
+		}
+	}
+
+	TEST_F(UtilityTest, BlockArenaReuse)
+	{
+		const auto blockSize = 64uLL;
+		BlockArena arena(blockSize, 4);
+		EXPECT_EQ(0, arena.capacity());
+
+		vector<BlockHandle> handles;
+		for (auto i = 0; i < 6; i++)
+		{
+			handles.push_back(arena.allocate());
+			EXPECT_EQ(blockSize, handles.back().size());
+		}
+		// grows by slabs of 4
+		EXPECT_EQ(8, arena.capacity());
+		EXPECT_EQ(2, arena.available());
+
+		// chunks do not overlap
+		set<uchar *> chunks;
+		for (auto &&handle : handles)
+		{
+			chunks.insert(handle.data());
+		}
+		EXPECT_EQ(handles.size(), chunks.size());
+
+		handles.clear();
+		EXPECT_EQ(8, arena.available());
+
+		// released chunks are reused, no new slabs
+		for (auto i = 0; i < 8; i++)
+		{
+			handles.push_back(arena.allocate());
+		}
+		EXPECT_EQ(8, arena.capacity());
+		EXPECT_EQ(0, arena.available());
+	}
+
+	TEST_F(UtilityTest, BlockHandleMove)
+	{
+		BlockArena arena(32, 2);
+
+		auto first = arena.allocate();
+		first.assign(fromText("hello", 5).data(), 5);
+		const auto chunk = first.data();
+
+		BlockHandle second(move(first));
+		EXPECT_EQ(nullptr, first.data());
+		EXPECT_EQ(0, first.size());
+		EXPECT_EQ(chunk, second.data());
+		EXPECT_EQ("hello", toText(bytes(second.data(), second.data() + second.size()), 32));
+
+		auto third = arena.allocate();
+		third	   = move(second);
+		EXPECT_EQ(chunk, third.data());
+		// the chunk previously held by third is back
+		EXPECT_EQ(1, arena.available());
+
+		third.reset();
+		EXPECT_EQ(2, arena.available());
+
+		auto tooLong = arena.allocate();
+		ASSERT_ANY_THROW(tooLong.assign(bytes(33).data(), 33));
+	}
 }
 
 int main(int argc, char **argv)